@@ -0,0 +1,72 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <errno.h>
+#include <stddef.h>
+
+// 在main之前就可能有内存分配,std::atomic<int64_t>是常量初始化的,不依赖构造顺序
+static std::atomic<int64_t> sAllocations(0);
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+// glibc导出的真正的分配函数
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) {
+    sAllocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    sAllocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    sAllocations++;
+    return __libc_realloc(ptr, size);
+}
+
+// av_malloc在linux上使用posix_memalign分配对齐的内存
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    sAllocations++;
+    void* memory = __libc_memalign(alignment, size);
+    if(NULL == memory) {
+        return ENOMEM;
+    }
+    *ptr = memory;
+    return 0;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    sAllocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    sAllocations++;
+    return __libc_memalign(alignment, size);
+}
+
+}
+
+bool IsAllocationCountSupported() {
+    return true;
+}
+
+#else
+
+bool IsAllocationCountSupported() {
+    return false;
+}
+
+#endif
+
+int64_t GetAllocationCount() {
+    return sAllocations;
+}
@@ -0,0 +1,13 @@
+#ifndef __ALLOC_COUNTER_H__
+#define __ALLOC_COUNTER_H__
+
+#include <stdint.h>
+
+// 统计进程里面malloc/calloc/realloc/posix_memalign的调用次数,FFmpeg内部的av_malloc也会被统计到
+// 通过在可执行文件里面定义同名函数覆盖glibc的实现,所以只能链接到benchmark这种可执行文件里面,不要放到so里
+// 不是glibc的环境下不做统计,IsAllocationCountSupported返回false
+bool IsAllocationCountSupported();
+
+int64_t GetAllocationCount();
+
+#endif
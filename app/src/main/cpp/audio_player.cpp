@@ -0,0 +1,337 @@
+#include "audio_player.h"
+#include "common.h"
+
+#include <string.h>
+
+using namespace std;
+
+AudioPlayer::AudioPlayer() :
+        mCodecContext(NULL),
+        mSwrContext(NULL),
+        mTimeBase({0, 1}),
+        mFormat({0, 0}),
+        mSink(NULL),
+        mClock(NULL),
+        mPacketPool(NULL),
+        mPacketQueue(PACKET_QUEUE_SIZE),
+        mRingBuffer(NULL),
+        mAbort(false),
+        mDecodeFinished(false),
+        mFlushRequested(false),
+        mSpeed(1.0),
+        mCompensating(false),
+        mWrittenBytes(0),
+        mReadBytes(0),
+        mNextPts(AV_NOPTS_VALUE),
+        mDecodedFrames(0),
+        mUnderruns(0),
+        mLatencyUs(0),
+        mLatencySum(0),
+        mLatencyCount(0),
+        mMaxLatencyUs(0) {
+}
+
+AudioPlayer::~AudioPlayer() {
+    Close();
+}
+
+bool AudioPlayer::Open(AVStream* stream, AudioSink* sink, Clock* clock, PacketPool* packetPool) {
+    mPacketPool = packetPool;
+    AVCodecParameters* codecParam = stream->codecpar;
+    AVCodec* codec = avcodec_find_decoder(codecParam->codec_id);
+    if(NULL == codec) {
+        LOGD("can't find audio codec %d", codecParam->codec_id);
+        return false;
+    }
+
+    mCodecContext = avcodec_alloc_context3(codec);
+    if(NULL == mCodecContext
+        || avcodec_parameters_to_context(mCodecContext, codecParam) < 0
+        || avcodec_open2(mCodecContext, codec, NULL) < 0) {
+        LOGD("can't open audio codec");
+        return false;
+    }
+    mTimeBase = stream->time_base;
+
+    // 设备格式: 采样率保持不变,声道数最多两个,采样格式统一成交错存储的16位整数
+    mFormat.sampleRate = mCodecContext->sample_rate;
+    mFormat.channels = mCodecContext->channels > 1 ? 2 : 1;
+
+    // 有些流没有设置channel_layout,需要根据声道数推测一个默认值
+    int64_t inLayout = mCodecContext->channel_layout;
+    if(0 == inLayout) {
+        inLayout = av_get_default_channel_layout(mCodecContext->channels);
+    }
+    mSwrContext = swr_alloc_set_opts(NULL,
+                                     av_get_default_channel_layout(mFormat.channels),
+                                     AV_SAMPLE_FMT_S16,
+                                     mFormat.sampleRate,
+                                     inLayout,
+                                     mCodecContext->sample_fmt,
+                                     mCodecContext->sample_rate,
+                                     0,
+                                     NULL);
+    if(NULL == mSwrContext || swr_init(mSwrContext) < 0) {
+        LOGD("can't init swr");
+        return false;
+    }
+
+    mRingBuffer = new RingBuffer(mFormat.BytesPerSecond() * RING_BUFFER_MS / 1000);
+
+    if(!sink->Open(mFormat, this)) {
+        LOGD("can't open audio sink");
+        return false;
+    }
+    mSink = sink;
+    mClock = clock;
+    return true;
+}
+
+void AudioPlayer::Start() {
+    mAbort = false;
+    mDecodeThread = thread(&AudioPlayer::decodeLoop, this);
+    mSink->Start();
+}
+
+bool AudioPlayer::PushPacket(AVPacket* packet) {
+    return mPacketQueue.Push(packet);
+}
+
+void AudioPlayer::Flush() {
+    mPacketQueue.Flush([this](AVPacket* packet) { mPacketPool->Release(packet); });
+    mFlushRequested = true;
+}
+
+void AudioPlayer::SetSpeed(double speed) {
+    mSpeed = speed;
+}
+
+void AudioPlayer::EndOfStream() {
+    mPacketQueue.Close();
+}
+
+void AudioPlayer::Abort() {
+    mAbort = true;
+    mPacketQueue.Abort();
+    if(NULL != mRingBuffer) {
+        mRingBuffer->Abort();
+    }
+}
+
+void AudioPlayer::Stop() {
+    Abort();
+    if(mDecodeThread.joinable()) {
+        mDecodeThread.join();
+    }
+    if(NULL != mSink) {
+        mSink->Stop();
+    }
+}
+
+void AudioPlayer::Close() {
+    Stop();
+
+    if(NULL != mSink) {
+        mSink->Close();
+        mSink = NULL;
+    }
+
+    mPacketQueue.Flush([this](AVPacket* packet) { mPacketPool->Release(packet); });
+
+    if(NULL != mSwrContext) {
+        swr_free(&mSwrContext);
+    }
+
+    if(NULL != mCodecContext) {
+        avcodec_free_context(&mCodecContext);
+    }
+
+    delete mRingBuffer;
+    mRingBuffer = NULL;
+}
+
+void AudioPlayer::decodeLoop() {
+    AVFrame* frame = av_frame_alloc();
+    bool draining = false;
+
+    // avcodec_send_packet返回EAGAIN的时候这个包还没有被接收,把输出读出来之后重新送入
+    AVPacket* pending = NULL;
+
+    while(!mAbort && NULL != frame) {
+        // seek之后解码器和环形缓冲区里面都是旧位置的数据
+        if(mFlushRequested.exchange(false)) {
+            flushDecoder();
+            mPacketPool->Release(pending);
+            pending = NULL;
+            draining = false;
+        }
+
+        // 和视频一样,先把解码器里面的帧都读出来,读不到了再送入新的数据包
+        int ret = avcodec_receive_frame(mCodecContext, frame);
+        if(0 == ret) {
+            mDecodedFrames++;
+            bool written = writeFrame(frame);
+            av_frame_unref(frame);
+            if(!written) {
+                break;
+            }
+            continue;
+        }
+
+        if(AVERROR_EOF == ret || (AVERROR(EAGAIN) == ret && draining)) {
+            // 解码器已经排空
+            break;
+        }
+
+        if(AVERROR(EAGAIN) != ret) {
+            // 损坏的数据只影响这一帧,跳过它继续解码,否则后面一直没有声音,音频时钟也不会再走
+            LOGD("audio receive frame failed: %d, skip it", ret);
+            continue;
+        }
+
+        // 数据包队列关闭并且取完之后送入空包让解码器把剩下的帧都吐出来
+        AVPacket* packet = pending;
+        pending = NULL;
+        if(NULL != packet || mPacketQueue.Pop(packet)) {
+            ret = avcodec_send_packet(mCodecContext, packet);
+            if(AVERROR(EAGAIN) == ret) {
+                pending = packet;
+                continue;
+            }
+            if(ret < 0) {
+                LOGD("audio send packet failed: %d, skip it", ret);
+            }
+            mPacketPool->Release(packet);
+        } else {
+            ret = avcodec_send_packet(mCodecContext, NULL);
+            draining = AVERROR(EAGAIN) != ret;
+        }
+    }
+
+    mPacketPool->Release(pending);
+    av_frame_free(&frame);
+    mDecodeFinished = true;
+}
+
+void AudioPlayer::flushDecoder() {
+    avcodec_flush_buffers(mCodecContext);
+
+    // 重新初始化可以丢掉swr内部缓存的采样
+    swr_close(mSwrContext);
+    swr_init(mSwrContext);
+
+    // ReadAudio也是在持有mPtsMutex的时候更新音频时钟,所以清空之后不会再用旧的pts更新时钟
+    lock_guard<mutex> lock(mPtsMutex);
+    mRingBuffer->Clear();
+    mPtsSegments.clear();
+    mWrittenBytes = 0;
+    mReadBytes = 0;
+    mNextPts = AV_NOPTS_VALUE;
+    if(NULL != mClock) {
+        mClock->Reset();
+    }
+}
+
+bool AudioPlayer::writeFrame(AVFrame* frame) {
+    // 加速的时候让swr在这一帧的输出里面去掉一些采样,输出采样率和输入一样,所以不需要换算
+    // 补偿只在接下来的compensation_distance个输出采样内有效,所以每一帧都要重新设置,恢复正常速度的时候也要设置一次清掉
+    // 第一次设置的时候swr会打开重采样功能,之后采样率相同也会经过重采样,开销不大
+    double speed = mSpeed;
+    if(1.0 != speed || mCompensating) {
+        int wanted = (int) (frame->nb_samples / speed);
+        if(swr_set_compensation(mSwrContext, wanted - frame->nb_samples, 1.0 != speed ? wanted : 0) < 0) {
+            // 设置失败的话按照原来的速度播放,时钟也要按照原来的速度计算
+            speed = 1.0;
+        }
+        mCompensating = 1.0 != speed;
+    }
+
+    // 重采样之后的采样数可能比输入多(升采样或者swr内部还缓存了数据),用swr_get_out_samples计算上限
+    int maxSamples = swr_get_out_samples(mSwrContext, frame->nb_samples);
+    size_t maxBytes = maxSamples * mFormat.channels * 2;
+    if(mResampleBuffer.size() < maxBytes) {
+        // 只在缓冲区不够的时候扩容,稳定播放之后不会每帧分配内存
+        mResampleBuffer.resize(maxBytes);
+    }
+
+    uint8_t* out = mResampleBuffer.data();
+    int samples = swr_convert(mSwrContext, &out, maxSamples, (const uint8_t**) frame->extended_data, frame->nb_samples);
+    if(samples <= 0) {
+        return true;
+    }
+    int size = samples * mFormat.channels * 2;
+
+    // 计算这段数据的pts,没有pts的帧接着上一帧往后推算
+    int64_t pts = AV_NOPTS_VALUE == frame->pts ? mNextPts : av_rescale_q(frame->pts, mTimeBase, AV_TIME_BASE_Q);
+    if(AV_NOPTS_VALUE == pts) {
+        pts = 0;
+    }
+    // 加速播放的时候输出的每个采样对应更长的媒体时间
+    mNextPts = pts + (int64_t) (av_rescale(samples, AV_TIME_BASE, mFormat.sampleRate) * speed);
+
+    // 先记录这段数据的结束位置和pts再写入,保证读取线程读到数据的时候一定能找到对应的pts
+    {
+        lock_guard<mutex> lock(mPtsMutex);
+        mWrittenBytes += size;
+        mPtsSegments.push_back({mWrittenBytes, mNextPts, speed});
+    }
+
+    // 环形缓冲区满的时候会阻塞,等待音频设备消费
+    return mRingBuffer->Write(out, size);
+}
+
+void AudioPlayer::ReadAudio(uint8_t* buffer, int size) {
+    int read = mRingBuffer->Read(buffer, size);
+
+    // 数据不够的时候用静音补齐,除了开始播放之前和播放结束之后,都算作一次欠载
+    if(read < size) {
+        memset(buffer + read, 0, size - read);
+        if(!mDecodeFinished && mDecodedFrames > 0) {
+            mUnderruns++;
+        }
+    }
+
+    int64_t now = av_gettime_relative();
+    int64_t bytesPerSecond = mFormat.BytesPerSecond();
+    int64_t sinkLatency = mSink->GetLatencyUs();
+
+    lock_guard<mutex> lock(mPtsMutex);
+    mReadBytes += read;
+    while(!mPtsSegments.empty() && mPtsSegments.front().endBytes <= mReadBytes && mPtsSegments.size() > 1) {
+        mPtsSegments.pop_front();
+    }
+    if(mPtsSegments.empty() || 0 == read) {
+        return;
+    }
+
+    // 读取位置的pts = 所在数据段结束的pts - 读取位置到数据段结束还有多少数据
+    // 刚读出来的数据还要在设备缓冲里面排队,所以真正在播放的pts还要再减去设备的延迟
+    // 加速播放的数据段里面,每个字节对应的媒体时间要乘上速度,时钟也按照这个速度走
+    const PtsSegment& segment = mPtsSegments.front();
+    int64_t readPts = segment.endPts - (int64_t) (av_rescale(segment.endBytes - mReadBytes, AV_TIME_BASE, bytesPerSecond) * segment.speed);
+    if(NULL != mClock) {
+        mClock->SetAt(readPts - (int64_t) (sinkLatency * segment.speed), now);
+        mClock->SetSpeed(segment.speed);
+    }
+
+    // 音频延迟 = 环形缓冲区里面还没读取的数据 + 设备缓冲里面还没播放的数据
+    mLatencyUs = av_rescale(mWrittenBytes - mReadBytes, AV_TIME_BASE, bytesPerSecond) + sinkLatency;
+    mLatencySum += mLatencyUs;
+    mLatencyCount++;
+    if(mLatencyUs > mMaxLatencyUs) {
+        mMaxLatencyUs = mLatencyUs;
+    }
+}
+
+AudioStats AudioPlayer::GetStats() {
+    AudioStats stats;
+    stats.packetQueue = mPacketQueue.GetStats();
+    stats.decodedFrames = mDecodedFrames;
+    stats.underruns = mUnderruns;
+
+    lock_guard<mutex> lock(mPtsMutex);
+    stats.latencyUs = mLatencyUs;
+    stats.avgLatencyUs = mLatencyCount > 0 ? mLatencySum / mLatencyCount : 0;
+    stats.maxLatencyUs = mMaxLatencyUs;
+    return stats;
+}
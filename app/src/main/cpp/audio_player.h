@@ -0,0 +1,117 @@
+#ifndef __AUDIO_PLAYER_H__
+#define __AUDIO_PLAYER_H__
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "audio_sink.h"
+#include "blocking_queue.h"
+#include "media_clock.h"
+#include "packet_pool.h"
+#include "ring_buffer.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libswresample/swresample.h>
+}
+
+struct AudioStats {
+    QueueStats packetQueue;   // 解复用线程 -> 音频解码线程
+    int64_t decodedFrames;    // 解码得到的音频帧数量
+    int64_t underruns;        // 音频设备要数据的时候环形缓冲区里面的数据不够的次数
+    int64_t latencyUs;        // 当前的音频延迟: 从解码输出到扬声器播放出来(环形缓冲 + 设备缓冲)
+    int64_t avgLatencyUs;
+    int64_t maxLatencyUs;
+};
+
+// 音频播放: 解码 -> SwrContext重采样成设备格式 -> 环形缓冲区 -> AudioSink拉取播放
+// 解码在自己的线程里面进行,AudioSink在它自己的线程里面通过ReadAudio拉取数据
+// 每次拉取的时候会根据读取位置对应的pts更新音频时钟,所以它可以作为音视频同步的主时钟
+class AudioPlayer : public AudioSource {
+public:
+    static const int PACKET_QUEUE_SIZE = 128;
+
+    AudioPlayer();
+    ~AudioPlayer();
+
+    // 数据包从packetPool里面来,解码之后或者丢掉的时候放回去,packetPool需要比AudioPlayer活得更久
+    bool Open(AVStream* stream, AudioSink* sink, Clock* clock, PacketPool* packetPool);
+
+    // 启动解码线程和音频设备
+    void Start();
+
+    // 由解复用线程调用,队列满的时候会阻塞,成功之后数据包由AudioPlayer负责放回数据包池
+    bool PushPacket(AVPacket* packet);
+
+    // seek的时候由解复用线程调用: 丢掉还没有解码的数据包,解码线程随后会清空解码器、环形缓冲区和音频时钟
+    void Flush();
+
+    // 告诉解码线程不会再有新的数据包了
+    void EndOfStream();
+
+    // 播放速度,直播追赶延迟的时候用,可以在任意线程调用
+    // 通过swr_set_compensation让重采样少输出一些采样实现加速,音调会跟着稍微变高,只适合1.0附近的速度
+    // 环形缓冲区里面已经重采样好的数据还是按原来的速度播放,所以要过一小段时间才会生效,音频时钟的速度也会在那个时候才改变
+    void SetSpeed(double speed);
+
+    // 只是让阻塞在PushPacket或者解码线程里面的调用尽快返回,可以在任意线程调用
+    void Abort();
+
+    void Stop();
+    void Close();
+
+    void ReadAudio(uint8_t* buffer, int size) override;
+
+    AudioStats GetStats();
+
+private:
+    // 环形缓冲区能存放的音频时长
+    static const int RING_BUFFER_MS = 200;
+
+    // 一段连续写入的PCM数据的结束位置和对应的pts,用于在读取的时候计算读取位置的pts
+    struct PtsSegment {
+        int64_t endBytes;
+        int64_t endPts;
+        double speed;
+    };
+
+    AVCodecContext* mCodecContext;
+    SwrContext* mSwrContext;
+    AVRational mTimeBase;
+    AudioFormat mFormat;
+    AudioSink* mSink;
+    Clock* mClock;
+    PacketPool* mPacketPool;
+
+    BlockingQueue<AVPacket*> mPacketQueue;
+    RingBuffer* mRingBuffer;
+    std::vector<uint8_t> mResampleBuffer;
+    std::thread mDecodeThread;
+    std::atomic<bool> mAbort;
+    std::atomic<bool> mDecodeFinished;
+    std::atomic<bool> mFlushRequested;
+    std::atomic<double> mSpeed;
+    bool mCompensating;
+
+    std::mutex mPtsMutex;
+    std::deque<PtsSegment> mPtsSegments;
+    int64_t mWrittenBytes;
+    int64_t mReadBytes;
+    int64_t mNextPts;
+
+    std::atomic<int64_t> mDecodedFrames;
+    std::atomic<int64_t> mUnderruns;
+    int64_t mLatencyUs;
+    int64_t mLatencySum;
+    int64_t mLatencyCount;
+    int64_t mMaxLatencyUs;
+
+    void decodeLoop();
+    bool writeFrame(AVFrame* frame);
+    void flushDecoder();
+};
+
+#endif
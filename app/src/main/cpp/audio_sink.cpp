@@ -0,0 +1,97 @@
+#include "audio_sink.h"
+
+#include <vector>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+using namespace std;
+
+NullAudioSink::NullAudioSink()
+        : mFormat({0, 0}),
+          mSource(NULL),
+          mRunning(false) {
+}
+
+NullAudioSink::~NullAudioSink() {
+    Close();
+}
+
+bool NullAudioSink::Open(const AudioFormat &format, AudioSource *source) {
+    mFormat = format;
+    mSource = source;
+    return true;
+}
+
+void NullAudioSink::Start() {
+    if (mRunning) {
+        return;
+    }
+    mRunning = true;
+    mThread = thread(&NullAudioSink::loop, this);
+}
+
+void NullAudioSink::Stop() {
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void NullAudioSink::Close() {
+    Stop();
+    mSource = NULL;
+}
+
+int64_t NullAudioSink::GetLatencyUs() {
+    // 每个周期开始的时候拉取一个周期的数据,平均下来有一个周期的数据还没有"播放"
+    return PERIOD_MS * 1000;
+}
+
+void NullAudioSink::onData(const uint8_t *, int) {
+}
+
+void NullAudioSink::loop() {
+    vector<uint8_t> buffer(mFormat.BytesPerSecond() * PERIOD_MS / 1000);
+
+    // 每个周期的开始时间都是相对第一次拉取的时间计算的,不会因为睡眠不准而累积误差
+    int64_t start = av_gettime_relative();
+    for (int64_t period = 1; mRunning; period++) {
+        mSource->ReadAudio(buffer.data(), buffer.size());
+        onData(buffer.data(), buffer.size());
+
+        int64_t sleep = start + period * PERIOD_MS * 1000 - av_gettime_relative();
+        if (sleep > 0) {
+            av_usleep(sleep);
+        }
+    }
+}
+
+FileAudioSink::FileAudioSink(const string &path) : mPath(path), mFile(NULL) {
+}
+
+FileAudioSink::~FileAudioSink() {
+    // 需要在子类析构的时候就停止线程并关闭文件,父类析构的时候已经不能回调onData了
+    Close();
+}
+
+bool FileAudioSink::Open(const AudioFormat &format, AudioSource *source) {
+    mFile = fopen(mPath.c_str(), "wb");
+    if (NULL == mFile) {
+        return false;
+    }
+    return NullAudioSink::Open(format, source);
+}
+
+void FileAudioSink::Close() {
+    NullAudioSink::Close();
+    if (NULL != mFile) {
+        fclose(mFile);
+        mFile = NULL;
+    }
+}
+
+void FileAudioSink::onData(const uint8_t *data, int size) {
+    fwrite(data, 1, size, mFile);
+}
@@ -0,0 +1,87 @@
+#ifndef __AUDIO_SINK_H__
+#define __AUDIO_SINK_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+// 音频输出的PCM格式,固定使用交错存储的有符号16位整数(AV_SAMPLE_FMT_S16)
+struct AudioFormat {
+    int sampleRate;
+    int channels;
+
+    int BytesPerSecond() const {
+        return sampleRate * channels * 2;
+    }
+};
+
+// PCM数据的来源,音频输出在需要数据的时候调用ReadAudio拉取
+// ReadAudio不能阻塞,数据不够的时候由它自己填充静音
+class AudioSource {
+public:
+    virtual ~AudioSource() {}
+
+    virtual void ReadAudio(uint8_t *buffer, int size) = 0;
+};
+
+// 音频输出接口,安卓上由OpenSLAudioSink实现,在linux上测试的时候可以使用NullAudioSink/FileAudioSink
+class AudioSink {
+public:
+    virtual ~AudioSink() {}
+
+    virtual bool Open(const AudioFormat &format, AudioSource *source) = 0;
+    virtual void Start() = 0;
+    virtual void Stop() = 0;
+    virtual void Close() = 0;
+
+    // 已经从AudioSource读取走但是还没有播放出来的数据时长,单位微秒
+    virtual int64_t GetLatencyUs() = 0;
+};
+
+// 不输出声音的音频设备,用一个线程按照真实的播放速度定时拉取数据,模拟声卡的行为
+class NullAudioSink : public AudioSink {
+public:
+    NullAudioSink();
+    ~NullAudioSink();
+
+    bool Open(const AudioFormat &format, AudioSource *source) override;
+    void Start() override;
+    void Stop() override;
+    void Close() override;
+    int64_t GetLatencyUs() override;
+
+protected:
+    // 每次拉取的数据时长,也就是模拟的声卡缓冲区大小
+    static const int PERIOD_MS = 20;
+
+    virtual void onData(const uint8_t *data, int size);
+
+private:
+    AudioFormat mFormat;
+    AudioSource *mSource;
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+
+    void loop();
+};
+
+// 把拉取到的PCM数据写到文件里面,可以用ffplay -f s16le -ar 采样率 -ac 声道数 播放检查
+class FileAudioSink : public NullAudioSink {
+public:
+    explicit FileAudioSink(const std::string &path);
+    ~FileAudioSink();
+
+    bool Open(const AudioFormat &format, AudioSource *source) override;
+    void Close() override;
+
+protected:
+    void onData(const uint8_t *data, int size) override;
+
+private:
+    std::string mPath;
+    FILE *mFile;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef __BLOCKING_QUEUE_H__
+#define __BLOCKING_QUEUE_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+// 队列的统计数据,用于观察流水线各个环节的堆积和阻塞情况
+struct QueueStats {
+    size_t capacity;     // 队列容量
+    size_t depth;        // 当前深度
+    size_t maxDepth;     // 出现过的最大深度
+    double avgDepth;     // 每次入队时采样得到的平均深度
+    int64_t pushCount;   // 入队次数
+    int64_t popCount;    // 出队次数
+    int64_t fullCount;   // 入队时队列已满需要等待的次数(反压次数)
+    int64_t emptyCount;  // 出队时队列为空需要等待的次数(饥饿次数)
+    int64_t pushWaitUs;  // 生产者因为反压累计等待的时间
+    int64_t popWaitUs;   // 消费者因为饥饿累计等待的时间
+};
+
+// 有界阻塞队列,用于连接解复用、解码、渲染这几个线程
+// 队列满的时候Push会阻塞生产者,这样下游处理不过来的时候上游会自动降速(反压),避免内存无限增长
+// 队列空的时候Pop会阻塞消费者
+// Close代表生产者不会再放入数据,消费者取完剩下的数据之后Pop返回false
+// Abort用于退出,所有等待中的线程都会立即返回false
+template<typename T>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity)
+            : mCapacity(capacity),
+              mClosed(false),
+              mAborted(false),
+              mMaxDepth(0),
+              mDepthSum(0),
+              mPushCount(0),
+              mPopCount(0),
+              mFullCount(0),
+              mEmptyCount(0),
+              mPushWaitUs(0),
+              mPopWaitUs(0) {
+    }
+
+    bool Push(const T &item) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mQueue.size() >= mCapacity && !mAborted && !mClosed) {
+            mFullCount++;
+            int64_t start = av_gettime_relative();
+            mNotFull.wait(lock, [this] { return mQueue.size() < mCapacity || mAborted || mClosed; });
+            mPushWaitUs += av_gettime_relative() - start;
+        }
+        if (mAborted || mClosed) {
+            return false;
+        }
+        mQueue.push_back(item);
+        mPushCount++;
+        mDepthSum += mQueue.size();
+        if (mQueue.size() > mMaxDepth) {
+            mMaxDepth = mQueue.size();
+        }
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    // 不阻塞的入队,队列满的时候直接返回false,由调用者决定丢弃还是重试
+    bool TryPush(const T &item) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mAborted || mClosed) {
+            return false;
+        }
+        if (mQueue.size() >= mCapacity) {
+            mFullCount++;
+            return false;
+        }
+        mQueue.push_back(item);
+        mPushCount++;
+        mDepthSum += mQueue.size();
+        if (mQueue.size() > mMaxDepth) {
+            mMaxDepth = mQueue.size();
+        }
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T &item) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mQueue.empty() && !mAborted && !mClosed) {
+            mEmptyCount++;
+            int64_t start = av_gettime_relative();
+            mNotEmpty.wait(lock, [this] { return !mQueue.empty() || mAborted || mClosed; });
+            mPopWaitUs += av_gettime_relative() - start;
+        }
+        if (mAborted || mQueue.empty()) {
+            return false;
+        }
+        item = mQueue.front();
+        mQueue.pop_front();
+        mPopCount++;
+        mNotFull.notify_one();
+        return true;
+    }
+
+    bool TryPop(T &item) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mAborted || mQueue.empty()) {
+            return false;
+        }
+        item = mQueue.front();
+        mQueue.pop_front();
+        mPopCount++;
+        mNotFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+    void Abort() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mAborted = true;
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+    // 清空队列,取出来的元素交给release释放
+    template<typename Release>
+    void Flush(Release release) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        while (!mQueue.empty()) {
+            release(mQueue.front());
+            mQueue.pop_front();
+        }
+        mNotFull.notify_all();
+    }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mQueue.size();
+    }
+
+    QueueStats GetStats() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        QueueStats stats;
+        stats.capacity = mCapacity;
+        stats.depth = mQueue.size();
+        stats.maxDepth = mMaxDepth;
+        stats.avgDepth = mPushCount > 0 ? mDepthSum * 1.0 / mPushCount : 0;
+        stats.pushCount = mPushCount;
+        stats.popCount = mPopCount;
+        stats.fullCount = mFullCount;
+        stats.emptyCount = mEmptyCount;
+        stats.pushWaitUs = mPushWaitUs;
+        stats.popWaitUs = mPopWaitUs;
+        return stats;
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mNotFull;
+    std::condition_variable mNotEmpty;
+    std::deque<T> mQueue;
+
+    size_t mCapacity;
+    bool mClosed;
+    bool mAborted;
+
+    size_t mMaxDepth;
+    int64_t mDepthSum;
+    int64_t mPushCount;
+    int64_t mPopCount;
+    int64_t mFullCount;
+    int64_t mEmptyCount;
+    int64_t mPushWaitUs;
+    int64_t mPopWaitUs;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "choreographer_vsync_source.h"
+#include "common.h"
+
+#include <android/looper.h>
+#include <dlfcn.h>
+#include <stddef.h>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+ChoreographerVsyncSource::ChoreographerVsyncSource()
+        : mChoreographer(NULL),
+          mPostFrameCallback(NULL),
+          mPostFrameCallback64(NULL),
+          mReceived(false),
+          mFrameTimeUs(0),
+          mLastFrameTimeUs(-1),
+          mPeriodUs(DEFAULT_PERIOD_US) {
+}
+
+bool ChoreographerVsyncSource::Init() {
+    void* lib = dlopen("libandroid.so", RTLD_NOW);
+    if(NULL == lib) {
+        return false;
+    }
+    GetInstanceFunc getInstance = (GetInstanceFunc) dlsym(lib, "AChoreographer_getInstance");
+    mPostFrameCallback = (PostFrameCallbackFunc) dlsym(lib, "AChoreographer_postFrameCallback");
+    mPostFrameCallback64 = (PostFrameCallback64Func) dlsym(lib, "AChoreographer_postFrameCallback64");
+    if(NULL == getInstance || (NULL == mPostFrameCallback && NULL == mPostFrameCallback64)) {
+        LOGD("AChoreographer is not supported");
+        return false;
+    }
+
+    // AChoreographer_getInstance要求当前线程有ALooper
+    ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+    mChoreographer = getInstance();
+    return NULL != mChoreographer;
+}
+
+int64_t ChoreographerVsyncSource::WaitForVsync() {
+    mReceived = false;
+    if(NULL != mPostFrameCallback64) {
+        mPostFrameCallback64(mChoreographer, onFrame64, this);
+    } else {
+        mPostFrameCallback(mChoreographer, onFrame, this);
+    }
+
+    // 回调是在ALooper_pollOnce里面执行的
+    int64_t deadline = av_gettime_relative() + WAIT_TIMEOUT_MS * 1000;
+    while(!mReceived) {
+        int64_t remaining = deadline - av_gettime_relative();
+        if(remaining <= 0 || ALooper_pollOnce((int) (remaining / 1000) + 1, NULL, NULL, NULL) == ALOOPER_POLL_ERROR) {
+            break;
+        }
+    }
+    if(!mReceived) {
+        return av_gettime_relative() + mPeriodUs;
+    }
+
+    updatePeriod();
+
+    // 回调的时间是刚刚发生的vsync,现在开始渲染的画面要到下一个vsync才显示出来
+    return mFrameTimeUs + mPeriodUs;
+}
+
+int64_t ChoreographerVsyncSource::GetPeriodUs() {
+    return mPeriodUs;
+}
+
+void ChoreographerVsyncSource::onFrame(long frameTimeNanos, void* data) {
+    ChoreographerVsyncSource* source = (ChoreographerVsyncSource*) data;
+
+    // 32位的long放不下纳秒时间,用收到回调的时间代替,只差了回调的调度延迟
+    source->mFrameTimeUs = sizeof(long) >= sizeof(int64_t) ? frameTimeNanos / 1000 : av_gettime_relative();
+    source->mReceived = true;
+}
+
+void ChoreographerVsyncSource::onFrame64(int64_t frameTimeNanos, void* data) {
+    ChoreographerVsyncSource* source = (ChoreographerVsyncSource*) data;
+    source->mFrameTimeUs = frameTimeNanos / 1000;
+    source->mReceived = true;
+}
+
+void ChoreographerVsyncSource::updatePeriod() {
+    // 相邻两次回调之间可能隔了好几个vsync(渲染慢的时候),按照当前估计的周期换算成一个周期的时长
+    // 再做一个平滑,90Hz、120Hz的屏幕或者刷新率切换之后很快就能收敛
+    if(-1 != mLastFrameTimeUs) {
+        int64_t delta = mFrameTimeUs - mLastFrameTimeUs;
+        int64_t count = (delta + mPeriodUs / 2) / mPeriodUs;
+        if(0 == count) {
+            // 比当前估计的周期还短,说明刷新率变高了
+            count = 1;
+        }
+        if(delta > 0 && count <= 4) {
+            mPeriodUs = (mPeriodUs * 7 + delta / count) / 8;
+        }
+    }
+    mLastFrameTimeUs = mFrameTimeUs;
+}
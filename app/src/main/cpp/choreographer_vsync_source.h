@@ -0,0 +1,48 @@
+#ifndef __CHOREOGRAPHER_VSYNC_SOURCE_H__
+#define __CHOREOGRAPHER_VSYNC_SOURCE_H__
+
+#include <android/choreographer.h>
+
+#include "vsync_source.h"
+
+// 通过AChoreographer接收屏幕的vsync,和java层Choreographer.FrameCallback拿到的是同一个时间
+// AChoreographer需要安卓7.0以上,而这个demo的minSdk是21,所以用dlsym查找,找不到的话Init返回false
+// AChoreographer需要调用线程有ALooper,Init会给渲染线程创建一个,WaitForVsync里面通过ALooper_pollOnce等待回调
+// 所有方法都需要在渲染线程调用
+class ChoreographerVsyncSource : public VsyncSource {
+public:
+    ChoreographerVsyncSource();
+
+    bool Init();
+
+    int64_t WaitForVsync() override;
+    int64_t GetPeriodUs() override;
+
+private:
+    // 还没有收到过两次vsync的时候假设是60Hz
+    static const int64_t DEFAULT_PERIOD_US = 16667;
+
+    // 熄屏之后收不到vsync,等这么久还没有回调就按照当前时间估计
+    static const int WAIT_TIMEOUT_MS = 100;
+
+    typedef AChoreographer* (*GetInstanceFunc)();
+    typedef void (*PostFrameCallbackFunc)(AChoreographer*, AChoreographer_frameCallback, void*);
+    typedef void (*PostFrameCallback64Func)(AChoreographer*, AChoreographer_frameCallback64, void*);
+
+    AChoreographer* mChoreographer;
+    PostFrameCallbackFunc mPostFrameCallback;
+    PostFrameCallback64Func mPostFrameCallback64;
+
+    bool mReceived;
+    int64_t mFrameTimeUs;
+    int64_t mLastFrameTimeUs;
+    int64_t mPeriodUs;
+
+    // 32位系统上long只有32位,纳秒的时间会溢出,所以安卓10以上优先使用64位的回调
+    static void onFrame(long frameTimeNanos, void* data);
+    static void onFrame64(int64_t frameTimeNanos, void* data);
+
+    void updatePeriod();
+};
+
+#endif
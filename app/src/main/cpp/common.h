@@ -1,9 +1,16 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#ifdef __ANDROID__
 #include <android/log.h>
 
 static const char *TAG = "FFmpegDemo";
 #define LOGD(fmt, args...) __android_log_print(ANDROID_LOG_DEBUG, TAG, fmt, ##args)
+#else
+// 在linux上跑benchmark的时候直接输出到标准错误
+#include <stdio.h>
+
+#define LOGD(fmt, args...) fprintf(stderr, fmt "\n", ##args)
+#endif
 
 #endif
\ No newline at end of file
@@ -1,30 +1,31 @@
 #include <android/native_window_jni.h>
 #include "egl_helper.h"
+#include <EGL/eglext.h>
 #include "common.h"
 
-static EGLConfig chooseEglConfig(EGLDisplay display) {
+static EGLConfig chooseEglConfig(EGLDisplay display, int renderableType) {
     int attribList[] = {
             EGL_BUFFER_SIZE, 32,
             EGL_ALPHA_SIZE, 8,
             EGL_RED_SIZE, 8,
             EGL_GREEN_SIZE, 8,
             EGL_BLUE_SIZE, 8,
-            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_RENDERABLE_TYPE, renderableType,
             EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
             EGL_NONE
     };
     EGLConfig configs[1];
     int numConfigs[1];
 
-    if (!eglChooseConfig(display, attribList, configs, 1, numConfigs)) {
+    if (!eglChooseConfig(display, attribList, configs, 1, numConfigs) || numConfigs[0] < 1) {
         return NULL;
     }
     return configs[0];
 }
 
-static EGLContext createEglContext(EGLDisplay display, EGLConfig config) {
+static EGLContext createEglContext(EGLDisplay display, EGLConfig config, int version) {
     int contextList[] = {
-            EGL_CONTEXT_CLIENT_VERSION, 2,
+            EGL_CONTEXT_CLIENT_VERSION, version,
             EGL_NONE
     };
 
@@ -52,8 +53,15 @@ bool EGLHelper::Init(JNIEnv *env, jobject jSurface) {
         return false;
     }
 
-    config = chooseEglConfig(display);
-    context = createEglContext(display, config);
+    // 优先创建OpenGL ES 3.0的上下文,纹理上传可以使用PBO,不支持的设备再退回2.0
+    config = chooseEglConfig(display, EGL_OPENGL_ES3_BIT_KHR);
+    if (config != NULL) {
+        context = createEglContext(display, config, 3);
+    }
+    if (context == EGL_NO_CONTEXT) {
+        config = chooseEglConfig(display, EGL_OPENGL_ES2_BIT);
+        context = createEglContext(display, config, 2);
+    }
     if (context == EGL_NO_CONTEXT) {
         return false;
     }
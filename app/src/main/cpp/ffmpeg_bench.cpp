@@ -0,0 +1,630 @@
+// linux上的benchmark工具,不依赖JNI和EGL,用来在开发机或者CI上衡量性能改动
+// 用法: ffmpeg_bench [选项] <文件或url>
+//   --mode decode|player|relay|seek|thumbnail|cadence
+//                          decode只测VideoDecoder的纯解码速度,player测整条多线程流水线(默认)
+//                          relay在本机启动rtmp转发服务,VideoSender推流,Player播放,统计端到端延迟
+//                          seek在文件里面来回seek,统计关键帧seek和精确seek解出目标帧的耗时
+//                          thumbnail用ThumbnailExtractor均匀地取缩略图,统计总耗时和每张的耗时
+//                          cadence不需要url,用ManualTimeSource模拟24/25/30fps在60/90/120Hz屏幕上的显示节奏
+//   --port N               relay模式的推流端口,播放端口是N+1,默认19350
+//   --threads N            软解线程数,thumbnail模式是线程池的线程数,0代表自动(默认)
+//   --thread-type auto|frame|slice
+//   --low-delay            低延迟模式
+//   --fast-open            快速打开
+//   --realtime             按照pts播放,默认不等待,测的是最大吞吐量
+//   --audio                播放音频(NullAudioSink),需要和--realtime一起使用
+//   --touch                渲染的时候读取画面数据,模拟上传纹理的内存开销
+//   --live-target MS       relay模式打开直播低延迟模式,目标延迟是MS毫秒
+//   --stall MS             relay和cadence模式在第STALL_FRAME帧的时候让渲染卡住MS毫秒,模拟网络或者渲染卡顿之后堆积的延迟
+//   --vsync HZ             player模式用定时器模拟HZ的vsync,按照vsync挑选显示的帧,需要和--realtime一起使用
+//   --count N              thumbnail模式取多少张缩略图,默认10
+//   --rgba                 thumbnail模式输出RGBA,默认输出jpeg
+
+#include "alloc_counter.h"
+#include "audio_sink.h"
+#include "latency_recorder.h"
+#include "null_renderer.h"
+#include "player.h"
+#include "rtmp_relay.h"
+#include "thumbnail_extractor.h"
+#include "video_decoder.h"
+#include "video_sender.h"
+#include "vsync_source.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <thread>
+#include <sys/resource.h>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+}
+
+using namespace std;
+
+struct BenchConfig {
+    string url;
+    string mode;
+    DecoderConfig decoder;
+    bool realtime;
+    bool audio;
+    bool touch;
+    int port;
+    int64_t liveTargetMs;
+    int64_t stallMs;
+    ThumbnailConfig thumbnail;
+    double vsyncHz;
+
+    BenchConfig() : mode("player"), realtime(false), audio(false), touch(false), port(19350), liveTargetMs(0), stallMs(0), vsyncHz(0) {}
+};
+
+// 一次测试的结果
+struct BenchResult {
+    int64_t frames;
+    int64_t elapsedUs;
+    int64_t allocations;
+};
+
+// seek模式在文件里面选多少个位置
+static const int SEEK_COUNT = 20;
+
+// 前面这些帧解码器和帧池还在分配缓冲,之后才算进入稳定状态
+static const int64_t WARMUP_FRAMES = 30;
+
+// relay和cadence模式在第几帧的时候模拟卡顿
+static const int64_t STALL_FRAME = 60;
+
+// cadence模式模拟的播放时长和每一帧的渲染耗时
+static const int CADENCE_SECONDS = 60;
+static const int64_t CADENCE_RENDER_US = 3000;
+
+// 单独统计稳定状态下每渲染一帧的内存分配次数,启动阶段的分配不算在内
+// 同时记下预热结束时帧池和数据包池的统计,用来检查之后帧这一层(AVFrame、画面缓冲、AVPacket)有没有新的分配
+class SteadyStateRenderer : public NullRenderer {
+public:
+    SteadyStateRenderer(bool touchPixels, Player* player)
+            : NullRenderer(touchPixels),
+              mPlayer(player),
+              mWarmupAllocations(0),
+              mLastAllocations(0) {
+    }
+
+    void Render(AVFrame* frame) override {
+        NullRenderer::Render(frame);
+        if(WARMUP_FRAMES == GetFrames()) {
+            // GetStats本身的分配不要算到稳定状态里面
+            PlayerStats stats = mPlayer->GetStats();
+            mWarmupFramePool = stats.framePool;
+            mWarmupPacketPool = stats.packetPool;
+            mWarmupAllocations = GetAllocationCount();
+        }
+        mLastAllocations = GetAllocationCount();
+    }
+
+    // 帧数不够的时候返回-1
+    double GetAllocationsPerFrame() {
+        int64_t frames = GetFrames() - WARMUP_FRAMES;
+        return frames > 0 ? (double) (mLastAllocations - mWarmupAllocations) / frames : -1;
+    }
+
+    const FramePoolStats& GetWarmupFramePool() {
+        return mWarmupFramePool;
+    }
+
+    const PacketPoolStats& GetWarmupPacketPool() {
+        return mWarmupPacketPool;
+    }
+
+private:
+    Player* mPlayer;
+    int64_t mWarmupAllocations;
+    int64_t mLastAllocations;
+    FramePoolStats mWarmupFramePool;
+    PacketPoolStats mWarmupPacketPool;
+};
+
+// 在STALL_FRAME帧的时候卡住一次,卡顿期间推流端还在继续发送,数据都堆积在播放器的缓冲里面
+class StallRenderer : public NullRenderer {
+public:
+    StallRenderer(bool touchPixels, int64_t stallUs) : NullRenderer(touchPixels), mStallUs(stallUs) {
+    }
+
+    void Render(AVFrame* frame) override {
+        NullRenderer::Render(frame);
+        if(mStallUs > 0 && STALL_FRAME == GetFrames()) {
+            av_usleep(mStallUs);
+        }
+    }
+
+private:
+    int64_t mStallUs;
+};
+
+static void printUsage() {
+    cout << "usage: ffmpeg_bench [--mode decode|player|relay|seek|thumbnail|cadence] [--port N] [--threads N] [--thread-type auto|frame|slice]"
+         << " [--low-delay] [--fast-open] [--realtime] [--audio] [--touch] [--live-target MS] [--stall MS] [--count N] [--rgba]"
+         << " [--vsync HZ] [--read-ahead KB] [--no-mmap] <url>" << endl;
+}
+
+static bool parseArgs(int argc, char** argv, BenchConfig& config) {
+    for(int i = 1 ; i < argc ; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if("--mode" == arg && hasValue) {
+            config.mode = argv[++i];
+        } else if("--port" == arg && hasValue) {
+            config.port = atoi(argv[++i]);
+        } else if("--threads" == arg && hasValue) {
+            config.decoder.threadCount = atoi(argv[++i]);
+        } else if("--thread-type" == arg && hasValue) {
+            string type = argv[++i];
+            if("frame" == type) {
+                config.decoder.threadType = DECODER_THREAD_FRAME;
+            } else if("slice" == type) {
+                config.decoder.threadType = DECODER_THREAD_SLICE;
+            } else {
+                config.decoder.threadType = DECODER_THREAD_AUTO;
+            }
+        } else if("--low-delay" == arg) {
+            config.decoder.lowDelay = true;
+        } else if("--fast-open" == arg) {
+            config.decoder.fastOpen = true;
+        } else if("--realtime" == arg) {
+            config.realtime = true;
+        } else if("--audio" == arg) {
+            config.audio = true;
+        } else if("--touch" == arg) {
+            config.touch = true;
+        } else if("--live-target" == arg && hasValue) {
+            config.liveTargetMs = atoll(argv[++i]);
+        } else if("--stall" == arg && hasValue) {
+            config.stallMs = atoll(argv[++i]);
+        } else if("--count" == arg && hasValue) {
+            config.thumbnail.count = atoi(argv[++i]);
+        } else if("--rgba" == arg) {
+            config.thumbnail.format = THUMBNAIL_RGBA;
+        } else if("--vsync" == arg && hasValue) {
+            config.vsyncHz = atof(argv[++i]);
+        } else if("--read-ahead" == arg && hasValue) {
+            config.decoder.readAheadSize = atoi(argv[++i]) * 1024;
+        } else if("--no-mmap" == arg) {
+            config.thumbnail.useMmap = false;
+        } else if(0 == arg.compare(0, 2, "--")) {
+            cout << "unknown option " << arg << endl;
+            return false;
+        } else {
+            config.url = arg;
+        }
+    }
+
+    if("cadence" == config.mode) {
+        return true;
+    }
+    if(config.url.empty() || ("decode" != config.mode && "player" != config.mode && "relay" != config.mode && "seek" != config.mode
+                               && "thumbnail" != config.mode) || config.thumbnail.count <= 0) {
+        return false;
+    }
+
+    // 没有按照真实速度播放的时候NullAudioSink拉取数据太慢,音频队列满了会卡住解复用线程
+    // relay模式总是按照真实速度播放
+    if(config.audio && !config.realtime && "relay" != config.mode) {
+        cout << "--audio requires --realtime" << endl;
+        return false;
+    }
+
+    // 极速模式不等待显示时间,也就不会等待vsync
+    if(config.vsyncHz > 0 && !config.realtime) {
+        cout << "--vsync requires --realtime" << endl;
+        return false;
+    }
+    return true;
+}
+
+static void printScheduler(const FrameSchedulerStats& stats) {
+    cout << "vsyncs " << stats.vsyncs
+         << ", presented " << stats.presentedFrames
+         << ", dropped " << stats.droppedFrames
+         << ", repeated " << stats.repeatedVsyncs
+         << ", cadence errors " << stats.cadenceErrors
+         << ", error avg/max " << stats.avgErrorUs << "/" << stats.maxErrorUs << "us"
+         << ", judder avg/max " << stats.avgJudderUs << "/" << stats.maxJudderUs << "us"
+         << ", holds";
+    for(int i = 0 ; i < MAX_HOLD_VSYNCS ; i++) {
+        if(stats.holds[i] > 0) {
+            cout << " " << i + 1 << (MAX_HOLD_VSYNCS - 1 == i ? "+:" : ":") << stats.holds[i];
+        }
+    }
+    cout << endl;
+}
+
+static void printLatency(const char* name, const LatencyStats& stats) {
+    cout << name << " latency(us): count " << stats.count
+         << ", avg " << stats.avgUs
+         << ", p50 " << stats.p50Us
+         << ", p90 " << stats.p90Us
+         << ", p99 " << stats.p99Us
+         << ", max " << stats.maxUs << endl;
+}
+
+// 单线程: 读包 + 解码,测的是解码器本身的速度
+static bool benchDecode(const BenchConfig& config, BenchResult& result) {
+    VideoDecoder decoder;
+    if(!decoder.Load(config.url, config.decoder)) {
+        return false;
+    }
+    decoder.SetFastMode(!config.realtime);
+
+    LatencyRecorder frameLatency;
+    int64_t allocations = GetAllocationCount();
+    int64_t start = av_gettime_relative();
+    int64_t last = start;
+    while(NULL != decoder.NextFrame()) {
+        int64_t now = av_gettime_relative();
+        frameLatency.Record(now - last);
+        last = now;
+        result.frames++;
+    }
+    result.elapsedUs = last - start;
+    result.allocations = GetAllocationCount() - allocations;
+
+    cout << "decoder: " << decoder.GetVideoWidth() << "x" << decoder.GetVideoHeight()
+         << ", pixel format " << av_get_pix_fmt_name(decoder.GetPixelFormat())
+         << ", " << decoder.GetThreadCount() << " threads" << endl;
+    printLatency("frame", frameLatency.GetStats());
+    decoder.Release();
+    return true;
+}
+
+// 多线程流水线: 解复用 -> 解码 -> NullRenderer,和安卓上的Player走的是同一套代码
+static bool benchPlayer(const BenchConfig& config, BenchResult& result) {
+    NullAudioSink audioSink;
+    Player player;
+    if(config.audio) {
+        player.SetAudioSink(&audioSink);
+    }
+    if(!player.Open(config.url, config.decoder)) {
+        return false;
+    }
+    player.SetFastMode(!config.realtime);
+
+    SystemTimeSource systemTime;
+    TimerVsyncSource vsync(&systemTime, config.vsyncHz);
+    if(config.vsyncHz > 0) {
+        player.SetVsyncSource(&vsync);
+    }
+
+    SteadyStateRenderer renderer(config.touch, &player);
+    int64_t allocations = GetAllocationCount();
+    int64_t start = av_gettime_relative();
+    player.Play(&renderer);
+    result.elapsedUs = av_gettime_relative() - start;
+    result.allocations = GetAllocationCount() - allocations;
+    result.frames = renderer.GetFrames();
+
+    PlayerStats stats = player.GetStats();
+    cout << "frame pool: frames " << stats.framePool.frameAllocs
+         << ", buffers " << stats.framePool.bufferAllocs << " x " << stats.framePool.bufferSize / 1024 << "KB"
+         << ", buffer gets " << stats.framePool.bufferGets
+         << ", fallbacks " << stats.framePool.fallbacks << endl;
+    cout << "packet pool: packets " << stats.packetPool.packetAllocs
+         << ", acquired " << stats.packetPool.acquired << endl;
+
+    // 预热之后帧这一层不应该再有任何分配
+    // 只有av_buffer_pool_get每次包装画面缓冲的AVBuffer和AVBufferRef避免不了,单独统计,剩下的是解复用器的数据和解码器内部的引用
+    bool steady = true;
+    int64_t steadyFrames = renderer.GetFrames() - WARMUP_FRAMES;
+    if(steadyFrames > 0) {
+        const FramePoolStats& framePool = renderer.GetWarmupFramePool();
+        const PacketPoolStats& packetPool = renderer.GetWarmupPacketPool();
+        int64_t frameAllocs = stats.framePool.frameAllocs - framePool.frameAllocs;
+        int64_t bufferAllocs = stats.framePool.bufferAllocs - framePool.bufferAllocs;
+        int64_t packetAllocs = stats.packetPool.packetAllocs - packetPool.packetAllocs;
+        steady = 0 == frameAllocs && 0 == bufferAllocs && 0 == packetAllocs;
+        cout << "frame layer after warm-up: frames +" << frameAllocs
+             << ", buffers +" << bufferAllocs
+             << ", packets +" << packetAllocs
+             << (steady ? ", ok" : ", FAILED: the frame layer should not allocate after warm-up") << endl;
+
+        if(IsAllocationCountSupported()) {
+            double wrappers = (double) (stats.framePool.bufferGets - framePool.bufferGets) * 2 / steadyFrames;
+            cout << "steady state allocations " << renderer.GetAllocationsPerFrame()
+                 << " per frame (after " << WARMUP_FRAMES << " frames): buffer pool wrappers " << wrappers
+                 << ", demuxer and decoder " << renderer.GetAllocationsPerFrame() - wrappers << endl;
+        }
+    }
+    cout << "player: demuxed " << stats.demuxedPackets
+         << ", decoded " << stats.decodedFrames
+         << ", rendered " << stats.renderedFrames
+         << ", dropped " << stats.sync.droppedFrames
+         << ", decode " << stats.decodeFps << " fps"
+         << ", " << stats.decodeThreads << " threads" << endl;
+    cout << "startup(ms): open " << stats.startup.openUs / 1000
+         << ", probe " << stats.startup.probeUs / 1000
+         << ", first packet " << stats.startup.firstPacketUs / 1000
+         << ", first frame " << stats.startup.firstFrameUs / 1000
+         << ", first render " << stats.startup.firstRenderUs / 1000 << endl;
+    printLatency("demux", stats.demuxLatency);
+    printLatency("decode", stats.decodeLatency);
+    printLatency("render", stats.renderLatency);
+    if(stats.vsync) {
+        printScheduler(stats.scheduler);
+    }
+    player.Close();
+    return steady;
+}
+
+// 端到端: 文件 -> VideoSender(打时间戳) -> RtmpRelay -> Player -> NullRenderer,全部在本机的回环地址上
+static bool benchRelay(const BenchConfig& config, BenchResult& result) {
+    RtmpRelay relay(config.port, 1);
+    relay.Start();
+
+    VideoSender sender;
+    sender.AddOutput(relay.GetPublishUrl());
+    sender.SetLatencyStamp(true);
+    if(config.thumbnail.useMmap) {
+        // 测试用的是不会变化的本地文件,可以放心用mmap读取,--no-mmap同样对这里生效
+        sender.SetInputOption("mmap", "1");
+    }
+    if(!sender.Open(config.url)) {
+        relay.Stop();
+        return false;
+    }
+
+    // 推流结束之后停止转发服务,播放端读到结尾就会结束
+    thread sendThread([&sender, &relay] {
+        sender.Run();
+        av_usleep(1000000);
+        relay.Stop();
+    });
+
+    // 转发服务收到推流之后播放端口才开始监听,连接失败的话稍等再试
+    // 播放端断开之后不重连,否则转发服务停止之后还要等很久才会结束
+    DecoderConfig decoderConfig = config.decoder;
+    decoderConfig.reconnectAttempts = 0;
+    decoderConfig.fastOpen = true;
+    NullAudioSink audioSink;
+    Player player;
+    if(config.audio) {
+        player.SetAudioSink(&audioSink);
+    }
+    if(config.liveTargetMs > 0) {
+        LiveConfig liveConfig;
+        liveConfig.enabled = true;
+        liveConfig.targetLatencyUs = config.liveTargetMs * 1000;
+        player.SetLiveConfig(liveConfig);
+    }
+    bool opened = false;
+    for(int i = 0 ; i < 50 && !opened ; i++) {
+        if(relay.IsPublishing()) {
+            opened = player.Open(relay.GetPlayUrl(0), decoderConfig);
+            if(!opened) {
+                player.Close();
+            }
+        }
+        if(!opened) {
+            av_usleep(100000);
+        }
+    }
+    if(!opened) {
+        sender.Stop();
+        sendThread.join();
+        return false;
+    }
+
+    // 直播流按照真实速度播放,这样统计的延迟才和真机上一致
+    StallRenderer renderer(config.touch, config.stallMs * 1000);
+    int64_t allocations = GetAllocationCount();
+    int64_t start = av_gettime_relative();
+    player.Play(&renderer);
+    result.elapsedUs = av_gettime_relative() - start;
+    result.allocations = GetAllocationCount() - allocations;
+    result.frames = renderer.GetFrames();
+
+    sender.Stop();
+    sendThread.join();
+    sender.DumpStats();
+    sender.Close();
+
+    PlayerStats stats = player.GetStats();
+    cout << "relay: rendered " << stats.renderedFrames << ", dropped " << stats.sync.droppedFrames
+         << ", first render " << stats.startup.firstRenderUs / 1000 << "ms" << endl;
+    if(stats.glassLatency.count > 0) {
+        printLatency("glass-to-glass", stats.glassLatency);
+    } else {
+        cout << "no latency stamps, only h264 in flv/mp4 is supported" << endl;
+    }
+    if(stats.live.enabled) {
+        cout << "live: latency " << stats.live.latencyUs / 1000 << "ms"
+             << ", max " << stats.live.maxLatencyUs / 1000 << "ms"
+             << ", catch up " << stats.live.catchUps << " times(" << stats.live.catchUpUs / 1000 << "ms)"
+             << ", jumps " << stats.live.jumps << endl;
+    }
+    printLatency("demux", stats.demuxLatency);
+    if(stats.readAhead.enabled) {
+        cout << "read ahead: buffered " << stats.readAhead.fillBytes / 1024 << "KB"
+             << ", stalls " << stats.readAhead.stalls << "(" << stats.readAhead.stallUs / 1000 << "ms)" << endl;
+    }
+    printLatency("decode", stats.decodeLatency);
+    player.Close();
+    return true;
+}
+
+// 均匀地选SEEK_COUNT个位置,打乱顺序之后前后来回跳,分别统计关键帧seek和精确seek解出第一帧的耗时
+static bool benchSeek(const BenchConfig& config, BenchResult& result) {
+    VideoDecoder decoder;
+    if(!decoder.Load(config.url, config.decoder)) {
+        return false;
+    }
+    decoder.SetFastMode(true);
+
+    int64_t duration = decoder.GetDuration();
+    if(!decoder.IsSeekable() || AV_NOPTS_VALUE == duration || duration <= 0) {
+        cout << config.url << " is not seekable" << endl;
+        return false;
+    }
+
+    int64_t allocations = GetAllocationCount();
+    int64_t start = av_gettime_relative();
+    SeekMode modes[] = {SEEK_KEYFRAME, SEEK_ACCURATE};
+    for(SeekMode mode : modes) {
+        LatencyRecorder seekLatency;
+        int64_t maxErrorUs = 0;
+        for(int i = 0 ; i < SEEK_COUNT ; i++) {
+            // 7和SEEK_COUNT互质,这样每个位置都会跳到一次,而且前后交替
+            int64_t target = duration * ((i * 7) % SEEK_COUNT) / SEEK_COUNT;
+            int64_t seekStart = av_gettime_relative();
+            AVFrame* frame = decoder.Seek(target, mode) ? decoder.NextFrame() : NULL;
+            if(NULL == frame) {
+                cout << "seek to " << target / 1000 << "ms failed" << endl;
+                continue;
+            }
+            seekLatency.Record(av_gettime_relative() - seekStart);
+
+            int64_t error = llabs(decoder.GetFramePts(frame) - target);
+            if(error > maxErrorUs) {
+                maxErrorUs = error;
+            }
+            result.frames++;
+        }
+        printLatency(SEEK_KEYFRAME == mode ? "keyframe seek" : "accurate seek", seekLatency.GetStats());
+        cout << "max distance to target " << maxErrorUs / 1000 << "ms"
+             << ", last seek discarded " << decoder.GetSeekStats().lastDiscardedFrames << " frames"
+             << ", skipped " << decoder.GetSeekStats().lastSkippedPackets << " packets" << endl;
+    }
+    result.elapsedUs = av_gettime_relative() - start;
+    result.allocations = GetAllocationCount() - allocations;
+    decoder.Release();
+    return true;
+}
+
+// 连续提取两次,第一次包含线程池启动和文件缓存的预热,第二次的耗时才和缩略图数量成正比
+static bool benchThumbnail(const BenchConfig& config, BenchResult& result) {
+    ThumbnailExtractor extractor(config.decoder.threadCount);
+    int64_t allocations = 0;
+    int64_t start = 0;
+    vector<Thumbnail> thumbnails;
+    for(int i = 0 ; i < 2 ; i++) {
+        allocations = GetAllocationCount();
+        start = av_gettime_relative();
+        thumbnails = extractor.Extract(config.url, config.thumbnail);
+    }
+    result.elapsedUs = av_gettime_relative() - start;
+    result.allocations = GetAllocationCount() - allocations;
+
+    int64_t bytes = 0;
+    for(const Thumbnail& thumbnail : thumbnails) {
+        if(thumbnail.data.empty()) {
+            cout << "thumbnail at " << thumbnail.targetUs / 1000 << "ms failed" << endl;
+            continue;
+        }
+        bytes += thumbnail.data.size();
+        result.frames++;
+    }
+    if(0 == result.frames) {
+        return false;
+    }
+
+    ThumbnailStats stats = extractor.GetStats();
+    cout << "thumbnails " << result.frames << "/" << thumbnails.size()
+         << " " << thumbnails[0].width << "*" << thumbnails[0].height
+         << ", avg " << bytes / result.frames << " bytes"
+         << ", " << result.elapsedUs / 1000 / result.frames << "ms per thumbnail" << endl;
+    cout << "total: seeks " << stats.seeks << ", read video packets " << stats.readPackets
+         << ", decoded frames " << stats.decodedFrames << endl;
+    return true;
+}
+
+// 和Player::vsyncRenderLoop一样的流程,只是帧直接按照fps生成,时间由ManualTimeSource推进,几毫秒就能跑完
+static FrameSchedulerStats simulateCadence(double fps, double hz, int64_t stallUs) {
+    ManualTimeSource time;
+    TimerVsyncSource vsync(&time, hz);
+    FrameScheduler scheduler;
+
+    // 第一帧在第一个vsync显示,之后的显示时间按照帧率计算,不累积误差
+    int64_t frames = (int64_t) (fps * CADENCE_SECONDS);
+    int64_t duration = (int64_t) (1000000 / fps + 0.5);
+    int64_t start = -1;
+    int64_t i = 0;
+    while(i < frames) {
+        int64_t displayTime = vsync.WaitForVsync();
+        scheduler.OnVsync(displayTime, vsync.GetPeriodUs());
+        if(-1 == start) {
+            start = displayTime;
+        }
+        if(!scheduler.IsDue(start + (int64_t) (i * 1000000 / fps + 0.5))) {
+            continue;
+        }
+        while(i + 1 < frames && scheduler.IsDue(start + (int64_t) ((i + 1) * 1000000 / fps + 0.5))) {
+            scheduler.OnFrameDropped();
+            i++;
+        }
+        scheduler.OnFramePresented(start + (int64_t) (i * 1000000 / fps + 0.5), duration);
+        time.Advance(CADENCE_RENDER_US + (STALL_FRAME == i ? stallUs : 0));
+        i++;
+    }
+    return scheduler.GetStats();
+}
+
+static bool benchCadence(const BenchConfig& config, BenchResult& result) {
+    double rates[] = {24, 25, 30};
+    double refreshRates[] = {60, 90, 120};
+    int64_t start = av_gettime_relative();
+    for(double hz : refreshRates) {
+        for(double fps : rates) {
+            FrameSchedulerStats stats = simulateCadence(fps, hz, config.stallMs * 1000);
+            cout << fps << "fps@" << hz << "Hz(" << hz / fps << " vsyncs per frame): ";
+            printScheduler(stats);
+            result.frames += stats.presentedFrames;
+        }
+    }
+    result.elapsedUs = av_gettime_relative() - start;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if(!parseArgs(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    BenchResult result = {0, 0, 0};
+    bool success;
+    if("decode" == config.mode) {
+        success = benchDecode(config, result);
+    } else if("relay" == config.mode) {
+        success = benchRelay(config, result);
+    } else if("seek" == config.mode) {
+        success = benchSeek(config, result);
+    } else if("thumbnail" == config.mode) {
+        success = benchThumbnail(config, result);
+    } else if("cadence" == config.mode) {
+        success = benchCadence(config, result);
+    } else {
+        success = benchPlayer(config, result);
+    }
+    if(!success) {
+        cout << "bench " << config.url << " failed" << endl;
+        return 1;
+    }
+
+    double seconds = result.elapsedUs / 1000000.0;
+    cout << "frames " << result.frames << " in " << result.elapsedUs / 1000 << "ms, "
+         << (seconds > 0 ? result.frames / seconds : 0) << " fps" << endl;
+
+    if(IsAllocationCountSupported()) {
+        cout << "allocations " << result.allocations << ", "
+             << (result.frames > 0 ? (double) result.allocations / result.frames : 0) << " per frame" << endl;
+    }
+
+    // linux上ru_maxrss的单位是KB
+    struct rusage usage;
+    if(0 == getrusage(RUSAGE_SELF, &usage)) {
+        cout << "peak rss " << usage.ru_maxrss << "KB" << endl;
+        cout << "cpu user " << usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000 << "ms"
+             << ", sys " << usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000 << "ms"
+             << ", page faults " << usage.ru_minflt << " minor " << usage.ru_majflt << " major" << endl;
+    }
+    return 0;
+}
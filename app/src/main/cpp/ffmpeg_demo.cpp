@@ -5,18 +5,32 @@
 #include "opengl_display.h"
 #include "egl_helper.h"
 #include "video_decoder.h"
+#include "player.h"
+#include "surface_texture_helper.h"
+#include "opensl_audio_sink.h"
+#include "choreographer_vsync_source.h"
+#include "thumbnail_extractor.h"
 #include <unistd.h>
+#include <mutex>
 
 extern "C" {
 #include <libavcodec/codec.h>
 #include <libavformat/avio.h>
 #include <libavformat/avformat.h>
-#include <libavfilter/avfilter.h>
+#include <libavcodec/jni.h>
+#include <libavcodec/mediacodec.h>
+#include <libavutil/time.h>
 }
 
 static const char *TAG = "FFmpegDemo";
 #define LOGD(fmt, args...) __android_log_print(ANDROID_LOG_DEBUG, TAG, fmt, ##args)
 
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+    // FFmpeg的MediaCodec解码器是通过JNI调用java层的MediaCodec实现的,需要先把JavaVM交给它
+    av_jni_set_java_vm(vm, NULL);
+    return JNI_VERSION_1_6;
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_me_linjw_demo_ffmpeg_MainActivity_send(
         JNIEnv *env,
@@ -29,39 +43,212 @@ Java_me_linjw_demo_ffmpeg_MainActivity_send(
     VideoSender::Send(src, dest);
 }
 
+// 正在播放的Player,给seek等需要在其他线程控制播放的接口使用
+static std::mutex sPlayerMutex;
+static Player* sPlayer = NULL;
+
+// 直播低延迟模式的目标延迟,0代表关闭,下一次play的时候生效
+static int64_t sLiveTargetLatencyMs = 1000;
+
 extern "C" JNIEXPORT void JNICALL
-Java_me_linjw_demo_ffmpeg_MainActivity_play(
+Java_me_linjw_demo_ffmpeg_MainActivity_setLiveTargetLatency(
+        JNIEnv *env,
+        jobject /* this */,
+        jlong timeMs) {
+    std::lock_guard<std::mutex> lock(sPlayerMutex);
+    sLiveTargetLatencyMs = timeMs;
+}
+
+// 返回{当前延迟(毫秒), 缓冲的数据包数量},没有在播放的时候返回NULL
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_me_linjw_demo_ffmpeg_MainActivity_getLiveStats(
+        JNIEnv *env,
+        jobject /* this */) {
+    std::lock_guard<std::mutex> lock(sPlayerMutex);
+    if(NULL == sPlayer) {
+        return NULL;
+    }
+    LiveStats stats = sPlayer->GetLiveStats();
+    jlong values[] = {stats.latencyUs / 1000, stats.bufferedPackets};
+    jlongArray result = env->NewLongArray(2);
+    if(NULL != result) {
+        env->SetLongArrayRegion(result, 0, 2, values);
+    }
+    return result;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_linjw_demo_ffmpeg_MainActivity_seek(
+        JNIEnv *env,
+        jobject /* this */,
+        jlong timeUs,
+        jboolean accurate) {
+    std::lock_guard<std::mutex> lock(sPlayerMutex);
+    if(NULL == sPlayer) {
+        return JNI_FALSE;
+    }
+    LOGD("seek to %lldms, accurate %d", (long long) timeUs / 1000, accurate);
+    return sPlayer->Seek(timeUs, accurate ? SEEK_ACCURATE : SEEK_KEYFRAME) ? JNI_TRUE : JNI_FALSE;
+}
+
+// 返回均匀分布的count张jpeg缩略图,宽度是width,高度按照视频的宽高比计算
+// 取失败的位置对应的元素是null
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_me_linjw_demo_ffmpeg_MainActivity_extractThumbnails(
         JNIEnv *env,
         jobject /* this */,
         jstring url,
-        jobject jSurface,
-        jint width,
-        jint height) {
+        jint count,
+        jint width) {
+    // 线程池在第一次调用的时候创建,之后一直复用
+    static ThumbnailExtractor extractor;
+
+    ThumbnailConfig config;
+    config.count = count;
+    config.width = width;
+    config.format = THUMBNAIL_JPEG;
+
     const char *urlStr = env->GetStringUTFChars(url, NULL);
+    int64_t start = av_gettime_relative();
+    std::vector<Thumbnail> thumbnails = extractor.Extract(urlStr, config);
+    LOGD("extract %d thumbnails from %s cost %lldms", (int) thumbnails.size(), urlStr,
+         (long long) (av_gettime_relative() - start) / 1000);
+    env->ReleaseStringUTFChars(url, urlStr);
+
+    jobjectArray result = env->NewObjectArray(thumbnails.size(), env->FindClass("[B"), NULL);
+    if(NULL == result) {
+        return NULL;
+    }
+    for(size_t i = 0 ; i < thumbnails.size() ; i++) {
+        const std::vector<uint8_t>& data = thumbnails[i].data;
+        if(data.empty()) {
+            continue;
+        }
+        jbyteArray bytes = env->NewByteArray(data.size());
+        if(NULL == bytes) {
+            break;
+        }
+        env->SetByteArrayRegion(bytes, 0, data.size(), (const jbyte*) data.data());
+        env->SetObjectArrayElement(result, i, bytes);
+        env->DeleteLocalRef(bytes);
+    }
+    return result;
+}
+
+// 将Player渲染线程交过来的画面通过OpenGL绘制到Surface上
+class SurfaceRenderer : public VideoRenderer {
+public:
+    SurfaceRenderer(JNIEnv *env, EGLHelper& eglHelper, OpenGlDisplay& display, SurfaceTextureHelper& surfaceTexture)
+            : mEnv(env), mEglHelper(eglHelper), mDisplay(display), mSurfaceTexture(surfaceTexture) {
+    }
 
-    VideoDecoder decoder;
-    decoder.Load(urlStr);
-    LOGD("play %s %d*%d, %d*%d", urlStr, width, height, decoder.GetVideoWidth(), decoder.GetVideoHeight());
+    void Render(AVFrame* frame) override {
+        mEglHelper.MakeCurrent();
+        if(frame->format == AV_PIX_FMT_MEDIACODEC) {
+            // 硬解的画面在MediaCodec的输出缓冲里,释放的时候指定渲染就会被送到SurfaceTexture上
+            // 然后通过updateTexImage更新到OES纹理,整个过程画面数据都不会经过cpu内存
+            av_mediacodec_release_buffer((AVMediaCodecBuffer*) frame->data[3], 1);
+            mSurfaceTexture.UpdateTexImage(mEnv);
 
-    if(decoder.GetPixelFormat() != AV_PIX_FMT_YUV420P) {
-        LOGD("only support yuv420, the video format is %d", decoder.GetPixelFormat());
-        return;
+            float matrix[16];
+            mSurfaceTexture.GetTransformMatrix(mEnv, matrix);
+            mDisplay.RenderOes(matrix);
+        } else {
+            mDisplay.Render(frame);
+        }
+        mEglHelper.SwapBuffers();
     }
 
+private:
+    JNIEnv *mEnv;
+    EGLHelper& mEglHelper;
+    OpenGlDisplay& mDisplay;
+    SurfaceTextureHelper& mSurfaceTexture;
+};
+
+extern "C" JNIEXPORT void JNICALL
+Java_me_linjw_demo_ffmpeg_MainActivity_play(
+        JNIEnv *env,
+        jobject /* this */,
+        jstring url,
+        jobject jSurface,
+        jint width,
+        jint height,
+        jboolean hardware) {
+    const char *urlStr = env->GetStringUTFChars(url, NULL);
+
+    // MediaCodec硬解需要在打开解码器之前准备好SurfaceTexture,而SurfaceTexture又需要EGL上下文来创建OES纹理
+    // 所以这里先初始化EGL
     EGLHelper eglHelper;
     eglHelper.Init(env, jSurface);
 
     OpenGlDisplay display;
-    bool result = display.Init(width, height, decoder.GetVideoWidth(), decoder.GetVideoHeight());
+    SurfaceTextureHelper surfaceTexture;
+    DecoderConfig config;
+
+    // 直播流用快速打开,尽快出第一帧画面,并且由单独的线程预读网络数据
+    config.fastOpen = IsNetworkUrl(urlStr);
+    config.readAheadSize = 1024 * 1024;
+    if(hardware && surfaceTexture.Init(env, display.CreateOesTexture())) {
+        config.mediaCodecSurface = surfaceTexture.GetSurface();
+    }
+
+    // 音频通过OpenSL ES播放,并作为音视频同步的主时钟
+    OpenSLAudioSink audioSink;
+    Player player;
+    player.SetAudioSink(&audioSink);
 
-    AVFrame *frame;
-    while ((frame = decoder.NextFrame()) != NULL) {
-        eglHelper.MakeCurrent();
-        display.Render(frame->data, frame->linesize);
-        eglHelper.SwapBuffers();
+    // 按照屏幕的vsync挑选每次刷新显示哪一帧,系统不支持AChoreographer的话还是等到显示时间就马上渲染
+    ChoreographerVsyncSource vsync;
+    if(vsync.Init()) {
+        player.SetVsyncSource(&vsync);
     }
+    {
+        // 只对直播流生效,本地文件和点播流不受影响
+        std::lock_guard<std::mutex> lock(sPlayerMutex);
+        LiveConfig liveConfig;
+        liveConfig.enabled = sLiveTargetLatencyMs > 0;
+        liveConfig.targetLatencyUs = sLiveTargetLatencyMs * 1000;
+        player.SetLiveConfig(liveConfig);
+    }
+    player.Open(urlStr, config);
+    VideoDecoder& decoder = player.GetDecoder();
+    LOGD("play %s %d*%d, %d*%d, hardware %d", urlStr, width, height,
+         decoder.GetVideoWidth(), decoder.GetVideoHeight(), decoder.IsHardware());
+
+    // NV12、10bit、RGB等格式都由着色器直接转换,不需要在cpu上做sws_scale
+    AVPixelFormat pixelFormat = decoder.IsHardware() ? AV_PIX_FMT_MEDIACODEC : decoder.GetPixelFormat();
+    if(!OpenGlDisplay::IsSupported(pixelFormat)) {
+        LOGD("unsupported pixel format %d", pixelFormat);
+        player.Close();
+        surfaceTexture.Destroy(env);
+        display.Destroy();
+        eglHelper.Destroy();
+        return;
+    }
+
+    bool result = display.Init(width, height, decoder.GetVideoWidth(), decoder.GetVideoHeight(), pixelFormat);
+
+    // 解复用和解码在Player内部的线程进行,当前线程只负责渲染
+    SurfaceRenderer renderer(env, eglHelper, display, surfaceTexture);
+    {
+        std::lock_guard<std::mutex> lock(sPlayerMutex);
+        sPlayer = &player;
+    }
+    player.Play(&renderer);
+    {
+        std::lock_guard<std::mutex> lock(sPlayerMutex);
+        sPlayer = NULL;
+    }
+    player.DumpStats();
+
+    UploadStats upload = display.GetUploadStats();
+    LOGD("texture upload(%s): frames %lld, last %lldus, avg %lldus, max %lldus", upload.pbo ? "pbo" : "ring",
+         (long long) upload.frames, (long long) upload.lastUs, (long long) upload.avgUs, (long long) upload.maxUs);
 
-    decoder.Release();
+    // 需要先关闭解码器,再释放它输出的Surface
+    player.Close();
+    surfaceTexture.Destroy(env);
     display.Destroy();
     eglHelper.Destroy();
     LOGD("play: finish %d", result);
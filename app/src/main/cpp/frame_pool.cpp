@@ -0,0 +1,228 @@
+#include "frame_pool.h"
+
+#include <climits>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+using namespace std;
+
+// 和FFmpeg默认的get_buffer2一样,每个平面的末尾多留一些空间,有些SIMD代码会越过平面的末尾读取
+static const int PLANE_PADDING = 16;
+
+static uint8_t* alignPointer(uint8_t* pointer, int align) {
+    return (uint8_t*) (((uintptr_t) pointer + align - 1) & ~((uintptr_t) align - 1));
+}
+
+FramePool::FramePool(int frameCount)
+        : mBufferPool(NULL),
+          mWidth(0),
+          mHeight(0),
+          mFormat(AV_PIX_FMT_NONE),
+          mBufferSize(0),
+          mAcquired(0),
+          mFrameAllocs(0),
+          mFramesInUse(0),
+          mBufferGets(0),
+          mBufferAllocs(0),
+          mFallbacks(0) {
+    // 预留好空间,Release的时候push_back就不会再分配内存
+    mFreeFrames.reserve(frameCount);
+    for(int i = 0 ; i < frameCount ; i++) {
+        AVFrame* frame = av_frame_alloc();
+        if(NULL == frame) {
+            break;
+        }
+        mFreeFrames.push_back(frame);
+        mFrameAllocs++;
+    }
+    for(int i = 0 ; i < 4 ; i++) {
+        mLinesize[i] = 0;
+        mOffset[i] = -1;
+    }
+}
+
+FramePool::~FramePool() {
+    for(AVFrame* frame : mFreeFrames) {
+        av_frame_free(&frame);
+    }
+    mFreeFrames.clear();
+
+    // 还在使用的缓冲不会马上释放,等到最后一个引用释放的时候AVBufferPool才会真正销毁
+    av_buffer_pool_uninit(&mBufferPool);
+}
+
+void FramePool::Attach(AVCodecContext* context) {
+    context->opaque = this;
+    context->get_buffer2 = getBuffer;
+
+    // getBuffer加了锁,可以在解码器的多个线程里面同时调用
+    // 不设置的话frame threading会把每一次get_buffer2都转到主线程上排队执行
+#if FF_API_THREAD_SAFE_CALLBACKS
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    context->thread_safe_callbacks = 1;
+#pragma GCC diagnostic pop
+#endif
+}
+
+AVFrame* FramePool::Acquire() {
+    lock_guard<mutex> lock(mMutex);
+    AVFrame* frame = NULL;
+    if(mFreeFrames.empty()) {
+        frame = av_frame_alloc();
+        if(NULL == frame) {
+            return NULL;
+        }
+        mFrameAllocs++;
+    } else {
+        frame = mFreeFrames.back();
+        mFreeFrames.pop_back();
+    }
+    mAcquired++;
+    mFramesInUse++;
+    return frame;
+}
+
+void FramePool::Release(AVFrame* frame) {
+    if(NULL == frame) {
+        return;
+    }
+
+    // 在锁外面unref,画面缓冲回到AVBufferPool有它自己的锁
+    av_frame_unref(frame);
+
+    lock_guard<mutex> lock(mMutex);
+    mFreeFrames.push_back(frame);
+    mFramesInUse--;
+}
+
+FramePoolStats FramePool::GetStats() {
+    lock_guard<mutex> lock(mMutex);
+    FramePoolStats stats;
+    stats.acquired = mAcquired;
+    stats.frameAllocs = mFrameAllocs;
+    stats.bufferGets = mBufferGets;
+    stats.bufferAllocs = mBufferAllocs;
+    stats.fallbacks = mFallbacks;
+    stats.framesInUse = mFramesInUse;
+    stats.bufferSize = mBufferSize;
+    return stats;
+}
+
+int FramePool::getBuffer(AVCodecContext* context, AVFrame* frame, int flags) {
+    FramePool* pool = static_cast<FramePool*>(context->opaque);
+
+    // 解码器没有AV_CODEC_CAP_DR1代表它不支持把画面解到外部提供的缓冲里面
+    // 硬件像素格式的缓冲由硬件上下文管理,也不能用这里的内存
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+    if(AVMEDIA_TYPE_VIDEO != context->codec_type
+       || !(context->codec->capabilities & AV_CODEC_CAP_DR1)
+       || NULL == desc
+       || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+        pool->mFallbacks++;
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+
+    int ret = pool->getVideoBuffer(context, frame);
+    if(ret < 0) {
+        pool->mFallbacks++;
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+    return ret;
+}
+
+#if FF_API_BUFFER_SIZE_T
+AVBufferRef* FramePool::allocBuffer(void* opaque, int size) {
+#else
+AVBufferRef* FramePool::allocBuffer(void* opaque, size_t size) {
+#endif
+    static_cast<FramePool*>(opaque)->mBufferAllocs++;
+
+    // 有些解码器会读到画面边缘之外没有写过的像素,清零之后结果是确定的,而且只有第一次分配的时候需要清零
+    return av_buffer_allocz(size);
+}
+
+int FramePool::getVideoBuffer(AVCodecContext* context, AVFrame* frame) {
+    // frame threading的时候多个解码线程可能同时取缓冲
+    lock_guard<mutex> lock(mMutex);
+    if(NULL == mBufferPool || frame->format != mFormat || frame->width != mWidth || frame->height != mHeight) {
+        if(!updateLayout(context, frame)) {
+            return AVERROR(EINVAL);
+        }
+    }
+
+    AVBufferRef* buffer = av_buffer_pool_get(mBufferPool);
+    if(NULL == buffer) {
+        return AVERROR(ENOMEM);
+    }
+    mBufferGets++;
+
+    // 所有平面放在同一个缓冲里面,frame->buf[0]持有整个缓冲的引用
+    for(int i = 0 ; i < 4 ; i++) {
+        frame->linesize[i] = mLinesize[i];
+        frame->data[i] = mOffset[i] >= 0 ? alignPointer(buffer->data + mOffset[i], BUFFER_ALIGN) : NULL;
+    }
+    frame->buf[0] = buffer;
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+// 按照avcodec_align_dimensions2的要求计算每个平面的行宽和大小,和FFmpeg默认的get_buffer2算法一致
+bool FramePool::updateLayout(AVCodecContext* context, AVFrame* frame) {
+    int width = frame->width;
+    int height = frame->height;
+    int strideAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width, &height, strideAlign);
+
+    // 不能单独对齐每个平面的行宽,有些解码器假设色度平面的行宽正好是亮度的一半
+    int linesize[4];
+    bool unaligned = false;
+    do {
+        if(av_image_fill_linesizes(linesize, (AVPixelFormat) frame->format, width) < 0) {
+            return false;
+        }
+        width += width & ~(width - 1);
+
+        unaligned = false;
+        for(int i = 0 ; i < 4 ; i++) {
+            if(0 != linesize[i] % strideAlign[i]) {
+                unaligned = true;
+            }
+        }
+    } while(unaligned);
+
+    ptrdiff_t linesizes[4];
+    size_t planeSizes[4];
+    for(int i = 0 ; i < 4 ; i++) {
+        linesizes[i] = linesize[i];
+    }
+    if(av_image_fill_plane_sizes(planeSizes, (AVPixelFormat) frame->format, height, linesizes) < 0) {
+        return false;
+    }
+
+    // 每个平面的起始地址都要对齐,所以每个平面额外预留BUFFER_ALIGN - 1字节,不存在的平面偏移是-1
+    int64_t size = 0;
+    for(int i = 0 ; i < 4 ; i++) {
+        mLinesize[i] = linesize[i];
+        mOffset[i] = planeSizes[i] > 0 ? (int) size : -1;
+        size += planeSizes[i] > 0 ? planeSizes[i] + PLANE_PADDING + BUFFER_ALIGN - 1 : 0;
+    }
+    if(size <= 0 || size > INT_MAX) {
+        return false;
+    }
+
+    // 旧的缓冲池要等引用它的帧都释放之后才会真正销毁
+    av_buffer_pool_uninit(&mBufferPool);
+    mBufferPool = av_buffer_pool_init2((int) size, this, allocBuffer, NULL);
+    if(NULL == mBufferPool) {
+        return false;
+    }
+    mBufferSize = (int) size;
+    mWidth = frame->width;
+    mHeight = frame->height;
+    mFormat = frame->format;
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef __FRAME_POOL_H__
+#define __FRAME_POOL_H__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+struct FramePoolStats {
+    int64_t acquired;      // Acquire的次数
+    int64_t frameAllocs;   // 新分配的AVFrame数量,预分配的也算在内,播放稳定之后不再增长
+    int64_t bufferGets;    // 解码器从缓冲池取画面缓冲的次数
+    int64_t bufferAllocs;  // 缓冲池新分配的画面缓冲数量,播放稳定之后不再增长
+    int64_t fallbacks;     // 硬解或者解码器不支持自定义缓冲,交给avcodec_default_get_buffer2的次数
+    int64_t framesInUse;   // 已经Acquire还没有Release的AVFrame数量
+    int bufferSize;        // 每个画面缓冲的字节数
+};
+
+// 解码线程和渲染线程之间传递的帧池
+// 原来每一帧都要av_frame_alloc一个AVFrame,解码器还要为每一帧的画面数据分配几MB的内存,渲染完之后再全部释放
+// 这里分两层复用:
+//   AVFrame本身: 预先分配好放在空闲列表里面,解码线程Acquire,渲染线程用完之后Release放回来
+//   画面数据: 通过get_buffer2让解码器直接解到AVBufferPool的缓冲里面,帧被av_frame_unref的时候缓冲自动回到池里
+// 缓冲的数量由解码器的参考帧、帧队列的长度等决定,播放开始之后很快就会稳定下来,之后不再分配新的缓冲
+// 宽高或者像素格式变化的时候会重新创建缓冲池,旧的缓冲在引用都释放之后自动回收
+// 注意FFmpeg的AVBufferRef和AVBuffer这两个几十字节的小结构体每次取缓冲还是会分配,这是AVBufferPool本身的实现决定的
+class FramePool {
+public:
+    explicit FramePool(int frameCount);
+    ~FramePool();
+
+    // 在avcodec_open2之前调用,让解码器从这个池里面取画面缓冲,FramePool需要比解码器上下文活得更久
+    void Attach(AVCodecContext* context);
+
+    // 空闲列表为空的时候会新分配一个,所以不会失败,除非内存不足返回NULL
+    AVFrame* Acquire();
+
+    // av_frame_unref之后放回空闲列表,画面缓冲也随之回到缓冲池
+    void Release(AVFrame* frame);
+
+    FramePoolStats GetStats();
+
+private:
+    // 和FFmpeg内部的STRIDE_ALIGN保持一致,64字节可以满足所有平台的SIMD对齐要求
+    static const int BUFFER_ALIGN = 64;
+
+    std::mutex mMutex;
+    std::vector<AVFrame*> mFreeFrames;
+
+    // 当前缓冲池对应的画面参数,变化的时候需要重新计算布局
+    AVBufferPool* mBufferPool;
+    int mWidth;
+    int mHeight;
+    int mFormat;
+    int mBufferSize;
+    int mLinesize[4];
+    int mOffset[4];
+
+    int64_t mAcquired;
+    int64_t mFrameAllocs;
+    int64_t mFramesInUse;
+    int64_t mBufferGets;
+    std::atomic<int64_t> mBufferAllocs;
+    std::atomic<int64_t> mFallbacks;
+
+    static int getBuffer(AVCodecContext* context, AVFrame* frame, int flags);
+
+#if FF_API_BUFFER_SIZE_T
+    static AVBufferRef* allocBuffer(void* opaque, int size);
+#else
+    static AVBufferRef* allocBuffer(void* opaque, size_t size);
+#endif
+
+    int getVideoBuffer(AVCodecContext* context, AVFrame* frame);
+    bool updateLayout(AVCodecContext* context, AVFrame* frame);
+};
+
+#endif
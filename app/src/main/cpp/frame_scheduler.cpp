@@ -0,0 +1,127 @@
+#include "frame_scheduler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+// 帧间隔/刷新周期很接近整数的时候(比如30fps在60Hz上是1.9999)当作整数,不允许停留的vsync数量有误差
+static const double CADENCE_TOLERANCE = 0.05;
+
+FrameScheduler::FrameScheduler()
+        : mDisplayTime(-1),
+          mPeriodUs(0),
+          mPresentedInVsync(false),
+          mHasLastFrame(false),
+          mLastDisplayTime(0),
+          mLastPresentTime(0),
+          mLastDurationUs(0),
+          mDroppedSinceLast(false),
+          mVsyncs(0),
+          mPresentedFrames(0),
+          mDroppedFrames(0),
+          mRepeatedVsyncs(0),
+          mCadenceErrors(0),
+          mErrorSum(0),
+          mMaxError(0),
+          mJudderSum(0),
+          mJudderCount(0),
+          mMaxJudder(0) {
+    memset(mHolds, 0, sizeof(mHolds));
+}
+
+void FrameScheduler::OnVsync(int64_t displayTime, int64_t periodUs) {
+    lock_guard<mutex> lock(mMutex);
+    if(-1 == mDisplayTime) {
+        mVsyncs++;
+    } else {
+        // 渲染太慢错过的vsync屏幕上也是继续显示上一帧
+        int64_t vsyncs = countVsyncs(mDisplayTime, displayTime);
+        mVsyncs += vsyncs;
+        if(mHasLastFrame) {
+            mRepeatedVsyncs += vsyncs - 1 + (mPresentedInVsync ? 0 : 1);
+        }
+    }
+    mDisplayTime = displayTime;
+    mPeriodUs = periodUs;
+    mPresentedInVsync = false;
+}
+
+bool FrameScheduler::IsDue(int64_t presentTime) {
+    lock_guard<mutex> lock(mMutex);
+    return presentTime < mDisplayTime + mPeriodUs / 2;
+}
+
+void FrameScheduler::OnFramePresented(int64_t presentTime, int64_t durationUs) {
+    lock_guard<mutex> lock(mMutex);
+    mPresentedFrames++;
+    mPresentedInVsync = true;
+
+    int64_t error = llabs(mDisplayTime - presentTime);
+    mErrorSum += error;
+    if(error > mMaxError) {
+        mMaxError = error;
+    }
+
+    // 中间有帧被丢掉的话,上一帧的停留时间本来就包含了被丢掉的帧,不算节奏错误,丢帧已经单独统计了
+    if(mHasLastFrame && !mDroppedSinceLast) {
+        int64_t hold = countVsyncs(mLastDisplayTime, mDisplayTime);
+        mHolds[(hold < MAX_HOLD_VSYNCS ? hold : MAX_HOLD_VSYNCS) - 1]++;
+
+        double ratio = mPeriodUs > 0 ? (double) mLastDurationUs / mPeriodUs : 0;
+        if(mLastDurationUs > 0 && (hold < floor(ratio + CADENCE_TOLERANCE) || hold > ceil(ratio - CADENCE_TOLERANCE))) {
+            mCadenceErrors++;
+        }
+
+        int64_t judder = llabs((mDisplayTime - mLastDisplayTime) - (presentTime - mLastPresentTime));
+        mJudderSum += judder;
+        mJudderCount++;
+        if(judder > mMaxJudder) {
+            mMaxJudder = judder;
+        }
+    }
+
+    mHasLastFrame = true;
+    mLastDisplayTime = mDisplayTime;
+    mLastPresentTime = presentTime;
+    mLastDurationUs = durationUs;
+    mDroppedSinceLast = false;
+}
+
+void FrameScheduler::OnFrameDropped() {
+    lock_guard<mutex> lock(mMutex);
+    mDroppedFrames++;
+    mDroppedSinceLast = true;
+}
+
+void FrameScheduler::Reset() {
+    lock_guard<mutex> lock(mMutex);
+    mHasLastFrame = false;
+    mDroppedSinceLast = false;
+}
+
+FrameSchedulerStats FrameScheduler::GetStats() {
+    lock_guard<mutex> lock(mMutex);
+    FrameSchedulerStats stats;
+    stats.periodUs = mPeriodUs;
+    stats.vsyncs = mVsyncs;
+    stats.presentedFrames = mPresentedFrames;
+    stats.droppedFrames = mDroppedFrames;
+    stats.repeatedVsyncs = mRepeatedVsyncs;
+    stats.cadenceErrors = mCadenceErrors;
+    stats.avgErrorUs = mPresentedFrames > 0 ? mErrorSum / mPresentedFrames : 0;
+    stats.maxErrorUs = mMaxError;
+    stats.avgJudderUs = mJudderCount > 0 ? mJudderSum / mJudderCount : 0;
+    stats.maxJudderUs = mMaxJudder;
+    memcpy(stats.holds, mHolds, sizeof(mHolds));
+    return stats;
+}
+
+int64_t FrameScheduler::countVsyncs(int64_t from, int64_t to) {
+    if(mPeriodUs <= 0) {
+        return 1;
+    }
+    int64_t count = (to - from + mPeriodUs / 2) / mPeriodUs;
+    return count > 0 ? count : 1;
+}
@@ -0,0 +1,85 @@
+#ifndef __FRAME_SCHEDULER_H__
+#define __FRAME_SCHEDULER_H__
+
+#include <mutex>
+#include <stdint.h>
+
+// 统计每一帧在屏幕上停留了几个vsync,超过的都算在最后一个里面
+static const int MAX_HOLD_VSYNCS = 6;
+
+struct FrameSchedulerStats {
+    int64_t periodUs;          // 最近一次的刷新周期
+    int64_t vsyncs;            // 经过的vsync数量,包括渲染太慢错过的
+    int64_t presentedFrames;   // 显示的帧数
+    int64_t droppedFrames;     // 还没有显示就被同一个vsync里面更新的帧顶掉的帧数
+    int64_t repeatedVsyncs;    // 没有新画面、屏幕继续显示上一帧的vsync数量
+
+    // 一帧停留的vsync数量不是帧间隔/刷新周期向上或者向下取整的结果,比如24fps在60Hz上不是2或者3
+    // 正确的节奏下不会出现,出现了说明渲染错过了vsync或者时钟有抖动
+    int64_t cadenceErrors;
+
+    int64_t avgErrorUs;        // 实际显示时间和理想显示时间的平均偏差(绝对值),正确的节奏下不超过半个周期
+    int64_t maxErrorUs;
+    int64_t avgJudderUs;       // 相邻两帧的实际显示间隔和pts间隔的平均偏差,24fps在60Hz上3:2交替本身就有半个周期左右
+    int64_t maxJudderUs;
+
+    // holds[i]是停留了i+1个vsync的帧数量
+    int64_t holds[MAX_HOLD_VSYNCS];
+};
+
+// 按照vsync挑选要显示的帧
+// 原来渲染线程用av_usleep等到每一帧的显示时间就马上渲染,实际显示出来要等到之后的某个vsync,
+// 睡眠的误差会让本来应该在同一个vsync显示的帧有时早一个vsync有时晚一个,节奏就乱了
+// 现在渲染线程每个vsync醒来一次,只有理想显示时间离这次vsync的显示时间比离下一次更近的帧才会显示,否则继续显示上一帧
+// 这样24/25/30fps的视频在60/90/120Hz的屏幕上都会按照固定的节奏显示,比如24fps在60Hz上是3:2交替
+// 同一个vsync里面有多帧都到了显示时间(渲染慢或者解码慢之后)的话,只显示最新的一帧,前面的丢掉
+// 只负责决策和统计,不涉及线程和时间,所以可以配合ManualTimeSource在linux上模拟
+class FrameScheduler {
+public:
+    FrameScheduler();
+
+    // 每个vsync调用一次,displayTime是这个vsync开始渲染的画面显示出来的时间
+    void OnVsync(int64_t displayTime, int64_t periodUs);
+
+    // 理想显示时间是presentTime的帧这个vsync是不是应该显示
+    bool IsDue(int64_t presentTime);
+
+    // 这个vsync显示了一帧,durationUs是按照播放速度换算之后的帧间隔,用来检查节奏
+    void OnFramePresented(int64_t presentTime, int64_t durationUs);
+    void OnFrameDropped();
+
+    // seek之后时间不连续,不再和之前的帧比较
+    void Reset();
+
+    FrameSchedulerStats GetStats();
+
+private:
+    std::mutex mMutex;
+    int64_t mDisplayTime;
+    int64_t mPeriodUs;
+    bool mPresentedInVsync;
+
+    // 上一次显示的帧
+    bool mHasLastFrame;
+    int64_t mLastDisplayTime;
+    int64_t mLastPresentTime;
+    int64_t mLastDurationUs;
+    bool mDroppedSinceLast;
+
+    int64_t mVsyncs;
+    int64_t mPresentedFrames;
+    int64_t mDroppedFrames;
+    int64_t mRepeatedVsyncs;
+    int64_t mCadenceErrors;
+    int64_t mErrorSum;
+    int64_t mMaxError;
+    int64_t mJudderSum;
+    int64_t mJudderCount;
+    int64_t mMaxJudder;
+    int64_t mHolds[MAX_HOLD_VSYNCS];
+
+    // 两个显示时间之间隔了几个vsync
+    int64_t countVsyncs(int64_t from, int64_t to);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "gop_cache.h"
+
+using namespace std;
+
+GopCache::GopCache() : mVideoStreamIndex(-1), mOverflow(false) {
+}
+
+GopCache::~GopCache() {
+    Clear();
+}
+
+void GopCache::SetVideoStreamIndex(int videoStreamIndex) {
+    mVideoStreamIndex = videoStreamIndex;
+}
+
+void GopCache::Add(const AVPacket* packet) {
+    if(mVideoStreamIndex < 0) {
+        return;
+    }
+
+    if(packet->stream_index == mVideoStreamIndex && (packet->flags & AV_PKT_FLAG_KEY)) {
+        Clear();
+    } else if(mPackets.empty() || mOverflow) {
+        // 还没有遇到关键帧,或者这个GOP已经超过上限,缓存下来的数据也无法从头解码
+        return;
+    }
+
+    if(mPackets.size() >= MAX_PACKETS) {
+        Clear();
+        mOverflow = true;
+        return;
+    }
+
+    AVPacket* clone = av_packet_clone(packet);
+    if(NULL != clone) {
+        mPackets.push_back(clone);
+    }
+}
+
+const vector<AVPacket*>& GopCache::GetPackets() const {
+    return mPackets;
+}
+
+bool GopCache::IsEmpty() const {
+    return mPackets.empty();
+}
+
+void GopCache::Clear() {
+    for(AVPacket* packet : mPackets) {
+        av_packet_free(&packet);
+    }
+    mPackets.clear();
+    mOverflow = false;
+}
@@ -0,0 +1,39 @@
+#ifndef __GOP_CACHE_H__
+#define __GOP_CACHE_H__
+
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 缓存从最近一个视频关键帧开始的所有数据包(包括中间的音频包)
+// 新连接(或者重连)的目的地先收到这一整个GOP,服务器和播放器可以马上解码出画面,不需要等下一个关键帧
+// 只在读取线程访问,不需要加锁
+class GopCache {
+public:
+    GopCache();
+    ~GopCache();
+
+    void SetVideoStreamIndex(int videoStreamIndex);
+
+    // 遇到视频关键帧的时候清空之前的缓存,这里只增加数据的引用计数
+    void Add(const AVPacket* packet);
+
+    // 当前缓存的数据包,元素仍然属于GopCache
+    const std::vector<AVPacket*>& GetPackets() const;
+
+    bool IsEmpty() const;
+
+    void Clear();
+
+private:
+    // 关键帧间隔特别长或者一直没有关键帧的流,超过这个数量之后不再缓存,避免内存无限增长
+    static const size_t MAX_PACKETS = 1024;
+
+    int mVideoStreamIndex;
+    bool mOverflow;
+    std::vector<AVPacket*> mPackets;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "latency_recorder.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// 在排好序的样本里面取第percent百分位的值
+static int64_t percentile(const vector<int64_t>& sorted, int percent) {
+    size_t index = (sorted.size() - 1) * percent / 100;
+    return sorted[index];
+}
+
+LatencyRecorder::LatencyRecorder() : mNext(0), mCount(0), mSum(0), mMax(0) {
+    mSamples.reserve(MAX_SAMPLES);
+}
+
+void LatencyRecorder::Record(int64_t us) {
+    lock_guard<mutex> lock(mMutex);
+
+    // 样本满了之后循环覆盖最旧的样本,这里不会分配内存
+    if(mSamples.size() < MAX_SAMPLES) {
+        mSamples.push_back(us);
+    } else {
+        mSamples[mNext] = us;
+    }
+    mNext = (mNext + 1) % MAX_SAMPLES;
+
+    mCount++;
+    mSum += us;
+    if(us > mMax) {
+        mMax = us;
+    }
+}
+
+LatencyStats LatencyRecorder::GetStats() {
+    LatencyStats stats = {0, 0, 0, 0, 0, 0};
+    vector<int64_t> sorted;
+    {
+        lock_guard<mutex> lock(mMutex);
+        if(0 == mCount) {
+            return stats;
+        }
+        sorted = mSamples;
+        stats.count = mCount;
+        stats.avgUs = mSum / mCount;
+        stats.maxUs = mMax;
+    }
+
+    // 排序在锁外面做,不会阻塞记录的线程
+    sort(sorted.begin(), sorted.end());
+    stats.p50Us = percentile(sorted, 50);
+    stats.p90Us = percentile(sorted, 90);
+    stats.p99Us = percentile(sorted, 99);
+    return stats;
+}
+
+void LatencyRecorder::Reset() {
+    lock_guard<mutex> lock(mMutex);
+    mSamples.clear();
+    mNext = 0;
+    mCount = 0;
+    mSum = 0;
+    mMax = 0;
+}
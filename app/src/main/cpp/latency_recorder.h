@@ -0,0 +1,44 @@
+#ifndef __LATENCY_RECORDER_H__
+#define __LATENCY_RECORDER_H__
+
+#include <mutex>
+#include <vector>
+
+#include <stdint.h>
+
+// 耗时分布,单位是微秒
+struct LatencyStats {
+    int64_t count;
+    int64_t avgUs;
+    int64_t p50Us;
+    int64_t p90Us;
+    int64_t p99Us;
+    int64_t maxUs;
+};
+
+// 记录某个环节每次处理的耗时,用来统计分位数
+// 平均值只能看出整体的快慢,卡顿一般是少数几次特别慢的处理造成的,要看p99和最大值才能发现
+// 只保留最近的MAX_SAMPLES个样本计算分位数,长时间播放内存也不会增长,次数、平均值和最大值是从头开始统计的
+// 一般由一个线程Record,另一个线程GetStats,所以需要加锁
+class LatencyRecorder {
+public:
+    LatencyRecorder();
+
+    void Record(int64_t us);
+
+    LatencyStats GetStats();
+
+    void Reset();
+
+private:
+    static const size_t MAX_SAMPLES = 4096;
+
+    std::mutex mMutex;
+    std::vector<int64_t> mSamples;
+    size_t mNext;
+    int64_t mCount;
+    int64_t mSum;
+    int64_t mMax;
+};
+
+#endif
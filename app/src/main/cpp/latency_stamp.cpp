@@ -0,0 +1,165 @@
+#include "latency_stamp.h"
+
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include <libavutil/intreadwrite.h>
+}
+
+using namespace std;
+
+// 用来识别我们自己插入的SEI
+static const uint8_t STAMP_UUID[16] = {
+        0x6c, 0x6a, 0x77, 0x2d, 0x6c, 0x61, 0x74, 0x65,
+        0x6e, 0x63, 0x79, 0x2d, 0x73, 0x74, 0x61, 0x6d
+};
+
+static const int NAL_SEI = 6;
+static const int SEI_USER_DATA_UNREGISTERED = 5;
+
+// SEI负载: 16字节uuid + 8字节大端的时间戳
+static const int STAMP_PAYLOAD_SIZE = 16 + 8;
+
+int GetNalLengthSize(const AVCodecParameters* codecpar) {
+    // avcC的第一个字节是版本号1,第五个字节的低两位是NAL长度字段的字节数减一
+    if(AV_CODEC_ID_H264 != codecpar->codec_id || codecpar->extradata_size < 7 || 1 != codecpar->extradata[0]) {
+        return 0;
+    }
+    return (codecpar->extradata[4] & 0x03) + 1;
+}
+
+// NAL里面不能出现00 00 00/01/02/03,需要在两个0之后插入0x03(防竞争字节)
+static void escapeRbsp(const uint8_t* data, int size, vector<uint8_t>& out) {
+    int zeros = 0;
+    for(int i = 0 ; i < size ; i++) {
+        if(zeros >= 2 && data[i] <= 0x03) {
+            out.push_back(0x03);
+            zeros = 0;
+        }
+        out.push_back(data[i]);
+        zeros = 0 == data[i] ? zeros + 1 : 0;
+    }
+}
+
+static void unescapeRbsp(const uint8_t* data, int size, vector<uint8_t>& out) {
+    int zeros = 0;
+    for(int i = 0 ; i < size ; i++) {
+        if(zeros >= 2 && 0x03 == data[i]) {
+            zeros = 0;
+            continue;
+        }
+        out.push_back(data[i]);
+        zeros = 0 == data[i] ? zeros + 1 : 0;
+    }
+}
+
+bool AddLatencyStamp(AVPacket* packet, int nalLengthSize, int64_t timeUs) {
+    if(nalLengthSize <= 0 || nalLengthSize > 4) {
+        return false;
+    }
+
+    // SEI的rbsp: 负载类型 + 负载大小 + uuid + 时间戳 + 结尾的停止位
+    uint8_t rbsp[2 + STAMP_PAYLOAD_SIZE + 1];
+    rbsp[0] = SEI_USER_DATA_UNREGISTERED;
+    rbsp[1] = STAMP_PAYLOAD_SIZE;
+    memcpy(rbsp + 2, STAMP_UUID, sizeof(STAMP_UUID));
+    AV_WB64(rbsp + 2 + sizeof(STAMP_UUID), timeUs);
+    rbsp[sizeof(rbsp) - 1] = 0x80;
+
+    vector<uint8_t> nal;
+    nal.push_back(NAL_SEI);
+    escapeRbsp(rbsp, sizeof(rbsp), nal);
+
+    // 长度字段只有1、2个字节的时候可能放不下,不过SEI只有二十几个字节,所以不会溢出
+    int seiSize = nalLengthSize + nal.size();
+    AVPacket* stamped = av_packet_alloc();
+    if(NULL == stamped || av_new_packet(stamped, seiSize + packet->size) < 0 || av_packet_copy_props(stamped, packet) < 0) {
+        av_packet_free(&stamped);
+        return false;
+    }
+
+    uint8_t* data = stamped->data;
+    for(int i = nalLengthSize - 1 ; i >= 0 ; i--) {
+        *data++ = (nal.size() >> (8 * i)) & 0xFF;
+    }
+    memcpy(data, nal.data(), nal.size());
+    memcpy(stamped->data + seiSize, packet->data, packet->size);
+    stamped->stream_index = packet->stream_index;
+
+    av_packet_unref(packet);
+    av_packet_move_ref(packet, stamped);
+    av_packet_free(&stamped);
+    return true;
+}
+
+// 解析一个SEI NAL里面的所有SEI消息,nal不包含NAL头
+static bool parseSei(const uint8_t* nal, int size, int64_t* timeUs) {
+    vector<uint8_t> rbsp;
+    unescapeRbsp(nal, size, rbsp);
+
+    size_t pos = 0;
+    while(pos < rbsp.size() && 0x80 != rbsp[pos]) {
+        // 负载类型和大小都是用连续的0xFF加上最后一个字节表示的
+        int type = 0;
+        while(pos < rbsp.size() && 0xFF == rbsp[pos]) {
+            type += rbsp[pos++];
+        }
+        if(pos >= rbsp.size()) {
+            return false;
+        }
+        type += rbsp[pos++];
+
+        int payloadSize = 0;
+        while(pos < rbsp.size() && 0xFF == rbsp[pos]) {
+            payloadSize += rbsp[pos++];
+        }
+        if(pos >= rbsp.size()) {
+            return false;
+        }
+        payloadSize += rbsp[pos++];
+        if(pos + payloadSize > rbsp.size()) {
+            return false;
+        }
+
+        const uint8_t* payload = rbsp.data() + pos;
+        if(SEI_USER_DATA_UNREGISTERED == type && STAMP_PAYLOAD_SIZE == payloadSize
+            && 0 == memcmp(payload, STAMP_UUID, sizeof(STAMP_UUID))) {
+            *timeUs = AV_RB64(payload + sizeof(STAMP_UUID));
+            return true;
+        }
+        pos += payloadSize;
+    }
+    return false;
+}
+
+bool GetLatencyStamp(const AVPacket* packet, int nalLengthSize, int64_t* timeUs) {
+    if(nalLengthSize <= 0 || nalLengthSize > 4) {
+        return false;
+    }
+
+    // 只需要看NAL头,SEI一般都在图像数据前面
+    const uint8_t* data = packet->data;
+    const uint8_t* end = packet->data + packet->size;
+    while(end - data > nalLengthSize) {
+        int64_t nalSize = 0;
+        for(int i = 0 ; i < nalLengthSize ; i++) {
+            nalSize = (nalSize << 8) | *data++;
+        }
+        if(nalSize <= 0 || nalSize > end - data) {
+            return false;
+        }
+
+        int type = data[0] & 0x1F;
+        if(NAL_SEI == type && parseSei(data + 1, nalSize - 1, timeUs)) {
+            return true;
+        }
+
+        // 遇到图像数据之后就不会再有SEI了
+        if(type >= 1 && type <= 5) {
+            return false;
+        }
+        data += nalSize;
+    }
+    return false;
+}
@@ -0,0 +1,22 @@
+#ifndef __LATENCY_STAMP_H__
+#define __LATENCY_STAMP_H__
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 端到端延迟打点: 推流端在每个H.264视频包前面插入一个user_data_unregistered类型的SEI,
+// 里面带上发送时的系统时间(av_gettime),播放端渲染的时候用当前时间减去它就是端到端的延迟
+// SEI会原样经过服务器转发,解码器会忽略不认识的uuid,所以不影响正常播放
+// 只支持flv/mp4里面avcC格式(每个NAL前面是长度)的H.264,两端不在同一台机器上的时候需要先同步好时钟
+
+// 从avcC格式的extradata里面读取NAL长度字段的字节数,不是avcC格式的H.264返回0
+int GetNalLengthSize(const AVCodecParameters* codecpar);
+
+// 在数据包最前面插入带有时间戳的SEI,数据包的其他属性保持不变
+bool AddLatencyStamp(AVPacket* packet, int nalLengthSize, int64_t timeUs);
+
+// 查找数据包里面的时间戳SEI
+bool GetLatencyStamp(const AVPacket* packet, int nalLengthSize, int64_t* timeUs);
+
+#endif
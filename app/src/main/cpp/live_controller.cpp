@@ -0,0 +1,118 @@
+#include "live_controller.h"
+
+extern "C" {
+#include <libavutil/avutil.h>
+}
+
+using namespace std;
+
+LiveController::LiveController()
+        : mNewestPts(AV_NOPTS_VALUE),
+          mLatencyUs(0),
+          mMaxLatencyUs(0),
+          mSpeed(1.0),
+          mCatchUpStart(-1),
+          mLastJump(-1),
+          mCatchUps(0),
+          mCatchUpUs(0),
+          mJumps(0) {
+}
+
+void LiveController::SetConfig(const LiveConfig& config) {
+    lock_guard<mutex> lock(mMutex);
+    mConfig = config;
+    if(mConfig.targetLatencyUs < MIN_TARGET_LATENCY_US) {
+        mConfig.targetLatencyUs = MIN_TARGET_LATENCY_US;
+    }
+    if(mConfig.catchUpSpeed < 1.0) {
+        mConfig.catchUpSpeed = 1.0;
+    }
+}
+
+LiveConfig LiveController::GetConfig() {
+    lock_guard<mutex> lock(mMutex);
+    return mConfig;
+}
+
+bool LiveController::IsEnabled() {
+    lock_guard<mutex> lock(mMutex);
+    return mConfig.enabled;
+}
+
+void LiveController::OnPacket(int64_t pts) {
+    if(AV_NOPTS_VALUE == pts) {
+        return;
+    }
+
+    // 音视频包的时间戳是交错的,取最大的那个作为最新收到的数据
+    lock_guard<mutex> lock(mMutex);
+    if(AV_NOPTS_VALUE == mNewestPts || pts > mNewestPts) {
+        mNewestPts = pts;
+    }
+}
+
+LiveController::Action LiveController::Update(int64_t playingPts, int64_t now, double* speed) {
+    lock_guard<mutex> lock(mMutex);
+    if(!mConfig.enabled || AV_NOPTS_VALUE == playingPts || AV_NOPTS_VALUE == mNewestPts) {
+        return LIVE_KEEP;
+    }
+
+    mLatencyUs = mNewestPts - playingPts;
+    if(mLatencyUs > mMaxLatencyUs) {
+        mMaxLatencyUs = mLatencyUs;
+    }
+
+    // 落后太多,加速追赶也要很久才能追上,直接跳到下一个关键帧
+    if(mLatencyUs > getJumpLatency() && (-1 == mLastJump || now - mLastJump > MIN_JUMP_INTERVAL_US)) {
+        if(-1 != mCatchUpStart) {
+            mCatchUpUs += now - mCatchUpStart;
+            mCatchUpStart = -1;
+        }
+        mLastJump = now;
+        mJumps++;
+        mSpeed = 1.0;
+        *speed = mSpeed;
+        return LIVE_JUMP;
+    }
+
+    // 开始和停止加速的阈值不一样,避免延迟在目标值附近的时候频繁切换速度
+    if(-1 == mCatchUpStart && mLatencyUs > mConfig.targetLatencyUs * 5 / 4 && mConfig.catchUpSpeed > 1.0) {
+        mCatchUpStart = now;
+        mCatchUps++;
+        mSpeed = mConfig.catchUpSpeed;
+        *speed = mSpeed;
+        return LIVE_SET_SPEED;
+    }
+    if(-1 != mCatchUpStart && mLatencyUs <= mConfig.targetLatencyUs) {
+        mCatchUpUs += now - mCatchUpStart;
+        mCatchUpStart = -1;
+        mSpeed = 1.0;
+        *speed = mSpeed;
+        return LIVE_SET_SPEED;
+    }
+    return LIVE_KEEP;
+}
+
+void LiveController::Reset() {
+    lock_guard<mutex> lock(mMutex);
+    mNewestPts = AV_NOPTS_VALUE;
+    mLatencyUs = 0;
+}
+
+LiveStats LiveController::GetStats() {
+    lock_guard<mutex> lock(mMutex);
+    LiveStats stats;
+    stats.enabled = mConfig.enabled;
+    stats.latencyUs = mLatencyUs;
+    stats.maxLatencyUs = mMaxLatencyUs;
+    stats.bufferedPackets = 0;
+    stats.speed = mSpeed;
+    stats.catchUps = mCatchUps;
+    stats.catchUpUs = mCatchUpUs;
+    stats.jumps = mJumps;
+    return stats;
+}
+
+int64_t LiveController::getJumpLatency() {
+    return mConfig.jumpLatencyUs > 0 ? mConfig.jumpLatencyUs : mConfig.targetLatencyUs * 4;
+}
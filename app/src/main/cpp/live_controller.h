@@ -0,0 +1,94 @@
+#ifndef __LIVE_CONTROLLER_H__
+#define __LIVE_CONTROLLER_H__
+
+#include <mutex>
+
+#include <stdint.h>
+
+// 直播低延迟模式的配置
+struct LiveConfig {
+    bool enabled;
+
+    // 目标延迟,播放器里面缓冲的数据超过这个时长就开始加速追赶,最小是LiveController::MIN_TARGET_LATENCY_US
+    int64_t targetLatencyUs;
+
+    // 延迟超过这个值说明落后太多,加速追赶要很久,直接丢掉缓冲的数据跳到下一个关键帧,0代表目标延迟的4倍
+    int64_t jumpLatencyUs;
+
+    // 追赶的时候的播放速度,太快的话声音的音调变化会比较明显
+    double catchUpSpeed;
+
+    LiveConfig()
+            : enabled(false),
+              targetLatencyUs(1000000),
+              jumpLatencyUs(0),
+              catchUpSpeed(1.1) {}
+};
+
+struct LiveStats {
+    bool enabled;
+    int64_t latencyUs;        // 当前延迟: 读到的最新数据的pts - 正在播放的pts,也就是播放器里面缓冲了多长时间的数据
+    int64_t maxLatencyUs;
+    int64_t bufferedPackets;  // 视频和音频数据包队列里面还没有解码的包数量
+    double speed;             // 当前的播放速度
+    int64_t catchUps;         // 开始加速追赶的次数
+    int64_t catchUpUs;        // 加速播放的总时长
+    int64_t jumps;            // 跳到关键帧的次数
+};
+
+// 直播延迟控制
+// 播放器总是按照pts匀速播放,网络抖动之后一次性收到的数据会一直堆在缓冲里面,延迟就这样越积越大
+// 这里由解复用线程在每次读到数据包之后检查缓冲的时长:
+//   超过目标延迟一定比例: 稍微加快播放速度,直到延迟回到目标以内
+//   超过跳帧阈值: 丢掉缓冲的数据,从下一个关键帧开始播放
+// 只负责决策,加速和跳帧由Player执行
+class LiveController {
+public:
+    // 目标延迟的下限,再低的话一次网络抖动就会卡顿
+    static const int64_t MIN_TARGET_LATENCY_US = 500000;
+
+    enum Action {
+        LIVE_KEEP,        // 保持当前速度
+        LIVE_SET_SPEED,   // 需要把播放速度改成返回的速度
+        LIVE_JUMP         // 需要跳到下一个关键帧,播放速度恢复正常
+    };
+
+    LiveController();
+
+    void SetConfig(const LiveConfig& config);
+    LiveConfig GetConfig();
+    bool IsEnabled();
+
+    // 解复用线程每读到一个数据包调用一次,pts的单位是微秒
+    void OnPacket(int64_t pts);
+
+    // 根据正在播放的pts计算延迟,返回需要执行的动作,速度需要改变的时候通过speed返回新的速度
+    // 还没有开始播放(playingPts是AV_NOPTS_VALUE)的时候不会做任何调整
+    Action Update(int64_t playingPts, int64_t now, double* speed);
+
+    // 跳帧之后之前读到的数据都被丢掉了,从下一个数据包重新开始计算
+    void Reset();
+
+    LiveStats GetStats();
+
+private:
+    // 两次跳帧之间的最小间隔,跳帧之后时钟要等新的画面和声音出来才会更新,避免在这之前又判断成落后太多
+    static const int64_t MIN_JUMP_INTERVAL_US = 3000000;
+
+    std::mutex mMutex;
+    LiveConfig mConfig;
+
+    int64_t mNewestPts;
+    int64_t mLatencyUs;
+    int64_t mMaxLatencyUs;
+    double mSpeed;
+    int64_t mCatchUpStart;
+    int64_t mLastJump;
+    int64_t mCatchUps;
+    int64_t mCatchUpUs;
+    int64_t mJumps;
+
+    int64_t getJumpLatency();
+};
+
+#endif
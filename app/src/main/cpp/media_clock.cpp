@@ -0,0 +1,235 @@
+#include "media_clock.h"
+
+#include <stdlib.h>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+using namespace std;
+
+// 视频落后主时钟超过这个值才会丢帧,避免在临界值附近频繁丢帧
+static const int64_t DROP_THRESHOLD_MIN = 40000;
+
+// pts和主时钟的偏差超过这个值认为是pts跳变(比如直播重连、文件循环),直接重新对齐而不是等待或者疯狂丢帧
+static const int64_t RESYNC_THRESHOLD = 10 * 1000000;
+
+// 以视频为主时钟的时候,计划显示时间落后系统时间超过这个值就重新对齐,避免卡顿之后快进追赶
+static const int64_t FRAME_TIMER_RESYNC_THRESHOLD = 100000;
+
+Clock::Clock() : mPts(AV_NOPTS_VALUE), mUpdateTime(0), mSpeed(1.0) {
+}
+
+void Clock::Set(int64_t pts) {
+    SetAt(pts, av_gettime_relative());
+}
+
+void Clock::SetAt(int64_t pts, int64_t time) {
+    lock_guard<mutex> lock(mMutex);
+    mPts = pts;
+    mUpdateTime = time;
+}
+
+void Clock::Reset() {
+    lock_guard<mutex> lock(mMutex);
+    mPts = AV_NOPTS_VALUE;
+    mUpdateTime = 0;
+}
+
+void Clock::SetSpeed(double speed) {
+    int64_t now = av_gettime_relative();
+    lock_guard<mutex> lock(mMutex);
+    if(speed == mSpeed) {
+        return;
+    }
+    if(AV_NOPTS_VALUE != mPts) {
+        mPts += (int64_t) ((now - mUpdateTime) * mSpeed);
+        mUpdateTime = now;
+    }
+    mSpeed = speed;
+}
+
+double Clock::GetSpeed() {
+    lock_guard<mutex> lock(mMutex);
+    return mSpeed;
+}
+
+int64_t Clock::Get() {
+    return GetAt(av_gettime_relative());
+}
+
+int64_t Clock::GetAt(int64_t time) {
+    lock_guard<mutex> lock(mMutex);
+    if(AV_NOPTS_VALUE == mPts) {
+        return AV_NOPTS_VALUE;
+    }
+    // 设置的时候的pts加上之后流逝的系统时间就是当前的pts,加速播放的时候流逝的时间要乘上速度
+    if(1.0 == mSpeed) {
+        return mPts + (time - mUpdateTime);
+    }
+    return mPts + (int64_t) ((time - mUpdateTime) * mSpeed);
+}
+
+MediaClock::MediaClock() :
+        mSyncMode(SYNC_AUDIO_MASTER),
+        mLastVideoPts(AV_NOPTS_VALUE),
+        mFrameTimer(AV_NOPTS_VALUE),
+        mSpeed(1.0),
+        mPresentedFrames(0),
+        mDroppedFrames(0),
+        mResyncCount(0),
+        mDriftSum(0),
+        mMaxDrift(0),
+        mLastDrift(0) {
+}
+
+void MediaClock::SetSyncMode(SyncMode mode) {
+    lock_guard<mutex> lock(mMutex);
+    mSyncMode = mode;
+}
+
+SyncMode MediaClock::GetSyncMode() {
+    lock_guard<mutex> lock(mMutex);
+    return mSyncMode;
+}
+
+SyncMode MediaClock::GetEffectiveSyncMode() {
+    lock_guard<mutex> lock(mMutex);
+    if(SYNC_AUDIO_MASTER == mSyncMode && AV_NOPTS_VALUE == mAudioClock.Get()) {
+        return SYNC_EXTERNAL_CLOCK;
+    }
+    return mSyncMode;
+}
+
+Clock& MediaClock::GetAudioClock() {
+    return mAudioClock;
+}
+
+Clock& MediaClock::GetVideoClock() {
+    return mVideoClock;
+}
+
+Clock& MediaClock::GetExternalClock() {
+    return mExternalClock;
+}
+
+int64_t MediaClock::GetMasterTime() {
+    switch(GetEffectiveSyncMode()) {
+        case SYNC_AUDIO_MASTER:
+            return mAudioClock.Get();
+        case SYNC_VIDEO_MASTER:
+            return mVideoClock.Get();
+        default:
+            return mExternalClock.Get();
+    }
+}
+
+MediaClock::FrameAction MediaClock::ScheduleVideoFrame(int64_t pts, int64_t duration, bool canDrop, int64_t* presentTime) {
+    SyncMode mode = GetEffectiveSyncMode();
+    int64_t now = av_gettime_relative();
+
+    lock_guard<mutex> lock(mMutex);
+
+    // 外部时钟在第一帧的时候和视频对齐,之后只跟着系统时间走
+    // 就算不是以外部时钟为主,也用它来统计视频相对于系统时间的累积偏差
+    if(AV_NOPTS_VALUE == mExternalClock.GetAt(now)) {
+        mExternalClock.SetAt(pts, now);
+    }
+
+    if(SYNC_VIDEO_MASTER == mode) {
+        // 以视频为主时钟: 按照和上一帧的pts差值推进计划显示时间,每一帧都显示
+        if(AV_NOPTS_VALUE == mFrameTimer) {
+            mFrameTimer = now;
+        } else {
+            int64_t delay = pts - mLastVideoPts;
+            if(delay <= 0 || delay > RESYNC_THRESHOLD) {
+                // pts倒退或者跳变,按照一帧的时长处理
+                delay = duration;
+            }
+            mFrameTimer += (int64_t) (delay / mSpeed);
+
+            // 渲染卡顿导致已经远远落后于计划时间的话,重新从当前时间开始,不要快进追赶
+            if(now - mFrameTimer > FRAME_TIMER_RESYNC_THRESHOLD) {
+                mFrameTimer = now;
+                mResyncCount++;
+            }
+        }
+        mLastVideoPts = pts;
+        *presentTime = mFrameTimer;
+        return FRAME_SHOW;
+    }
+
+    int64_t master = SYNC_AUDIO_MASTER == mode ? mAudioClock.GetAt(now) : mExternalClock.GetAt(now);
+    int64_t diff = pts - master;
+
+    // pts跳变(如直播重连之后时间戳重新开始)的时候重新对齐,否则会长时间等待或者把所有帧都丢掉
+    if(llabs(diff) > RESYNC_THRESHOLD) {
+        if(SYNC_EXTERNAL_CLOCK == mode) {
+            mExternalClock.SetAt(pts, now);
+        }
+        mResyncCount++;
+        diff = 0;
+    }
+
+    // 落后超过一帧的时长就丢掉,让后面的帧尽快追上主时钟
+    int64_t dropThreshold = duration > DROP_THRESHOLD_MIN ? duration : DROP_THRESHOLD_MIN;
+    if(canDrop && diff < -dropThreshold) {
+        mDroppedFrames++;
+        return FRAME_DROP;
+    }
+
+    *presentTime = diff > 0 ? now + diff : now;
+    return FRAME_SHOW;
+}
+
+void MediaClock::OnVideoFramePresented(int64_t pts) {
+    int64_t now = av_gettime_relative();
+    mVideoClock.SetAt(pts, now);
+
+    // 有音频的时候统计音视频之间的偏差,否则统计视频相对于系统时间的偏差
+    int64_t reference = mAudioClock.GetAt(now);
+    if(AV_NOPTS_VALUE == reference) {
+        reference = mExternalClock.GetAt(now);
+    }
+    if(AV_NOPTS_VALUE == reference) {
+        return;
+    }
+
+    lock_guard<mutex> lock(mMutex);
+    int64_t drift = pts - reference;
+    mLastDrift = drift;
+    mDriftSum += llabs(drift);
+    if(llabs(drift) > mMaxDrift) {
+        mMaxDrift = llabs(drift);
+    }
+    mPresentedFrames++;
+}
+
+void MediaClock::SetSpeed(double speed) {
+    mExternalClock.SetSpeed(speed);
+
+    lock_guard<mutex> lock(mMutex);
+    mSpeed = speed;
+}
+
+void MediaClock::Reset() {
+    mAudioClock.Reset();
+    mVideoClock.Reset();
+    mExternalClock.Reset();
+
+    lock_guard<mutex> lock(mMutex);
+    mLastVideoPts = AV_NOPTS_VALUE;
+    mFrameTimer = AV_NOPTS_VALUE;
+}
+
+SyncStats MediaClock::GetStats() {
+    lock_guard<mutex> lock(mMutex);
+    SyncStats stats;
+    stats.presentedFrames = mPresentedFrames;
+    stats.droppedFrames = mDroppedFrames;
+    stats.resyncCount = mResyncCount;
+    stats.avgDriftUs = mPresentedFrames > 0 ? mDriftSum / mPresentedFrames : 0;
+    stats.maxDriftUs = mMaxDrift;
+    stats.lastDriftUs = mLastDrift;
+    return stats;
+}
@@ -0,0 +1,113 @@
+#ifndef __MEDIA_CLOCK_H__
+#define __MEDIA_CLOCK_H__
+
+#include <mutex>
+
+extern "C" {
+#include <libavutil/avutil.h>
+}
+
+// 音视频同步的主时钟选择
+enum SyncMode {
+    SYNC_AUDIO_MASTER,     // 以音频为主时钟,视频去追音频(没有音频的时候退化成外部时钟)
+    SYNC_VIDEO_MASTER,     // 以视频为主时钟,每一帧都会显示,按照相邻帧的pts差值控制节奏
+    SYNC_EXTERNAL_CLOCK    // 以系统时间为主时钟,第一帧的时候对齐,之后按照系统时间播放,迟到的帧会被丢弃
+};
+
+// 时钟: 记录某个系统时间点对应的pts,之后根据系统时间的流逝推算出当前的pts
+// 所有时间的单位都是微秒,时间基准是av_gettime_relative
+class Clock {
+public:
+    Clock();
+
+    void Set(int64_t pts);
+    void SetAt(int64_t pts, int64_t time);
+    void Reset();
+
+    // 播放速度,pts的流逝速度是系统时间的speed倍,修改的时候会以当前时间重新对齐,之前流逝的时间不受影响
+    // Set和Reset都不会改变速度
+    void SetSpeed(double speed);
+    double GetSpeed();
+
+    // 返回当前时间对应的pts,还没有设置过的话返回AV_NOPTS_VALUE
+    int64_t Get();
+    int64_t GetAt(int64_t time);
+
+private:
+    std::mutex mMutex;
+    int64_t mPts;
+    int64_t mUpdateTime;
+    double mSpeed;
+};
+
+// 音视频同步的统计数据
+struct SyncStats {
+    int64_t presentedFrames;   // 显示的帧数
+    int64_t droppedFrames;     // 因为太晚被丢掉的帧数
+    int64_t resyncCount;       // 时钟偏差太大(如pts跳变)重新对齐的次数
+    int64_t avgDriftUs;        // 显示时视频pts和主时钟的平均偏差(绝对值)
+    int64_t maxDriftUs;        // 显示时视频pts和主时钟的最大偏差(绝对值)
+    int64_t lastDriftUs;       // 最近一帧的偏差,正数代表视频超前,负数代表视频落后
+};
+
+// 播放时钟,负责决定每一帧视频什么时候显示、要不要丢掉
+// 所有的pts都通过av_rescale_q精确换算成微秒,播放时间都是相对第一次对齐的时间点计算的,所以不会随着播放时长累积误差
+class MediaClock {
+public:
+    // 视频帧的处理结果
+    enum FrameAction {
+        FRAME_SHOW,   // 已经等到了显示时间,需要马上显示
+        FRAME_DROP    // 已经太晚了,直接丢掉
+    };
+
+    MediaClock();
+
+    void SetSyncMode(SyncMode mode);
+    SyncMode GetSyncMode();
+
+    // 实际生效的同步方式,设置了以音频为主但是还没有音频时钟的时候返回SYNC_EXTERNAL_CLOCK
+    SyncMode GetEffectiveSyncMode();
+
+    Clock& GetAudioClock();
+    Clock& GetVideoClock();
+    Clock& GetExternalClock();
+
+    // 主时钟的当前时间,还没有开始的话返回AV_NOPTS_VALUE
+    int64_t GetMasterTime();
+
+    // 计算一帧视频的处理方式,如果需要等待的话会返回需要等待到的系统时间
+    // pts和duration都是微秒,canDrop为false的时候(比如后面没有帧可以显示了)就算迟到了也不会丢
+    FrameAction ScheduleVideoFrame(int64_t pts, int64_t duration, bool canDrop, int64_t* presentTime);
+
+    // 视频帧真正显示之后调用,更新视频时钟和偏差统计
+    void OnVideoFramePresented(int64_t pts);
+
+    // 直播追赶延迟的时候加快播放速度,影响外部时钟和以视频为主时钟时的显示间隔
+    // 音频时钟的速度由AudioPlayer根据实际播放出来的数据设置
+    void SetSpeed(double speed);
+
+    void Reset();
+
+    SyncStats GetStats();
+
+private:
+    std::mutex mMutex;
+    SyncMode mSyncMode;
+    Clock mAudioClock;
+    Clock mVideoClock;
+    Clock mExternalClock;
+
+    // 以视频为主时钟的时候,上一帧的pts和计划显示的系统时间
+    int64_t mLastVideoPts;
+    int64_t mFrameTimer;
+    double mSpeed;
+
+    int64_t mPresentedFrames;
+    int64_t mDroppedFrames;
+    int64_t mResyncCount;
+    int64_t mDriftSum;
+    int64_t mMaxDrift;
+    int64_t mLastDrift;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __NULL_RENDERER_H__
+#define __NULL_RENDERER_H__
+
+#include "video_renderer.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+// 不显示画面的渲染器,在没有EGL的linux上代替EGLHelper + OpenGlDisplay跑benchmark
+// touchPixels为true的时候会把每个平面的数据都读一遍,模拟上传纹理的时候cpu读取画面内存的开销
+class NullRenderer : public VideoRenderer {
+public:
+    explicit NullRenderer(bool touchPixels = false) : mTouchPixels(touchPixels), mFrames(0), mChecksum(0) {
+    }
+
+    void Render(AVFrame* frame) override {
+        mFrames++;
+        if(mTouchPixels) {
+            touch(frame);
+        }
+    }
+
+    int64_t GetFrames() {
+        return mFrames;
+    }
+
+private:
+    // 每个缓存行读一个字节就能让整帧数据都经过一次cpu缓存
+    static const int CACHE_LINE = 64;
+
+    bool mTouchPixels;
+    int64_t mFrames;
+
+    // 把读到的数据累加起来,避免编译器把读取优化掉
+    uint8_t mChecksum;
+
+    void touch(const AVFrame* frame) {
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+        if(NULL == desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            return;
+        }
+
+        for(int i = 0 ; i < AV_NUM_DATA_POINTERS && NULL != frame->data[i] ; i++) {
+            // 色度平面的高度要按照采样比例缩小
+            int height = (1 == i || 2 == i) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+            for(int y = 0 ; y < height ; y++) {
+                const uint8_t* line = frame->data[i] + y * frame->linesize[i];
+                for(int x = 0 ; x < frame->linesize[i] ; x += CACHE_LINE) {
+                    mChecksum += line[x];
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -1,8 +1,14 @@
 #include <jni.h>
+#include <stdio.h>
 #include <android/native_window_jni.h>
 #include "opengl_display.h"
 #include "common.h"
 
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+}
+
 using namespace std;
 
 
@@ -18,22 +24,130 @@ static const string VERTICES_SHADER = "attribute vec2 aPosition;\n"
                                       "    gl_Position = vec4(aPosition.x * aPosScaleX, aPosition.y * aPosScaleY, 0, 1);\n"
                                       "}";
 
-static const string FRAGMENT_SHADER = "#extension GL_OES_EGL_image_external : require\n"
-                                      "precision highp float;\n"
-                                      "varying vec2 vCoord;\n"
-                                      "uniform sampler2D texY;\n"
-                                      "uniform sampler2D texU;\n"
-                                      "uniform sampler2D texV;\n"
-                                      "varying vec4 vColor;\n"
-                                      "void main() {\n"
-                                      "    float y = texture2D(texY, vCoord).x;\n"
-                                      "    float u = texture2D(texU, vCoord).x - 0.5;\n"
-                                      "    float v = texture2D(texV, vCoord).x - 0.5;\n"
-                                      "    float r = y + 1.4075 * v;\n"
-                                      "    float g = y - 0.3455 * u - 0.7169 * v;\n"
-                                      "    float b = y + 1.779 * u;\n"
-                                      "    gl_FragColor = vec4(r, g, b, 1);\n"
-                                      "}";
+// 片元着色器由三部分拼接而成: 公共的声明 + 不同像素格式的采样函数sampleColor + 公共的main函数
+// sampleColor负责从各个平面的纹理里面取出原始的YUV(或者RGB)分量,统一归一化到[0, 1]
+// 颜色空间转换由uColorMatrix和uOffset完成,它们根据AVFrame里面的colorspace和color_range计算,
+// 所以BT.601/BT.709/BT.2020、limited range/full range只是uniform不同,不需要更多的着色器
+static const string FRAGMENT_SHADER_HEADER = "precision highp float;\n"
+                                             "varying vec2 vCoord;\n"
+                                             "uniform sampler2D tex0;\n"
+                                             "uniform sampler2D tex1;\n"
+                                             "uniform sampler2D tex2;\n"
+                                             "uniform mat3 uColorMatrix;\n"
+                                             "uniform vec3 uOffset;\n"
+                                             // 16位的数据用GL_LUMINANCE_ALPHA上传,低字节在x,高字节在y,maxValue是这个位深的最大值
+                                             // 线性插值对高低字节分别进行再组合,结果和直接对16位数据插值是一样的
+                                             "float unpack16(vec2 v, float maxValue) {\n"
+                                             "    return (v.x + v.y * 256.0) * 255.0 / maxValue;\n"
+                                             "}\n";
+
+static const string FRAGMENT_SHADER_MAIN = "void main() {\n"
+                                           "    gl_FragColor = vec4(uColorMatrix * (sampleColor() - uOffset), 1.0);\n"
+                                           "}";
+
+// YUV420P/YUV422P/YUV444P: 三个平面分别是Y、U、V,都用GL_LUMINANCE纹理上传
+static const char *SAMPLE_PLANAR = "vec3 sampleColor() {\n"
+                                   "    return vec3(texture2D(tex0, vCoord).r,\n"
+                                   "                texture2D(tex1, vCoord).r,\n"
+                                   "                texture2D(tex2, vCoord).r);\n"
+                                   "}\n";
+
+// NV12: 第二个平面是交错存储的UV,用GL_LUMINANCE_ALPHA上传之后U在r(亮度)里,V在a(透明度)里
+static const char *SAMPLE_NV12 = "vec3 sampleColor() {\n"
+                                 "    vec4 uv = texture2D(tex1, vCoord);\n"
+                                 "    return vec3(texture2D(tex0, vCoord).r, uv.r, uv.a);\n"
+                                 "}\n";
+
+// NV21: 和NV12一样,只是UV的顺序反过来
+static const char *SAMPLE_NV21 = "vec3 sampleColor() {\n"
+                                 "    vec4 uv = texture2D(tex1, vCoord);\n"
+                                 "    return vec3(texture2D(tex0, vCoord).r, uv.a, uv.r);\n"
+                                 "}\n";
+
+// YUV420P10LE: 三个平面,每个分量是小端存储的16位数据,有效数据在低10位
+static const char *SAMPLE_PLANAR10 = "vec3 sampleColor() {\n"
+                                     "    return vec3(unpack16(texture2D(tex0, vCoord).ra, 1023.0),\n"
+                                     "                unpack16(texture2D(tex1, vCoord).ra, 1023.0),\n"
+                                     "                unpack16(texture2D(tex2, vCoord).ra, 1023.0));\n"
+                                     "}\n";
+
+// P010LE: 和NV12一样是两个平面,但每个分量是16位,有效数据在高10位
+// UV平面一个像素4个字节,用GL_RGBA上传之后U在rg里,V在ba里
+static const char *SAMPLE_P010 = "vec3 sampleColor() {\n"
+                                 "    vec4 uv = texture2D(tex1, vCoord);\n"
+                                 "    return vec3(unpack16(texture2D(tex0, vCoord).ra, 65535.0),\n"
+                                 "                unpack16(uv.rg, 65535.0),\n"
+                                 "                unpack16(uv.ba, 65535.0));\n"
+                                 "}\n";
+
+// RGB格式直接采样,颜色矩阵设置成单位矩阵
+// 纹理宽度是按linesize / bytesPerPixel计算的,RGB24的linesize不一定是3的倍数,所以只支持4字节一个像素的格式
+static const char *SAMPLE_RGB = "vec3 sampleColor() {\n"
+                                "    return texture2D(tex0, vCoord).rgb;\n"
+                                "}\n";
+
+static const char *SAMPLE_BGR = "vec3 sampleColor() {\n"
+                                "    return texture2D(tex0, vCoord).bgr;\n"
+                                "}\n";
+
+// 描述一种像素格式怎么上传和采样
+struct PixelLayout {
+    AVPixelFormat format;
+    int planeCount;
+    GLenum textureFormats[3];   // 每个平面上传使用的纹理格式
+    int bytesPerPixel[3];       // 每个平面一个纹理像素在内存里占用的字节数
+    bool yuv;
+    bool fullRange;             // YUVJ格式固定是full range
+    const char *sampleColor;
+};
+
+static const PixelLayout PIXEL_LAYOUTS[] = {
+        {AV_PIX_FMT_YUV420P,     3, {GL_LUMINANCE, GL_LUMINANCE, GL_LUMINANCE},                   {1, 1, 1}, true,  false, SAMPLE_PLANAR},
+        {AV_PIX_FMT_YUVJ420P,    3, {GL_LUMINANCE, GL_LUMINANCE, GL_LUMINANCE},                   {1, 1, 1}, true,  true,  SAMPLE_PLANAR},
+        {AV_PIX_FMT_YUV422P,     3, {GL_LUMINANCE, GL_LUMINANCE, GL_LUMINANCE},                   {1, 1, 1}, true,  false, SAMPLE_PLANAR},
+        {AV_PIX_FMT_YUVJ422P,    3, {GL_LUMINANCE, GL_LUMINANCE, GL_LUMINANCE},                   {1, 1, 1}, true,  true,  SAMPLE_PLANAR},
+        {AV_PIX_FMT_YUV444P,     3, {GL_LUMINANCE, GL_LUMINANCE, GL_LUMINANCE},                   {1, 1, 1}, true,  false, SAMPLE_PLANAR},
+        {AV_PIX_FMT_YUVJ444P,    3, {GL_LUMINANCE, GL_LUMINANCE, GL_LUMINANCE},                   {1, 1, 1}, true,  true,  SAMPLE_PLANAR},
+        {AV_PIX_FMT_NV12,        2, {GL_LUMINANCE, GL_LUMINANCE_ALPHA},                           {1, 2},    true,  false, SAMPLE_NV12},
+        {AV_PIX_FMT_NV21,        2, {GL_LUMINANCE, GL_LUMINANCE_ALPHA},                           {1, 2},    true,  false, SAMPLE_NV21},
+        {AV_PIX_FMT_YUV420P10LE, 3, {GL_LUMINANCE_ALPHA, GL_LUMINANCE_ALPHA, GL_LUMINANCE_ALPHA}, {2, 2, 2}, true,  false, SAMPLE_PLANAR10},
+        {AV_PIX_FMT_P010LE,      2, {GL_LUMINANCE_ALPHA, GL_RGBA},                                {2, 4},    true,  false, SAMPLE_P010},
+        {AV_PIX_FMT_RGBA,        1, {GL_RGBA},                                                    {4},       false, true,  SAMPLE_RGB},
+        {AV_PIX_FMT_RGB0,        1, {GL_RGBA},                                                    {4},       false, true,  SAMPLE_RGB},
+        {AV_PIX_FMT_BGRA,        1, {GL_RGBA},                                                    {4},       false, true,  SAMPLE_BGR},
+        {AV_PIX_FMT_BGR0,        1, {GL_RGBA},                                                    {4},       false, true,  SAMPLE_BGR},
+};
+
+static const PixelLayout *findPixelLayout(int format) {
+    for (size_t i = 0; i < sizeof(PIXEL_LAYOUTS) / sizeof(PixelLayout); ++i) {
+        if (PIXEL_LAYOUTS[i].format == format) {
+            return PIXEL_LAYOUTS + i;
+        }
+    }
+    return NULL;
+}
+
+// MediaCodec硬解的画面通过SurfaceTexture输出到OES纹理上,需要用samplerExternalOES采样
+// SurfaceTexture提供的变换矩阵包含了裁剪和翻转,所以这里直接用它去变换纹理坐标
+static const string OES_VERTICES_SHADER = "attribute vec2 aPosition;\n"
+                                          "attribute vec2 aCoord;\n"
+                                          "attribute float aPosScaleY;\n"
+                                          "attribute float aPosScaleX;\n"
+                                          "uniform mat4 uTexMatrix;\n"
+                                          "varying vec2 vCoord;\n"
+                                          "void main() {\n"
+                                          "    vCoord = (uTexMatrix * vec4(aCoord, 0, 1)).xy;\n"
+                                          "    gl_Position = vec4(aPosition.x * aPosScaleX, aPosition.y * aPosScaleY, 0, 1);\n"
+                                          "}";
+
+static const string OES_FRAGMENT_SHADER = "#extension GL_OES_EGL_image_external : require\n"
+                                          "precision mediump float;\n"
+                                          "varying vec2 vCoord;\n"
+                                          "uniform samplerExternalOES texOes;\n"
+                                          "void main() {\n"
+                                          "    gl_FragColor = texture2D(texOes, vCoord);\n"
+                                          "}";
+
 static const float VERTICES[] = {
         -1.0f, 1.0f,
         -1.0f, -1.0f,
@@ -49,6 +163,14 @@ static const float TEXTURE_COORDS[] = {
         1.0f, 0.0f
 };
 
+// SurfaceTexture的变换矩阵已经处理了上下翻转,所以OES纹理使用正常的纹理坐标
+static const float OES_TEXTURE_COORDS[] = {
+        0.0f, 1.0f,
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        1.0f, 1.0f
+};
+
 static const short ORDERS[] = {
         0, 1, 2, // 左下角三角形
 
@@ -62,37 +184,175 @@ OpenGlDisplay::OpenGlDisplay()
           mVideoWidth(0),
           mVideoHeight(0),
           mWindowWidth(0),
-          mWindowHeight(0) {
-    for (int i = 0; i < TEXTURE_COUNT; ++i) {
-        mTextures[i] = 0;
-    }
+          mWindowHeight(0),
+          mOesTexture(0),
+          mPboSupported(false),
+          mLayout(NULL),
+          mColorSpace(AVCOL_SPC_UNSPECIFIED),
+          mColorRange(AVCOL_RANGE_UNSPECIFIED),
+          mPositionLoc(-1),
+          mCoordLoc(-1),
+          mPosScaleXLoc(-1),
+          mPosScaleYLoc(-1),
+          mCoordScaleXLoc(-1),
+          mTexMatrixLoc(-1),
+          mColorMatrixLoc(-1),
+          mOffsetLoc(-1),
+          mUploadFrames(0),
+          mLastUploadUs(0),
+          mUploadUsSum(0),
+          mMaxUploadUs(0) {
 }
 
-bool OpenGlDisplay::Init(int windowWidth, int windowHeight, int videoWidth, int videoHeight) {
+bool OpenGlDisplay::Init(int windowWidth, int windowHeight, int videoWidth, int videoHeight, AVPixelFormat pixelFormat) {
     mWindowWidth = windowWidth;
     mWindowHeight = windowHeight;
+    mVideoWidth = videoWidth;
+    mVideoHeight = videoHeight;
 
     glClearColor(0, 0, 0, 1.0f);
     glViewport(0, 0, windowWidth, windowHeight);
 
-    mProgram = createProgram(VERTICES_SHADER, FRAGMENT_SHADER);
+    // 一行的字节数不一定是4的倍数,需要按1字节对齐读取
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (AV_PIX_FMT_MEDIACODEC == pixelFormat) {
+        if (!useProgram(OES_VERTICES_SHADER, OES_FRAGMENT_SHADER, OES_TEXTURE_COORDS)) {
+            return false;
+        }
+        glUniform1i(glGetUniformLocation(mProgram, "texOes"), 0);
+        return true;
+    }
+
+    mPboSupported = isGles3();
+    LOGD("texture upload with %s", mPboSupported ? "pbo" : "texture ring");
+    return useLayout(findPixelLayout(pixelFormat));
+}
+
+bool OpenGlDisplay::IsSupported(AVPixelFormat pixelFormat) {
+    return AV_PIX_FMT_MEDIACODEC == pixelFormat || NULL != findPixelLayout(pixelFormat);
+}
+
+bool OpenGlDisplay::useProgram(const string &vShaderSource, const string &fShaderSource, const float *texCoords) {
+    releaseProgram();
+    mProgram = createProgram(vShaderSource, fShaderSource);
     if (mProgram == 0) {
         return false;
     }
     glUseProgram(mProgram);
 
-    GLint positionId = glGetAttribLocation(mProgram, "aPosition");
-    glVertexAttribPointer(positionId, 2, GL_FLOAT, false, 0, VERTICES);
-    glEnableVertexAttribArray(positionId);
+    // attribute和uniform的位置只在创建程序的时候查询一次
+    mPositionLoc = glGetAttribLocation(mProgram, "aPosition");
+    mCoordLoc = glGetAttribLocation(mProgram, "aCoord");
+    mPosScaleXLoc = glGetAttribLocation(mProgram, "aPosScaleX");
+    mPosScaleYLoc = glGetAttribLocation(mProgram, "aPosScaleY");
+    mCoordScaleXLoc = glGetAttribLocation(mProgram, "aCoordScaleX");
+    mTexMatrixLoc = glGetUniformLocation(mProgram, "uTexMatrix");
+    mColorMatrixLoc = glGetUniformLocation(mProgram, "uColorMatrix");
+    mOffsetLoc = glGetUniformLocation(mProgram, "uOffset");
+
+    glVertexAttribPointer(mPositionLoc, 2, GL_FLOAT, false, 0, VERTICES);
+    glEnableVertexAttribArray(mPositionLoc);
+
+    glVertexAttribPointer(mCoordLoc, 2, GL_FLOAT, false, 0, texCoords);
+    glEnableVertexAttribArray(mCoordLoc);
+
+    // 换了程序之后attribute的位置可能变了,需要重新设置画面的缩放
+    SetVideoSize(mVideoWidth, mVideoHeight);
+    return true;
+}
+
+bool OpenGlDisplay::useLayout(const PixelLayout *layout) {
+    if (NULL == layout) {
+        LOGD("unsupported pixel format");
+        return false;
+    }
+
+    if (!useProgram(VERTICES_SHADER, FRAGMENT_SHADER_HEADER + layout->sampleColor + FRAGMENT_SHADER_MAIN, TEXTURE_COORDS)) {
+        return false;
+    }
+    LOGD("use shader for %s", av_get_pix_fmt_name(layout->format));
+
+    // 采样器和纹理单元的对应关系是固定的,只需要设置一次
+    glUniform1i(glGetUniformLocation(mProgram, "tex0"), 0);
+    glUniform1i(glGetUniformLocation(mProgram, "tex1"), 1);
+    glUniform1i(glGetUniformLocation(mProgram, "tex2"), 2);
 
-    GLint coord = glGetAttribLocation(mProgram, "aCoord");
-    glVertexAttribPointer(coord, 2, GL_FLOAT, false, 0, TEXTURE_COORDS);
-    glEnableVertexAttribArray(coord);
+    for (int i = 0; i < TEXTURE_COUNT; ++i) {
+        mTextures[i].Destroy();
+        if (i < layout->planeCount) {
+            mTextures[i].Init(layout->textureFormats[i], layout->bytesPerPixel[i], mPboSupported);
+        }
+    }
 
-    SetVideoSize(videoWidth, videoHeight);
+    mLayout = layout;
+    mColorSpace = AVCOL_SPC_UNSPECIFIED;
+    mColorRange = AVCOL_RANGE_UNSPECIFIED;
+
+    // 颜色矩阵在第一帧渲染的时候根据帧的颜色空间设置,这里先设置成单位矩阵
+    static const float IDENTITY[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    static const float ZERO[] = {0, 0, 0};
+    glUniformMatrix3fv(mColorMatrixLoc, 1, GL_FALSE, IDENTITY);
+    glUniform3fv(mOffsetLoc, 1, ZERO);
     return true;
 }
 
+void OpenGlDisplay::updateColorMatrix(const AVFrame *frame) {
+    if (!mLayout->yuv) {
+        return;
+    }
+
+    // 没有标注颜色空间的视频参考大部分播放器的做法: 高清用BT.709,标清用BT.601
+    AVColorSpace colorSpace = frame->colorspace;
+    if (AVCOL_SPC_BT709 != colorSpace && AVCOL_SPC_BT2020_NCL != colorSpace && AVCOL_SPC_BT2020_CL != colorSpace
+        && AVCOL_SPC_BT470BG != colorSpace && AVCOL_SPC_SMPTE170M != colorSpace) {
+        colorSpace = frame->height >= 720 ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+    }
+    AVColorRange colorRange = (mLayout->fullRange || AVCOL_RANGE_JPEG == frame->color_range)
+                              ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+    if (colorSpace == mColorSpace && colorRange == mColorRange) {
+        return;
+    }
+    mColorSpace = colorSpace;
+    mColorRange = colorRange;
+
+    // 不同标准的区别只是R和B分量的权重kr、kb不同,G的权重kg = 1 - kr - kb
+    float kr = 0.299f;
+    float kb = 0.114f;
+    if (AVCOL_SPC_BT709 == colorSpace) {
+        kr = 0.2126f;
+        kb = 0.0722f;
+    } else if (AVCOL_SPC_BT2020_NCL == colorSpace || AVCOL_SPC_BT2020_CL == colorSpace) {
+        kr = 0.2627f;
+        kb = 0.0593f;
+    }
+    float kg = 1.0f - kr - kb;
+
+    // limited range的Y范围是[16, 235],UV范围是[16, 240],需要先拉伸到[0, 1]和[-0.5, 0.5]
+    // full range的Y本来就是[0, 1],UV只需要减去0.5
+    float yScale = 1.0f;
+    float uvScale = 1.0f;
+    float offset[3] = {0.0f, 128.0f / 255.0f, 128.0f / 255.0f};
+    if (AVCOL_RANGE_MPEG == colorRange) {
+        yScale = 255.0f / 219.0f;
+        uvScale = 255.0f / 224.0f;
+        offset[0] = 16.0f / 255.0f;
+    }
+
+    // R = Y + 2(1 - kr)V
+    // G = Y - 2kb(1 - kb)/kg U - 2kr(1 - kr)/kg V
+    // B = Y + 2(1 - kb)U
+    // OpenGL的矩阵是按列存储的,每一列是Y、U、V对RGB的贡献
+    float matrix[9] = {
+            yScale, yScale, yScale,
+            0.0f, -2.0f * kb * (1.0f - kb) / kg * uvScale, 2.0f * (1.0f - kb) * uvScale,
+            2.0f * (1.0f - kr) * uvScale, -2.0f * kr * (1.0f - kr) / kg * uvScale, 0.0f
+    };
+    glUniformMatrix3fv(mColorMatrixLoc, 1, GL_FALSE, matrix);
+    glUniform3fv(mOffsetLoc, 1, offset);
+    LOGD("color matrix: %s, %s range", av_color_space_name(colorSpace), av_color_range_name(colorRange));
+}
+
 void OpenGlDisplay::SetVideoSize(int videoWidth, int videoHeight) {
     mVideoWidth = videoWidth;
     mVideoHeight = videoHeight;
@@ -101,24 +361,20 @@ void OpenGlDisplay::SetVideoSize(int videoWidth, int videoHeight) {
     // 由于坐标的原点在屏幕中央,所以只需要判断是横屏还是竖屏然后对x轴或者y轴做缩放就能让图像屏幕居中,然后恢复原始视频的长宽比
     if (mWindowHeight > mWindowWidth) {
         // 如果是竖屏的话,图像的宽不需要缩放,图像的高缩小使其竖直居中
-        GLint scaleX = glGetAttribLocation(mProgram, "aPosScaleX");
-        glVertexAttrib1f(scaleX, 1.0f);
+        glVertexAttrib1f(mPosScaleXLoc, 1.0f);
 
         // y坐标 * mWindowWidth / mWindowHeight 得到屏幕居中的正方形
         // 然后再 * videoHeight / videoWidth 就能恢复原始视频的长宽比
         float r = 1.0f * mWindowWidth / mWindowHeight * videoHeight / videoWidth;
-        GLint scaleY = glGetAttribLocation(mProgram, "aPosScaleY");
-        glVertexAttrib1f(scaleY, r);
+        glVertexAttrib1f(mPosScaleYLoc, r);
     } else {
         // 如果是横屏的话,图像的高不需要缩放,图像的宽缩小使其水平居中
-        GLint scaleY = glGetAttribLocation(mProgram, "aPosScaleY");
-        glVertexAttrib1f(scaleY, 1.0f);
+        glVertexAttrib1f(mPosScaleYLoc, 1.0f);
 
         // x坐标 * mWindowHeight / mWindowWidth 得到屏幕居中的正方形
         // 然后再 * videoWidth / videoHeight 就能恢复原始视频的长宽比
         float r = 1.0f * mWindowHeight / mWindowWidth * videoWidth / videoHeight;
-        GLint scaleX = glGetAttribLocation(mProgram, "aPosScaleX");
-        glVertexAttrib1f(scaleX, r);
+        glVertexAttrib1f(mPosScaleXLoc, r);
     }
 }
 
@@ -130,12 +386,19 @@ void OpenGlDisplay::Destroy() {
     mVideoHeight = 0;
 
     for (int i = 0; i < TEXTURE_COUNT; ++i) {
-        if (0 != mTextures[i]) {
-            glDeleteTextures(1, mTextures + i);
-            mTextures[i] = 0;
-        }
+        mTextures[i].Destroy();
+    }
+    mLayout = NULL;
+
+    if (0 != mOesTexture) {
+        glDeleteTextures(1, &mOesTexture);
+        mOesTexture = 0;
     }
 
+    releaseProgram();
+}
+
+void OpenGlDisplay::releaseProgram() {
     if (0 != mProgram) {
         glDeleteProgram(mProgram);
         mProgram = 0;
@@ -152,25 +415,97 @@ void OpenGlDisplay::Destroy() {
     }
 }
 
-void OpenGlDisplay::Render(uint8_t *yuv420Data[3], int lineSize[3]) {
+void OpenGlDisplay::Render(AVFrame *frame) {
+    // 帧的格式和当前着色器不一致(例如解码器中途切换了输出格式)的时候切换着色器
+    if (NULL == mLayout || mLayout->format != frame->format) {
+        if (!useLayout(findPixelLayout(frame->format))) {
+            return;
+        }
+    }
+    updateColorMatrix(frame);
+
     // 解码得到的YUV数据,高是对应分量的高,但是宽却不一定是对应分量的宽
     // 这是因为在做视频解码的时候会对宽进行对齐,让宽是16或者32的整数倍,具体是16还是32由cpu决定
     // 例如我们的video.flv视频,原始画面尺寸是689x405,如果按32去对齐的话,他的Y分量的宽则是720
     // 对齐之后的宽在ffmpeg里面称为linesize
-    // 而对于YUV420来说Y分量的高度为原始图像的高度,UV分量的高度由于是隔行扫描,所以是原生图像高度的一半
-    setTexture(0, "texY", yuv420Data[0], lineSize[0], mVideoHeight);
-    setTexture(1, "texU", yuv420Data[1], lineSize[1], mVideoHeight / 2);
-    setTexture(2, "texV", yuv420Data[2], lineSize[2], mVideoHeight / 2);
+    // 而UV分量的高度由色度抽样决定,例如YUV420的UV分量高度是原始图像高度的一半
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+    int64_t start = av_gettime_relative();
+    for (int i = 0; i < mLayout->planeCount; ++i) {
+        int height = (0 == i || !mLayout->yuv) ? frame->height : AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+        mTextures[i].Upload(frame->data[i], frame->linesize[i], height);
+    }
+
+    mLastUploadUs = av_gettime_relative() - start;
+    mUploadUsSum += mLastUploadUs;
+    mUploadFrames++;
+    if (mLastUploadUs > mMaxUploadUs) {
+        mMaxUploadUs = mLastUploadUs;
+    }
+
+    for (int i = 0; i < mLayout->planeCount; ++i) {
+        mTextures[i].Bind(i);
+    }
 
     // 由于对齐之后创建的纹理宽度大于原始画面的宽度,所以如果直接显示,视频的右侧会出现异常
     // 所以我们将纹理坐标进行缩放,忽略掉右边对齐多出来的部分
-    GLint scaleX = glGetAttribLocation(mProgram, "aCoordScaleX");
-    glVertexAttrib1f(scaleX, mVideoWidth * 1.0f / lineSize[0]);
+    glVertexAttrib1f(mCoordScaleXLoc, 1.0f * frame->width * mLayout->bytesPerPixel[0] / frame->linesize[0]);
 
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
     glDrawElements(GL_TRIANGLES, sizeof(ORDERS) / sizeof(short), GL_UNSIGNED_SHORT, ORDERS);
 }
 
+GLuint OpenGlDisplay::CreateOesTexture() {
+    if (0 != mOesTexture) {
+        return mOesTexture;
+    }
+
+    glGenTextures(1, &mOesTexture);
+    if (0 == mOesTexture) {
+        LOGD("glGenTextures failed");
+        return 0;
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, mOesTexture);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return mOesTexture;
+}
+
+void OpenGlDisplay::RenderOes(const float texMatrix[16]) {
+    // 画面已经由SurfaceTexture.updateTexImage更新到OES纹理上了,不需要再上传任何数据
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, mOesTexture);
+    glUniformMatrix4fv(mTexMatrixLoc, 1, GL_FALSE, texMatrix);
+
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    glDrawElements(GL_TRIANGLES, sizeof(ORDERS) / sizeof(short), GL_UNSIGNED_SHORT, ORDERS);
+}
+
+UploadStats OpenGlDisplay::GetUploadStats() {
+    UploadStats stats;
+    stats.pbo = mPboSupported;
+    stats.frames = mUploadFrames;
+    stats.lastUs = mLastUploadUs;
+    stats.avgUs = mUploadFrames > 0 ? mUploadUsSum / mUploadFrames : 0;
+    stats.maxUs = mMaxUploadUs;
+    return stats;
+}
+
+bool OpenGlDisplay::isGles3() {
+    // GL_VERSION的格式是"OpenGL ES <major>.<minor> <vendor-specific>"
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int major = 0;
+    int minor = 0;
+    if (NULL == version || 2 != sscanf(version, "OpenGL ES %d.%d", &major, &minor)) {
+        return false;
+    }
+    return major >= 3;
+}
+
 GLuint OpenGlDisplay::createProgram(const string &vShaderSource, const string &fShaderSource) {
     GLuint program = glCreateProgram();
     do {
@@ -224,54 +559,3 @@ GLuint OpenGlDisplay::loadShader(GLenum shaderType, const string &source) {
     }
     return shader;
 }
-
-GLuint OpenGlDisplay::createLuminanceTexture(int index, const string &texName, int width, int height) {
-    GLuint texture = 0;
-    glGenTextures(1, &texture);
-    if (texture == 0) {
-        LOGD("glGenTextures failed");
-        return 0;
-    }
-
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_LUMINANCE,
-                 width,
-                 height,
-                 0,
-                 GL_LUMINANCE,
-                 GL_UNSIGNED_BYTE,
-                 NULL
-    );
-
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glUniform1i(glGetUniformLocation(mProgram, texName.c_str()), index);
-
-    return texture;
-}
-
-void OpenGlDisplay::setTexture(int index,
-                               const string &texName,
-                               const uint8_t *yuvData,
-                               int width,
-                               int height) {
-    if (0 == mTextures[index]) {
-        GLuint texture = createLuminanceTexture(index, texName, width, height);
-        if(0 == texture) {
-            LOGD("createLuminanceTexture %s failed", texName.c_str());
-            return;
-        }
-        mTextures[index] = texture;
-    }
-
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_2D, mTextures[index]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE,
-                    GL_UNSIGNED_BYTE, yuvData);
-}
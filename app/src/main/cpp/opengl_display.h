@@ -1,18 +1,48 @@
 #include <jni.h>
 #include <string>
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include "texture_stream.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+struct PixelLayout;
+
+// 纹理上传的耗时统计,统计的是渲染线程花在上传纹理上的时间
+struct UploadStats {
+    bool pbo;            // 是否使用了PBO异步上传
+    int64_t frames;
+    int64_t lastUs;
+    int64_t avgUs;
+    int64_t maxUs;
+};
 
 class OpenGlDisplay {
 public:
     OpenGlDisplay();
 
-    bool Init(int windowWidth, int windowHeight, int videoWidth, int videoHeight);
+    // pixelFormat为AV_PIX_FMT_MEDIACODEC的时候使用OES纹理渲染MediaCodec硬解输出的画面,
+    // 否则根据像素格式选择对应的着色器,渲染的时候如果帧的格式变了会自动切换
+    bool Init(int windowWidth, int windowHeight, int videoWidth, int videoHeight, AVPixelFormat pixelFormat);
+
+    // 是否可以不经过cpu转换直接渲染这种像素格式
+    static bool IsSupported(AVPixelFormat pixelFormat);
+
+    // 创建给SurfaceTexture使用的OES纹理,只需要有EGL上下文就可以调用,不依赖Init
+    GLuint CreateOesTexture();
 
     void SetVideoSize(int videoWidth, int videoHeight);
 
     void Destroy();
 
-    void Render(uint8_t *yuv420Data[3], int lineSize[3]);
+    void Render(AVFrame *frame);
+
+    // texMatrix是SurfaceTexture.getTransformMatrix得到的纹理变换矩阵
+    void RenderOes(const float texMatrix[16]);
+
+    UploadStats GetUploadStats();
 
 private:
     static const int TEXTURE_COUNT = 3;
@@ -25,20 +55,43 @@ private:
     int mWindowWidth;
     int mWindowHeight;
 
-    GLuint mTextures[TEXTURE_COUNT];
+    TextureStream mTextures[TEXTURE_COUNT];
+    GLuint mOesTexture;
+    bool mPboSupported;
+
+    // 当前着色器对应的像素格式,以及上一次设置颜色矩阵用的颜色空间,变化的时候才需要重新设置
+    const PixelLayout *mLayout;
+    AVColorSpace mColorSpace;
+    AVColorRange mColorRange;
+
+    // attribute和uniform的位置在创建程序的时候查询一次,渲染的时候直接使用
+    GLint mPositionLoc;
+    GLint mCoordLoc;
+    GLint mPosScaleXLoc;
+    GLint mPosScaleYLoc;
+    GLint mCoordScaleXLoc;
+    GLint mTexMatrixLoc;
+    GLint mColorMatrixLoc;
+    GLint mOffsetLoc;
+
+    int64_t mUploadFrames;
+    int64_t mLastUploadUs;
+    int64_t mUploadUsSum;
+    int64_t mMaxUploadUs;
+
+    bool useProgram(const std::string &vShaderSource, const std::string &fShaderSource, const float *texCoords);
+
+    bool useLayout(const PixelLayout *layout);
+
+    void updateColorMatrix(const AVFrame *frame);
+
+    void releaseProgram();
 
     GLuint createProgram(const std::string &vShaderSource, const std::string &fShaderSource);
 
     GLuint loadShader(GLenum shaderType, const std::string &source);
 
-    GLuint createLuminanceTexture(int index, const std::string &texName, int width, int height);
-
-    void setTexture(
-            int index,
-            const std::string &texName,
-            const uint8_t *yuvData,
-            int width,
-            int height
-    );
+    // OpenGL ES 3.0以上才支持PBO
+    static bool isGles3();
 };
 
@@ -0,0 +1,140 @@
+#include "opensl_audio_sink.h"
+#include "common.h"
+
+OpenSLAudioSink::OpenSLAudioSink()
+        : mFormat({0, 0}),
+          mSource(NULL),
+          mEngineObject(NULL),
+          mEngine(NULL),
+          mOutputMixObject(NULL),
+          mPlayerObject(NULL),
+          mPlay(NULL),
+          mBufferQueue(NULL),
+          mBufferIndex(0) {
+}
+
+OpenSLAudioSink::~OpenSLAudioSink() {
+    Close();
+}
+
+bool OpenSLAudioSink::Open(const AudioFormat &format, AudioSource *source) {
+    mFormat = format;
+    mSource = source;
+
+    do {
+        // 创建引擎
+        if (SL_RESULT_SUCCESS != slCreateEngine(&mEngineObject, 0, NULL, 0, NULL, NULL)
+            || SL_RESULT_SUCCESS != (*mEngineObject)->Realize(mEngineObject, SL_BOOLEAN_FALSE)
+            || SL_RESULT_SUCCESS != (*mEngineObject)->GetInterface(mEngineObject, SL_IID_ENGINE, &mEngine)) {
+            LOGD("create opensl engine failed");
+            break;
+        }
+
+        // 创建混音器
+        if (SL_RESULT_SUCCESS != (*mEngine)->CreateOutputMix(mEngine, &mOutputMixObject, 0, NULL, NULL)
+            || SL_RESULT_SUCCESS != (*mOutputMixObject)->Realize(mOutputMixObject, SL_BOOLEAN_FALSE)) {
+            LOGD("create opensl output mix failed");
+            break;
+        }
+
+        // 数据源是缓冲队列,格式是交错存储的16位PCM
+        SLDataLocator_AndroidSimpleBufferQueue bufferQueueLocator = {
+                SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, BUFFER_COUNT
+        };
+        SLDataFormat_PCM pcmFormat = {
+                SL_DATAFORMAT_PCM,
+                (SLuint32) format.channels,
+                (SLuint32) format.sampleRate * 1000, // OpenSL ES的采样率单位是毫赫兹
+                SL_PCMSAMPLEFORMAT_FIXED_16,
+                SL_PCMSAMPLEFORMAT_FIXED_16,
+                (SLuint32) (format.channels == 1 ? SL_SPEAKER_FRONT_CENTER : SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT),
+                SL_BYTEORDER_LITTLEENDIAN
+        };
+        SLDataSource audioSource = {&bufferQueueLocator, &pcmFormat};
+
+        SLDataLocator_OutputMix outputMixLocator = {SL_DATALOCATOR_OUTPUTMIX, mOutputMixObject};
+        SLDataSink audioSink = {&outputMixLocator, NULL};
+
+        const SLInterfaceID ids[] = {SL_IID_BUFFERQUEUE};
+        const SLboolean required[] = {SL_BOOLEAN_TRUE};
+        if (SL_RESULT_SUCCESS != (*mEngine)->CreateAudioPlayer(mEngine, &mPlayerObject, &audioSource, &audioSink, 1, ids, required)
+            || SL_RESULT_SUCCESS != (*mPlayerObject)->Realize(mPlayerObject, SL_BOOLEAN_FALSE)
+            || SL_RESULT_SUCCESS != (*mPlayerObject)->GetInterface(mPlayerObject, SL_IID_PLAY, &mPlay)
+            || SL_RESULT_SUCCESS != (*mPlayerObject)->GetInterface(mPlayerObject, SL_IID_BUFFERQUEUE, &mBufferQueue)) {
+            LOGD("create opensl player failed");
+            break;
+        }
+
+        if (SL_RESULT_SUCCESS != (*mBufferQueue)->RegisterCallback(mBufferQueue, bufferQueueCallback, this)) {
+            LOGD("register opensl callback failed");
+            break;
+        }
+
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            mBuffers[i].resize(format.BytesPerSecond() * BUFFER_MS / 1000);
+        }
+        return true;
+    } while (0);
+
+    Close();
+    return false;
+}
+
+void OpenSLAudioSink::Start() {
+    (*mPlay)->SetPlayState(mPlay, SL_PLAYSTATE_PLAYING);
+
+    // 先把缓冲队列填满,之后每播放完一个缓冲就会回调一次
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        enqueueNextBuffer();
+    }
+}
+
+void OpenSLAudioSink::Stop() {
+    if (NULL != mPlay) {
+        (*mPlay)->SetPlayState(mPlay, SL_PLAYSTATE_STOPPED);
+    }
+    if (NULL != mBufferQueue) {
+        (*mBufferQueue)->Clear(mBufferQueue);
+    }
+}
+
+void OpenSLAudioSink::Close() {
+    Stop();
+
+    // Destroy会等待回调结束,所以之后可以安全地释放其他资源
+    if (NULL != mPlayerObject) {
+        (*mPlayerObject)->Destroy(mPlayerObject);
+        mPlayerObject = NULL;
+        mPlay = NULL;
+        mBufferQueue = NULL;
+    }
+
+    if (NULL != mOutputMixObject) {
+        (*mOutputMixObject)->Destroy(mOutputMixObject);
+        mOutputMixObject = NULL;
+    }
+
+    if (NULL != mEngineObject) {
+        (*mEngineObject)->Destroy(mEngineObject);
+        mEngineObject = NULL;
+        mEngine = NULL;
+    }
+    mSource = NULL;
+}
+
+int64_t OpenSLAudioSink::GetLatencyUs() {
+    // 缓冲队列里面的数据都还没有播放出来,硬件本身的延迟OpenSL ES无法获取,这里没有计算在内
+    return BUFFER_COUNT * BUFFER_MS * 1000;
+}
+
+void OpenSLAudioSink::bufferQueueCallback(SLAndroidSimpleBufferQueueItf bufferQueue, void *context) {
+    static_cast<OpenSLAudioSink *>(context)->enqueueNextBuffer();
+}
+
+void OpenSLAudioSink::enqueueNextBuffer() {
+    std::vector<uint8_t> &buffer = mBuffers[mBufferIndex];
+    mBufferIndex = (mBufferIndex + 1) % BUFFER_COUNT;
+
+    mSource->ReadAudio(buffer.data(), buffer.size());
+    (*mBufferQueue)->Enqueue(mBufferQueue, buffer.data(), buffer.size());
+}
@@ -0,0 +1,46 @@
+#ifndef __OPENSL_AUDIO_SINK_H__
+#define __OPENSL_AUDIO_SINK_H__
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+#include <vector>
+
+#include "audio_sink.h"
+
+// 使用OpenSL ES播放PCM
+// AAudio需要安卓8.0以上,而这个demo的minSdk是21,所以使用所有版本都支持的OpenSL ES
+// OpenSL ES在自己的线程里面回调bufferQueueCallback,我们在回调里面从AudioSource拉取数据再送回缓冲队列
+class OpenSLAudioSink : public AudioSink {
+public:
+    OpenSLAudioSink();
+    ~OpenSLAudioSink();
+
+    bool Open(const AudioFormat &format, AudioSource *source) override;
+    void Start() override;
+    void Stop() override;
+    void Close() override;
+    int64_t GetLatencyUs() override;
+
+private:
+    // 缓冲队列里面的缓冲个数和每个缓冲的时长
+    static const int BUFFER_COUNT = 2;
+    static const int BUFFER_MS = 20;
+
+    AudioFormat mFormat;
+    AudioSource *mSource;
+
+    SLObjectItf mEngineObject;
+    SLEngineItf mEngine;
+    SLObjectItf mOutputMixObject;
+    SLObjectItf mPlayerObject;
+    SLPlayItf mPlay;
+    SLAndroidSimpleBufferQueueItf mBufferQueue;
+
+    std::vector<uint8_t> mBuffers[BUFFER_COUNT];
+    int mBufferIndex;
+
+    static void bufferQueueCallback(SLAndroidSimpleBufferQueueItf bufferQueue, void *context);
+    void enqueueNextBuffer();
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "packet_pool.h"
+
+using namespace std;
+
+PacketPool::PacketPool(int packetCount)
+        : mCapacity(packetCount > 0 ? packetCount : 0),
+          mAcquired(0),
+          mPacketAllocs(0),
+          mPacketsInUse(0) {
+    // 预留好空间,Release的时候push_back就不会再分配内存
+    mFreePackets.reserve(mCapacity);
+    for(size_t i = 0 ; i < mCapacity ; i++) {
+        AVPacket* packet = av_packet_alloc();
+        if(NULL == packet) {
+            break;
+        }
+        mFreePackets.push_back(packet);
+        mPacketAllocs++;
+    }
+}
+
+PacketPool::~PacketPool() {
+    for(AVPacket* packet : mFreePackets) {
+        av_packet_free(&packet);
+    }
+    mFreePackets.clear();
+}
+
+AVPacket* PacketPool::Acquire() {
+    lock_guard<mutex> lock(mMutex);
+    AVPacket* packet = NULL;
+    if(mFreePackets.empty()) {
+        packet = av_packet_alloc();
+        if(NULL == packet) {
+            return NULL;
+        }
+        mPacketAllocs++;
+    } else {
+        packet = mFreePackets.back();
+        mFreePackets.pop_back();
+    }
+    mAcquired++;
+    mPacketsInUse++;
+    return packet;
+}
+
+void PacketPool::Release(AVPacket* packet) {
+    if(NULL == packet) {
+        return;
+    }
+
+    // 在锁外面unref,包里面的数据缓冲也是在这里释放的
+    av_packet_unref(packet);
+
+    lock_guard<mutex> lock(mMutex);
+    mPacketsInUse--;
+    if(mFreePackets.size() >= mCapacity) {
+        av_packet_free(&packet);
+        return;
+    }
+    mFreePackets.push_back(packet);
+}
+
+PacketPoolStats PacketPool::GetStats() {
+    lock_guard<mutex> lock(mMutex);
+    PacketPoolStats stats;
+    stats.acquired = mAcquired;
+    stats.packetAllocs = mPacketAllocs;
+    stats.packetsInUse = mPacketsInUse;
+    return stats;
+}
@@ -0,0 +1,44 @@
+#ifndef __PACKET_POOL_H__
+#define __PACKET_POOL_H__
+
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+struct PacketPoolStats {
+    int64_t acquired;        // Acquire的次数
+    int64_t packetAllocs;    // 新分配的AVPacket数量,预分配的也算在内,播放稳定之后不再增长
+    int64_t packetsInUse;    // 已经Acquire还没有Release的AVPacket数量
+};
+
+// 解复用线程和解码线程之间传递的数据包池
+// 原来每读一个包都要av_packet_alloc一个AVPacket,解码之后再av_packet_free
+// 这里预先分配好队列容量那么多的AVPacket放在空闲列表里面,解复用线程Acquire,解码线程(包括音频)用完之后Release放回来
+// 只复用AVPacket本身,包里面的数据缓冲是解复用器在av_read_frame里面分配的,av_packet_unref的时候释放
+class PacketPool {
+public:
+    explicit PacketPool(int packetCount);
+    ~PacketPool();
+
+    // 空闲列表为空的时候会新分配一个,所以不会失败,除非内存不足返回NULL
+    AVPacket* Acquire();
+
+    // av_packet_unref之后放回空闲列表,空闲列表已经满了(之前额外分配过)的话直接释放
+    void Release(AVPacket* packet);
+
+    PacketPoolStats GetStats();
+
+private:
+    std::mutex mMutex;
+    std::vector<AVPacket*> mFreePackets;
+    size_t mCapacity;
+
+    int64_t mAcquired;
+    int64_t mPacketAllocs;
+    int64_t mPacketsInUse;
+};
+
+#endif
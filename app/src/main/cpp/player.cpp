@@ -0,0 +1,783 @@
+#include "player.h"
+
+#include "common.h"
+#include "latency_stamp.h"
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+using namespace std;
+
+// 渲染晚于预定时间超过这个值就认为这一帧是迟到的
+static const int64_t LATE_THRESHOLD_US = 40000;
+
+// 等待显示时间的时候每次最多睡眠的时间
+static const int64_t MAX_SLEEP_US = 10000;
+
+// 最多记录多少个还没有渲染的时间戳,正常情况下不会超过数据包队列和帧队列的长度之和
+static const size_t MAX_STAMPS = 256;
+
+// 解复用线程放进数据包队列的seek标记,真正的数据包stream_index不会是负数
+// 借用pts保存目标时间(失败的时候是AV_NOPTS_VALUE),pos保存seek序号,flags保存seek方式
+static const int SEEK_STREAM_INDEX = -1;
+
+// 直播追赶延迟跳到下一个关键帧的标记,和seek标记一样清空解码器和帧队列,但是不需要往后解码到目标时间
+static const int JUMP_STREAM_INDEX = -2;
+
+static AVPacket* createSeekPacket(PacketPool* pool, int serial, int64_t target, SeekMode mode) {
+    AVPacket* packet = pool->Acquire();
+    if(NULL != packet) {
+        packet->stream_index = SEEK_STREAM_INDEX;
+        packet->pts = target;
+        packet->pos = serial;
+        packet->flags = mode;
+    }
+    return packet;
+}
+
+static AVPacket* createJumpPacket(PacketPool* pool, int serial) {
+    AVPacket* packet = createSeekPacket(pool, serial, AV_NOPTS_VALUE, SEEK_KEYFRAME);
+    if(NULL != packet) {
+        packet->stream_index = JUMP_STREAM_INDEX;
+    }
+    return packet;
+}
+
+static bool isSeekPacket(const AVPacket* packet) {
+    return SEEK_STREAM_INDEX == packet->stream_index || JUMP_STREAM_INDEX == packet->stream_index;
+}
+
+Player::Player() :
+        mFramePool(FRAME_POOL_SIZE),
+        mPacketPool(PACKET_POOL_SIZE),
+        mPacketQueue(PACKET_QUEUE_SIZE),
+        mFrameQueue(FRAME_QUEUE_SIZE),
+        mAbort(false),
+        mFastMode(false),
+        mVsync(NULL),
+        mAudioSink(NULL),
+        mHasAudio(false),
+        mOpenTime(-1),
+        mDemuxedPackets(0),
+        mDecodedFrames(0),
+        mRenderedFrames(0),
+        mLateFrames(0),
+        mDemuxUs(0),
+        mDecodeUs(0),
+        mRenderUs(0),
+        mStartupUs(-1),
+        mFirstPacketUs(-1),
+        mFirstFrameUs(-1),
+        mNalLengthSize(0),
+        mSeekTarget(0),
+        mSeekMode(SEEK_ACCURATE),
+        mSeekSerial(0),
+        mDemuxSerial(0),
+        mDemuxFinished(false),
+        mDecodeSerial(0),
+        mSeekTime(-1),
+        mAudioSeekTarget(AV_NOPTS_VALUE),
+        mLiveMode(false),
+        mLiveJumpPending(false) {
+}
+
+Player::~Player() {
+    Close();
+}
+
+bool Player::Open(const string& url, const DecoderConfig& config) {
+    mOpenTime = av_gettime_relative();
+
+    // 调用方没有指定帧池的话使用播放器自己的,解码线程和渲染线程之间传递的帧都从这里复用
+    DecoderConfig decoderConfig = config;
+    if(NULL == decoderConfig.framePool) {
+        decoderConfig.framePool = &mFramePool;
+    }
+    if(!mDecoder.Load(url, decoderConfig)) {
+        return false;
+    }
+
+    // 推流端打了时间戳的话可以统计端到端延迟
+    mNalLengthSize = GetNalLengthSize(mDecoder.GetVideoStream()->codecpar);
+
+    // 音频打开失败不影响视频播放
+    AVStream* audioStream = mDecoder.GetAudioStream();
+    if(NULL != mAudioSink && NULL != audioStream) {
+        mHasAudio = mAudioPlayer.Open(audioStream, mAudioSink, &mClock.GetAudioClock(), &mPacketPool);
+        mDecoder.SetReadAudio(mHasAudio);
+    }
+    return true;
+}
+
+void Player::SetAudioSink(AudioSink* sink) {
+    mAudioSink = sink;
+}
+
+void Player::SetFastMode(bool fastMode) {
+    mFastMode = fastMode;
+}
+
+void Player::SetVsyncSource(VsyncSource* vsync) {
+    mVsync = vsync;
+}
+
+VideoDecoder& Player::GetDecoder() {
+    return mDecoder;
+}
+
+void Player::Play(VideoRenderer* renderer) {
+    mAbort = false;
+    mLiveMode = mLive.IsEnabled() && !mDecoder.IsSeekable();
+    mDemuxFinished = false;
+    if(mHasAudio) {
+        mAudioPlayer.Start();
+    }
+    mDemuxThread = thread(&Player::demuxLoop, this);
+    mDecodeThread = thread(&Player::decodeLoop, this);
+
+    renderLoop(renderer);
+
+    if(mHasAudio) {
+        mAudioPlayer.Stop();
+    }
+
+    // 渲染结束之后让上游的线程也退出
+    mPacketQueue.Abort();
+    mFrameQueue.Abort();
+    mDemuxThread.join();
+    mDecodeThread.join();
+}
+
+bool Player::Seek(int64_t timestampUs, SeekMode mode) {
+    if(!mDecoder.IsSeekable()) {
+        return false;
+    }
+
+    // 解复用线程退出之后没有人处理seek标记,清空队列的话剩下的帧也没了,播放会直接结束
+    lock_guard<mutex> lock(mSeekMutex);
+    if(mDemuxFinished) {
+        return false;
+    }
+
+    // 队列里面都是旧位置的数据,直接丢掉,同时唤醒因为队列满了阻塞的解复用线程和解码线程
+    // 要在序号加一之前清空,否则可能把解复用线程刚放进去的新seek标记也丢掉
+    mPacketQueue.Flush([this](AVPacket* packet) { mPacketPool.Release(packet); });
+    mFrameQueue.Flush([this](AVFrame* frame) { mFramePool.Release(frame); });
+    if(mHasAudio) {
+        mAudioPlayer.Flush();
+    }
+
+    mSeekTarget = timestampUs;
+    mSeekMode = mode;
+    mSeekTime = av_gettime_relative();
+    mSeekSerial++;
+    return true;
+}
+
+void Player::Stop() {
+    mAbort = true;
+    mDecoder.Abort();
+    mPacketQueue.Abort();
+    mFrameQueue.Abort();
+    if(mHasAudio) {
+        mAudioPlayer.Abort();
+    }
+}
+
+void Player::Close() {
+    Stop();
+    if(mDemuxThread.joinable()) {
+        mDemuxThread.join();
+    }
+    if(mDecodeThread.joinable()) {
+        mDecodeThread.join();
+    }
+
+    // 队列里面剩下的数据需要释放
+    mPacketQueue.Flush([this](AVPacket* packet) { mPacketPool.Release(packet); });
+    mFrameQueue.Flush([this](AVFrame* frame) { mFramePool.Release(frame); });
+
+    mAudioPlayer.Close();
+    mHasAudio = false;
+    mDecoder.Release();
+
+    lock_guard<mutex> lock(mStampMutex);
+    mStamps.clear();
+    mNalLengthSize = 0;
+}
+
+void Player::demuxLoop() {
+    while(!mAbort) {
+        if(mSeekSerial != mDemuxSerial) {
+            seekInput();
+        }
+
+        // 数据包从数据包池里面取,由解码线程负责放回去
+        AVPacket* packet = mPacketPool.Acquire();
+        if(NULL == packet) {
+            break;
+        }
+
+        int64_t start = av_gettime_relative();
+        bool success = mDecoder.ReadPacket(packet);
+        int64_t elapsed = av_gettime_relative() - start;
+        mDemuxUs += elapsed;
+        mDemuxLatency.Record(elapsed);
+
+        if(!success) {
+            mPacketPool.Release(packet);
+
+            // 读到结尾的时候刚好有新的seek的话继续处理它,否则Seek已经清空了队列,却没有人放入seek标记
+            lock_guard<mutex> lock(mSeekMutex);
+            if(mSeekSerial != mDemuxSerial && !mAbort) {
+                continue;
+            }
+            mDemuxFinished = true;
+            break;
+        }
+
+        // 跳到下一个关键帧的时候当前这个包也不要了
+        if(mLiveMode && !updateLive(packet)) {
+            mPacketPool.Release(packet);
+            continue;
+        }
+
+        // 音频包交给AudioPlayer,它的队列满了同样会阻塞这里
+        if(mDecoder.IsAudioPacket(packet)) {
+            // 精确seek的时候目标时间之前的声音不播放,否则声音会比画面先开始
+            if(AV_NOPTS_VALUE != mAudioSeekTarget && AV_NOPTS_VALUE != packet->pts) {
+                AVRational timeBase = mDecoder.GetAudioTimeBase();
+                if(av_rescale_q(packet->pts + packet->duration, timeBase, AV_TIME_BASE_Q) <= mAudioSeekTarget) {
+                    mPacketPool.Release(packet);
+                    continue;
+                }
+                mAudioSeekTarget = AV_NOPTS_VALUE;
+            }
+            if(!mAudioPlayer.PushPacket(packet)) {
+                mPacketPool.Release(packet);
+                break;
+            }
+            continue;
+        }
+        recordStamp(packet);
+        if(mDemuxedPackets++ == 0 && mOpenTime != -1) {
+            mFirstPacketUs = av_gettime_relative() - mOpenTime;
+        }
+
+        // 队列满的时候这里会阻塞,直到解码线程取走数据包
+        if(!mPacketQueue.Push(packet)) {
+            mPacketPool.Release(packet);
+            break;
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(mSeekMutex);
+        mDemuxFinished = true;
+    }
+
+    // 告诉解码线程不会再有新的数据包了
+    mPacketQueue.Close();
+    if(mHasAudio) {
+        mAudioPlayer.EndOfStream();
+    }
+}
+
+void Player::decodeLoop() {
+    AVFrame* frame = NULL;
+
+    // 一个数据包不一定对应一帧,所以把两帧之间所有SendPacket和ReceiveFrame的耗时都算作后一帧的解码耗时
+    int64_t frameDecodeUs = 0;
+
+    // 硬解的输入缓冲区都在使用中的时候SendPacket会返回EAGAIN,这个包要留着,把输出读出来之后重新送入
+    AVPacket* pending = NULL;
+    while(!mAbort) {
+        // 队列里面的帧从帧池里面取,由渲染线程负责放回去
+        if(NULL == frame && NULL == (frame = mFramePool.Acquire())) {
+            break;
+        }
+
+        int64_t start = av_gettime_relative();
+        DecodeStatus status = mDecoder.ReceiveFrame(frame);
+        int64_t elapsed = av_gettime_relative() - start;
+        mDecodeUs += elapsed;
+        frameDecodeUs += elapsed;
+
+        if(DECODE_FRAME == status) {
+            mDecodeLatency.Record(frameDecodeUs);
+            frameDecodeUs = 0;
+            if(mDecodedFrames++ == 0 && mOpenTime != -1) {
+                mFirstFrameUs = av_gettime_relative() - mOpenTime;
+            }
+
+            // 帧队列满了代表渲染跟不上,这里会阻塞解码线程,进而让数据包队列堆积阻塞解复用线程
+            if(!mFrameQueue.Push(frame)) {
+                break;
+            }
+            frame = NULL;
+            continue;
+        }
+
+        if(DECODE_NEED_PACKET != status) {
+            // 解码器已经排空或者出错
+            break;
+        }
+
+        // 解码器需要新的数据包,数据包队列关闭并且取完之后送入空包让解码器把剩下的帧都吐出来
+        AVPacket* packet = pending;
+        bool hasPacket = NULL != packet || mPacketQueue.Pop(packet);
+        pending = NULL;
+        if(hasPacket && isSeekPacket(packet)) {
+            flushDecoder(packet);
+            mPacketPool.Release(packet);
+            continue;
+        }
+
+        start = av_gettime_relative();
+        int ret = mDecoder.SendPacket(hasPacket ? packet : NULL);
+        elapsed = av_gettime_relative() - start;
+        mDecodeUs += elapsed;
+        frameDecodeUs += elapsed;
+
+        // 送入空包返回EAGAIN的话,数据包队列还是空的,下一次会再送一次
+        if(AVERROR(EAGAIN) == ret && hasPacket) {
+            pending = packet;
+            continue;
+        }
+        if(hasPacket) {
+            mPacketPool.Release(packet);
+        }
+    }
+
+    mPacketPool.Release(pending);
+    mFramePool.Release(frame);
+    mFrameQueue.Close();
+}
+
+void Player::renderLoop(VideoRenderer* renderer) {
+    if(NULL != mVsync && !mFastMode) {
+        vsyncRenderLoop(renderer);
+        return;
+    }
+
+    AVFrame* frame = NULL;
+    int64_t presentTime = 0;
+    while(popFrame(true, &frame, &presentTime)) {
+        // 极速模式下不等待播放时间,解出来就马上渲染
+        if(!mFastMode && waitUntil(presentTime) > LATE_THRESHOLD_US) {
+            mLateFrames++;
+        }
+
+        // 等待的过程中开始了seek,这一帧还是seek之前的位置,不再显示
+        if(isSeeking()) {
+            mFramePool.Release(frame);
+            continue;
+        }
+        presentFrame(renderer, frame);
+    }
+}
+
+void Player::vsyncRenderLoop(VideoRenderer* renderer) {
+    // frame是下一个要显示的帧,还没有到显示时间的话一直留着,期间屏幕继续显示上一帧
+    AVFrame* frame = NULL;
+    int64_t presentTime = 0;
+    while(!mAbort) {
+        if(NULL == frame && !popFrame(true, &frame, &presentTime)) {
+            break;
+        }
+
+        mFrameScheduler.OnVsync(mVsync->WaitForVsync(), mVsync->GetPeriodUs());
+        if(isSeeking()) {
+            mFramePool.Release(frame);
+            frame = NULL;
+            continue;
+        }
+        if(!mFrameScheduler.IsDue(presentTime)) {
+            continue;
+        }
+
+        // 后面的帧也已经到了显示时间的话,这一帧不用显示了,直接显示最新的那一帧
+        AVFrame* next = NULL;
+        int64_t nextPresentTime = 0;
+        while(popFrame(false, &next, &nextPresentTime) && mFrameScheduler.IsDue(nextPresentTime)) {
+            mFrameScheduler.OnFrameDropped();
+            mFramePool.Release(frame);
+            frame = next;
+            presentTime = nextPresentTime;
+            next = NULL;
+        }
+
+        double speed = mClock.GetExternalClock().GetSpeed();
+        mFrameScheduler.OnFramePresented(presentTime, (int64_t) (mDecoder.GetFrameDuration(frame) / speed));
+        presentFrame(renderer, frame);
+        frame = next;
+        presentTime = nextPresentTime;
+    }
+
+    if(NULL != frame) {
+        mFramePool.Release(frame);
+    }
+}
+
+bool Player::popFrame(bool block, AVFrame** frame, int64_t* presentTime) {
+    AVFrame* popped = NULL;
+    while(block ? mFrameQueue.Pop(popped) : mFrameQueue.TryPop(popped)) {
+        // seek还没有完成的时候取到的都是旧位置的帧
+        if(isSeeking()) {
+            mFramePool.Release(popped);
+            continue;
+        }
+
+        // 由播放时钟决定这一帧什么时候显示,已经落后太多的帧直接丢掉
+        // 队列里面没有下一帧的时候就算迟到了也要显示,否则画面会一直停住
+        if(!mFastMode) {
+            bool canDrop = mFrameQueue.Size() > 0;
+            int64_t pts = mDecoder.GetFramePts(popped);
+            if(MediaClock::FRAME_DROP == mClock.ScheduleVideoFrame(pts, mDecoder.GetFrameDuration(popped), canDrop, presentTime)) {
+                mFramePool.Release(popped);
+                continue;
+            }
+        }
+        *frame = popped;
+        return true;
+    }
+    return false;
+}
+
+void Player::presentFrame(VideoRenderer* renderer, AVFrame* frame) {
+    int64_t start = av_gettime_relative();
+    renderer->Render(frame);
+    int64_t now = av_gettime_relative();
+    mRenderUs += now - start;
+    mRenderLatency.Record(now - start);
+    mClock.OnVideoFramePresented(mDecoder.GetFramePts(frame));
+    checkStamp(frame->pts, av_gettime());
+
+    if(mRenderedFrames++ == 0 && mOpenTime != -1) {
+        mStartupUs = now - mOpenTime;
+    }
+
+    // seek之后的第一帧画面
+    if(-1 != mSeekTime && !isSeeking()) {
+        int64_t seekTime = mSeekTime.exchange(-1);
+        if(-1 != seekTime) {
+            mSeekLatency.Record(now - seekTime);
+        }
+    }
+
+    // 渲染线程是帧的最后一个使用者,用完之后放回帧池
+    mFramePool.Release(frame);
+}
+
+void Player::seekInput() {
+    int64_t target = 0;
+    SeekMode mode = SEEK_ACCURATE;
+    {
+        lock_guard<mutex> lock(mSeekMutex);
+        target = mSeekTarget;
+        mode = mSeekMode;
+        mDemuxSerial = mSeekSerial;
+    }
+
+    bool success = mDecoder.SeekInput(target);
+    if(!success) {
+        LOGD("seek to %lldms failed", (long long) target / 1000);
+    }
+
+    // 调用Seek之后到这里之间读出来的数据包也是旧位置的
+    mPacketQueue.Flush([this](AVPacket* packet) { mPacketPool.Release(packet); });
+    if(mHasAudio) {
+        mAudioPlayer.Flush();
+    }
+    mAudioSeekTarget = success && SEEK_ACCURATE == mode ? target : AV_NOPTS_VALUE;
+
+    // seek失败也要放入标记,否则解码线程的序号一直追不上,渲染线程会把所有的帧都丢掉
+    AVPacket* packet = createSeekPacket(&mPacketPool, mDemuxSerial, success ? target : AV_NOPTS_VALUE, mode);
+    if(NULL != packet && !mPacketQueue.Push(packet)) {
+        mPacketPool.Release(packet);
+    }
+}
+
+void Player::flushDecoder(AVPacket* seekPacket) {
+    if(JUMP_STREAM_INDEX == seekPacket->stream_index) {
+        mDecoder.Flush();
+    } else if(AV_NOPTS_VALUE != seekPacket->pts) {
+        mDecoder.FlushDecoder(seekPacket->pts, (SeekMode) seekPacket->flags);
+    }
+
+    // 这之前解出来的帧都是旧位置的,时钟也要从seek之后的第一帧重新开始
+    mFrameQueue.Flush([this](AVFrame* frame) { mFramePool.Release(frame); });
+    mClock.Reset();
+    mFrameScheduler.Reset();
+    mDecodeSerial = (int) seekPacket->pos;
+}
+
+bool Player::isSeeking() {
+    return mDecodeSerial != mSeekSerial;
+}
+
+bool Player::updateLive(AVPacket* packet) {
+    bool audio = mDecoder.IsAudioPacket(packet);
+    if(AV_NOPTS_VALUE == packet->pts) {
+        return true;
+    }
+    AVRational timeBase = audio ? mDecoder.GetAudioTimeBase() : mDecoder.GetTimeBase();
+    int64_t pts = av_rescale_q(packet->pts, timeBase, AV_TIME_BASE_Q);
+
+    // 跳帧之后读到的第一个包就是视频关键帧,它之前的声音没有对应的画面,和精确seek一样不播放
+    if(mLiveJumpPending && !audio) {
+        mAudioSeekTarget = pts;
+        mLiveJumpPending = false;
+    }
+    mLive.OnPacket(pts);
+
+    // 跳帧还没有完成的时候时钟还是旧的位置,算出来的延迟没有意义
+    if(isSeeking()) {
+        return true;
+    }
+
+    double speed = 1.0;
+    switch(mLive.Update(mClock.GetMasterTime(), av_gettime_relative(), &speed)) {
+        case LiveController::LIVE_SET_SPEED:
+            setSpeed(speed);
+            return true;
+        case LiveController::LIVE_JUMP:
+            jumpToKeyFrame();
+            return false;
+        default:
+            return true;
+    }
+}
+
+void Player::jumpToKeyFrame() {
+    LiveStats stats = mLive.GetStats();
+    LOGD("live latency %lldms, jump to next key frame", (long long) stats.latencyUs / 1000);
+
+    // 和Seek一样先清空队列再增加序号,渲染线程在解码线程处理完标记之前会丢掉取到的旧画面
+    // 解复用线程自己更新mDemuxSerial,所以不会再去调用seekInput
+    {
+        lock_guard<mutex> lock(mSeekMutex);
+        mPacketQueue.Flush([this](AVPacket* packet) { mPacketPool.Release(packet); });
+        mFrameQueue.Flush([this](AVFrame* frame) { mFramePool.Release(frame); });
+        mSeekSerial++;
+        mDemuxSerial = mSeekSerial;
+    }
+    if(mHasAudio) {
+        mAudioPlayer.Flush();
+    }
+    setSpeed(1.0);
+
+    // 当前这个数据包由调用方丢掉,ReadPacket从下一个包开始一直丢到视频关键帧
+    mDecoder.SkipToKeyFrame();
+    mLive.Reset();
+    mLiveJumpPending = true;
+    mAudioSeekTarget = AV_NOPTS_VALUE;
+
+    AVPacket* packet = createJumpPacket(&mPacketPool, mDemuxSerial);
+    if(NULL != packet && !mPacketQueue.Push(packet)) {
+        mPacketPool.Release(packet);
+    }
+}
+
+void Player::setSpeed(double speed) {
+    LOGD("live latency %lldms, speed %.2f", (long long) mLive.GetStats().latencyUs / 1000, speed);
+    mClock.SetSpeed(speed);
+    if(mHasAudio) {
+        mAudioPlayer.SetSpeed(speed);
+    }
+}
+
+void Player::recordStamp(AVPacket* packet) {
+    int64_t stamp = 0;
+    if(0 == mNalLengthSize || AV_NOPTS_VALUE == packet->pts || !GetLatencyStamp(packet, mNalLengthSize, &stamp)) {
+        return;
+    }
+
+    lock_guard<mutex> lock(mStampMutex);
+    if(mStamps.size() >= MAX_STAMPS) {
+        mStamps.erase(mStamps.begin());
+    }
+    mStamps[packet->pts] = stamp;
+}
+
+void Player::checkStamp(int64_t pts, int64_t now) {
+    if(0 == mNalLengthSize) {
+        return;
+    }
+
+    lock_guard<mutex> lock(mStampMutex);
+    map<int64_t, int64_t>::iterator it = mStamps.find(pts);
+    if(it != mStamps.end()) {
+        mGlassLatency.Record(now - it->second);
+        it++;
+    } else {
+        it = mStamps.lower_bound(pts);
+    }
+
+    // 比这一帧早的时间戳对应的帧已经被丢掉或者已经渲染过了
+    mStamps.erase(mStamps.begin(), it);
+}
+
+int64_t Player::waitUntil(int64_t time) {
+    // 分段睡眠,这样在等待的过程中调用Stop或者Seek也能及时退出
+    int64_t now = av_gettime_relative();
+    while(time > now && !mAbort && !isSeeking()) {
+        int64_t sleep = time - now;
+        av_usleep(sleep > MAX_SLEEP_US ? MAX_SLEEP_US : sleep);
+        now = av_gettime_relative();
+    }
+    return now - time;
+}
+
+void Player::SetLiveConfig(const LiveConfig& config) {
+    mLive.SetConfig(config);
+}
+
+LiveStats Player::GetLiveStats() {
+    LiveStats stats = mLive.GetStats();
+    stats.enabled = mLiveMode;
+    stats.bufferedPackets = mPacketQueue.Size();
+    if(mHasAudio) {
+        stats.bufferedPackets += mAudioPlayer.GetStats().packetQueue.depth;
+    }
+    return stats;
+}
+
+void Player::SetSyncMode(SyncMode mode) {
+    mClock.SetSyncMode(mode);
+}
+
+MediaClock& Player::GetClock() {
+    return mClock;
+}
+
+PlayerStats Player::GetStats() {
+    PlayerStats stats;
+    stats.packetQueue = mPacketQueue.GetStats();
+    stats.frameQueue = mFrameQueue.GetStats();
+    stats.framePool = mFramePool.GetStats();
+    stats.packetPool = mPacketPool.GetStats();
+    stats.demuxedPackets = mDemuxedPackets;
+    stats.decodedFrames = mDecodedFrames;
+    stats.renderedFrames = mRenderedFrames;
+    stats.lateFrames = mLateFrames;
+    stats.demuxUs = mDemuxUs;
+    stats.decodeUs = mDecodeUs;
+    stats.renderUs = mRenderUs;
+    stats.demuxLatency = mDemuxLatency.GetStats();
+    stats.decodeLatency = mDecodeLatency.GetStats();
+    stats.renderLatency = mRenderLatency.GetStats();
+    stats.seekLatency = mSeekLatency.GetStats();
+    stats.seek = mDecoder.GetSeekStats();
+    stats.glassLatency = mGlassLatency.GetStats();
+    stats.startupUs = mStartupUs;
+    stats.startup.open = mDecoder.GetOpenStats();
+    stats.startup.openUs = stats.startup.open.openUs;
+    stats.startup.probeUs = stats.startup.open.openUs + stats.startup.open.probeUs;
+    stats.startup.firstPacketUs = mFirstPacketUs;
+    stats.startup.firstFrameUs = mFirstFrameUs;
+    stats.startup.firstRenderUs = mStartupUs;
+    stats.reconnects = mDecoder.GetReconnectCount();
+    stats.readAhead = mDecoder.GetReadAheadStats();
+    stats.live = GetLiveStats();
+    stats.sync = mClock.GetStats();
+    stats.vsync = NULL != mVsync && !mFastMode;
+    stats.scheduler = mFrameScheduler.GetStats();
+    stats.hasAudio = mHasAudio;
+    if(mHasAudio) {
+        stats.audio = mAudioPlayer.GetStats();
+    }
+    stats.decodeFps = stats.decodeUs > 0 ? stats.decodedFrames * 1000000.0 / stats.decodeUs : 0;
+    stats.decodeThreads = mDecoder.GetThreadCount();
+    stats.decodeThreadType = mDecoder.GetActiveThreadType();
+    stats.cpuCount = av_cpu_count();
+    return stats;
+}
+
+static void dumpQueueStats(const char* name, const QueueStats& stats) {
+    LOGD("%s: depth %zu/%zu, max %zu, avg %.1f, push %lld(blocked %lld, %lldms), pop %lld(starved %lld, %lldms)",
+         name, stats.depth, stats.capacity, stats.maxDepth, stats.avgDepth,
+         (long long) stats.pushCount, (long long) stats.fullCount, (long long) stats.pushWaitUs / 1000,
+         (long long) stats.popCount, (long long) stats.emptyCount, (long long) stats.popWaitUs / 1000);
+}
+
+static void dumpLatencyStats(const char* name, const LatencyStats& stats) {
+    LOGD("%s latency: count %lld, avg %lldus, p50 %lldus, p90 %lldus, p99 %lldus, max %lldus",
+         name, (long long) stats.count, (long long) stats.avgUs, (long long) stats.p50Us,
+         (long long) stats.p90Us, (long long) stats.p99Us, (long long) stats.maxUs);
+}
+
+void Player::DumpStats() {
+    PlayerStats stats = GetStats();
+    LOGD("startup %lldms, packets %lld, decoded %lld, rendered %lld, late %lld, reconnects %lld",
+         (long long) stats.startupUs / 1000, (long long) stats.demuxedPackets,
+         (long long) stats.decodedFrames, (long long) stats.renderedFrames, (long long) stats.lateFrames,
+         (long long) stats.reconnects);
+    LOGD("first frame: open %lldms, probe %lldms, packet %lldms, decode %lldms, render %lldms"
+         " (fast open %d, probe skipped %d, cached params %d, probe packets %d)",
+         (long long) stats.startup.openUs / 1000, (long long) stats.startup.probeUs / 1000,
+         (long long) stats.startup.firstPacketUs / 1000, (long long) stats.startup.firstFrameUs / 1000,
+         (long long) stats.startup.firstRenderUs / 1000, stats.startup.open.fastOpen,
+         stats.startup.open.probeSkipped, stats.startup.open.cachedParams, stats.startup.open.probePackets);
+    LOGD("demux %lldms, decode %lldms, render %lldms",
+         (long long) stats.demuxUs / 1000, (long long) stats.decodeUs / 1000, (long long) stats.renderUs / 1000);
+    dumpLatencyStats("demux", stats.demuxLatency);
+    if(stats.readAhead.enabled) {
+        LOGD("read ahead: buffered %lldKB, stalls %lld(%lldms)",
+             (long long) stats.readAhead.fillBytes / 1024, (long long) stats.readAhead.stalls,
+             (long long) stats.readAhead.stallUs / 1000);
+    }
+    dumpLatencyStats("decode", stats.decodeLatency);
+    dumpLatencyStats("render", stats.renderLatency);
+    if(stats.glassLatency.count > 0) {
+        dumpLatencyStats("glass-to-glass", stats.glassLatency);
+    }
+    if(stats.seekLatency.count > 0) {
+        dumpLatencyStats("seek", stats.seekLatency);
+        LOGD("last seek: decoder %lldms, discarded %lld frames, skipped %lld packets",
+             (long long) stats.seek.lastUs / 1000, (long long) stats.seek.lastDiscardedFrames,
+             (long long) stats.seek.lastSkippedPackets);
+    }
+    LOGD("decode %.1f fps, %d threads(%s), %d cores, hardware %d",
+         stats.decodeFps, stats.decodeThreads,
+         stats.decodeThreadType == FF_THREAD_FRAME ? "frame" : (stats.decodeThreadType == FF_THREAD_SLICE ? "slice" : "none"),
+         stats.cpuCount, mDecoder.IsHardware());
+    LOGD("sync mode %d, presented %lld, dropped %lld, resync %lld, drift avg %lldms max %lldms last %lldms",
+         mClock.GetEffectiveSyncMode(), (long long) stats.sync.presentedFrames, (long long) stats.sync.droppedFrames,
+         (long long) stats.sync.resyncCount, (long long) stats.sync.avgDriftUs / 1000,
+         (long long) stats.sync.maxDriftUs / 1000, (long long) stats.sync.lastDriftUs / 1000);
+    if(stats.live.enabled) {
+        LOGD("live: latency %lldms max %lldms, buffered %lld packets, speed %.2f, catch up %lld times(%lldms), jumps %lld",
+             (long long) stats.live.latencyUs / 1000, (long long) stats.live.maxLatencyUs / 1000,
+             (long long) stats.live.bufferedPackets, stats.live.speed, (long long) stats.live.catchUps,
+             (long long) stats.live.catchUpUs / 1000, (long long) stats.live.jumps);
+    }
+    if(stats.vsync) {
+        LOGD("vsync %.1fHz: vsyncs %lld, presented %lld, dropped %lld, repeated %lld, cadence errors %lld,"
+             " error avg %lldus max %lldus, judder avg %lldus max %lldus",
+             stats.scheduler.periodUs > 0 ? 1000000.0 / stats.scheduler.periodUs : 0,
+             (long long) stats.scheduler.vsyncs, (long long) stats.scheduler.presentedFrames,
+             (long long) stats.scheduler.droppedFrames, (long long) stats.scheduler.repeatedVsyncs,
+             (long long) stats.scheduler.cadenceErrors, (long long) stats.scheduler.avgErrorUs,
+             (long long) stats.scheduler.maxErrorUs, (long long) stats.scheduler.avgJudderUs,
+             (long long) stats.scheduler.maxJudderUs);
+    }
+    dumpQueueStats("packet queue", stats.packetQueue);
+    dumpQueueStats("frame queue", stats.frameQueue);
+    LOGD("frame pool: acquired %lld, frames %lld(in use %lld), buffers %lld x %dKB, buffer gets %lld, fallbacks %lld",
+         (long long) stats.framePool.acquired, (long long) stats.framePool.frameAllocs,
+         (long long) stats.framePool.framesInUse, (long long) stats.framePool.bufferAllocs,
+         stats.framePool.bufferSize / 1024, (long long) stats.framePool.bufferGets,
+         (long long) stats.framePool.fallbacks);
+    LOGD("packet pool: acquired %lld, packets %lld(in use %lld)",
+         (long long) stats.packetPool.acquired, (long long) stats.packetPool.packetAllocs,
+         (long long) stats.packetPool.packetsInUse);
+    if(stats.hasAudio) {
+        LOGD("audio: decoded %lld, underruns %lld, latency %lldms avg %lldms max %lldms",
+             (long long) stats.audio.decodedFrames, (long long) stats.audio.underruns,
+             (long long) stats.audio.latencyUs / 1000, (long long) stats.audio.avgLatencyUs / 1000,
+             (long long) stats.audio.maxLatencyUs / 1000);
+        dumpQueueStats("audio packet queue", stats.audio.packetQueue);
+    }
+}
@@ -0,0 +1,231 @@
+#ifndef __PLAYER_H__
+#define __PLAYER_H__
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "audio_player.h"
+#include "blocking_queue.h"
+#include "frame_pool.h"
+#include "frame_scheduler.h"
+#include "latency_recorder.h"
+#include "live_controller.h"
+#include "media_clock.h"
+#include "packet_pool.h"
+#include "video_decoder.h"
+#include "video_renderer.h"
+#include "vsync_source.h"
+
+// 首帧耗时的分解,都是从调用Open开始计算的时间,单位是微秒,还没有到达的阶段是-1
+struct StartupStats {
+    int64_t openUs;          // avformat_open_input完成
+    int64_t probeUs;         // 流信息探测完成
+    int64_t firstPacketUs;   // 解复用出第一个视频包
+    int64_t firstFrameUs;    // 解码出第一帧
+    int64_t firstRenderUs;   // 第一帧画面渲染出来
+    OpenStats open;          // 打开方式: 是否快速打开、是否跳过了avformat_find_stream_info等
+};
+
+struct PlayerStats {
+    QueueStats packetQueue;     // 解复用线程 -> 解码线程
+    QueueStats frameQueue;      // 解码线程 -> 渲染线程
+    FramePoolStats framePool;   // 两个线程之间传递的帧和画面缓冲的复用情况
+    PacketPoolStats packetPool; // 解复用线程和解码线程之间传递的数据包的复用情况
+
+    int64_t demuxedPackets;     // 解复用得到的视频包数量
+    int64_t decodedFrames;      // 解码得到的帧数量
+    int64_t renderedFrames;     // 渲染的帧数量
+    int64_t lateFrames;         // 渲染时已经超过播放时间一帧以上的帧数量
+    SyncStats sync;             // 音视频同步的统计(丢帧数、偏差等)
+
+    bool hasAudio;
+    AudioStats audio;           // 音频的统计(欠载次数、延迟等)
+
+    int64_t demuxUs;            // 解复用线程花在av_read_frame上的时间
+    int64_t decodeUs;           // 解码线程花在解码上的时间
+    int64_t renderUs;           // 渲染线程花在渲染上的时间
+
+    LatencyStats demuxLatency;  // 每次av_read_frame的耗时分布
+    LatencyStats decodeLatency; // 每解出一帧花在解码上的耗时分布
+    LatencyStats renderLatency; // 每一帧渲染的耗时分布
+    LatencyStats seekLatency;   // 从调用Seek到seek之后第一帧画面渲染出来的耗时
+    SeekStats seek;             // 解码器层面的seek统计(定位 + 往后解码到目标帧)
+    LatencyStats glassLatency;  // 端到端延迟: 推流端打的时间戳到这一帧渲染出来,只有推流端打了时间戳才有数据
+
+    int64_t startupUs;          // 从Open到第一帧画面渲染出来的耗时
+    StartupStats startup;       // 首帧耗时在各个阶段的分解
+    int64_t reconnects;         // 直播流断线重连的次数
+    ReadAheadStats readAhead;   // 网络预读缓冲的水位和解复用等网络的情况
+    LiveStats live;             // 直播低延迟模式的延迟、缓冲和追赶情况
+
+    bool vsync;                 // 是否按照vsync挑选显示的帧
+    FrameSchedulerStats scheduler; // 按照vsync显示的节奏、丢帧和抖动情况
+
+    double decodeFps;           // 解码线程每秒能解出的帧数(只算花在解码上的时间)
+    int decodeThreads;          // 解码器实际使用的线程数
+    int decodeThreadType;       // 解码器实际使用的多线程方式
+    int cpuCount;               // cpu核数
+};
+
+// 多线程播放器
+// 解复用、解码、渲染分别在三个线程里面进行,之间通过有界队列连接:
+//   解复用线程: av_read_frame -> mPacketQueue
+//   解码线程:   mPacketQueue -> avcodec_send_packet/avcodec_receive_frame -> mFrameQueue
+//   渲染线程:   mFrameQueue -> 由MediaClock决定显示时间或丢帧 -> VideoRenderer::Render
+//               设置了VsyncSource的话每个vsync醒来一次,由FrameScheduler挑选这个vsync显示哪一帧
+// 帧从mFramePool里面取,渲染或者丢弃之后放回去,软解的画面缓冲也是从这个池里面复用的,数据包同样从mPacketPool里面复用
+// 设置了AudioSink的话,解复用线程还会把音频包交给AudioPlayer,由它在自己的线程里面解码播放并更新音频时钟
+// 这样网络读取慢或者渲染慢都只会让对应的队列变空或者变满,不会直接卡住其他环节
+// 渲染线程就是调用Play的线程,因为EGL上下文需要在创建它的线程上使用
+class Player {
+public:
+    Player();
+    ~Player();
+
+    // 需要在Open之前设置,不设置的话只播放视频
+    void SetAudioSink(AudioSink* sink);
+
+    bool Open(const std::string& url, const DecoderConfig& config = DecoderConfig());
+
+    // 启动解复用和解码线程,并在当前线程进行渲染,直到播放结束或者调用了Stop
+    void Play(VideoRenderer* renderer);
+
+    // 可以在任意线程调用,清空队列之后马上返回,实际的seek由解复用线程和解码线程异步完成:
+    //   解复用线程: VideoDecoder::SeekInput定位到关键帧,然后往数据包队列放入一个seek标记
+    //   解码线程:   读到seek标记的时候清空解码器和帧队列,精确seek的话往后解码到目标时间
+    //   渲染线程:   seek完成之前取到的帧都是旧位置的,直接丢掉
+    // 直播流不能seek,读到文件末尾之后解复用线程已经退出,也不能再seek,这两种情况都返回false
+    bool Seek(int64_t timestampUs, SeekMode mode = SEEK_ACCURATE);
+
+    // 可以在其他线程调用,让Play尽快返回
+    void Stop();
+
+    void Close();
+
+    // 极速模式: 渲染线程不再按照pts等待,用于测试整条流水线的吞吐量
+    void SetFastMode(bool fastMode);
+
+    // 直播低延迟模式,需要在Play之前设置,只对直播流生效
+    // 缓冲的数据超过目标延迟的时候稍微加快播放速度追赶,落后太多的时候丢掉缓冲的数据跳到下一个关键帧
+    void SetLiveConfig(const LiveConfig& config);
+
+    // 当前延迟和缓冲深度,可以在任意线程调用
+    LiveStats GetLiveStats();
+
+    // 需要在Play之前设置,设置之后渲染线程按照vsync显示画面,不设置的话等到每一帧的显示时间就马上渲染
+    // 极速模式下不生效
+    void SetVsyncSource(VsyncSource* vsync);
+
+    // 音视频同步方式,默认以音频为主,没有音频的时候以外部时钟为主
+    void SetSyncMode(SyncMode mode);
+    MediaClock& GetClock();
+
+    VideoDecoder& GetDecoder();
+
+    PlayerStats GetStats();
+    void DumpStats();
+
+private:
+    static const int PACKET_QUEUE_SIZE = 64;
+    static const int FRAME_QUEUE_SIZE = 3;
+
+    // 帧队列里面的帧加上解码线程和渲染线程手上各一帧
+    static const int FRAME_POOL_SIZE = FRAME_QUEUE_SIZE + 2;
+
+    // 视频和音频两个队列里面的包,加上解复用线程、视频解码线程、音频解码线程手上的包和EAGAIN之后留着重新送入的包
+    static const int PACKET_POOL_SIZE = PACKET_QUEUE_SIZE + AudioPlayer::PACKET_QUEUE_SIZE + 5;
+
+    // 解码器上下文里面保存了帧池的指针,所以帧池要放在mDecoder前面,保证比它后析构
+    FramePool mFramePool;
+
+    // AudioPlayer也会把数据包放回这里,所以同样要比它后析构
+    PacketPool mPacketPool;
+    VideoDecoder mDecoder;
+    BlockingQueue<AVPacket*> mPacketQueue;
+    BlockingQueue<AVFrame*> mFrameQueue;
+
+    std::thread mDemuxThread;
+    std::thread mDecodeThread;
+    std::atomic<bool> mAbort;
+    bool mFastMode;
+
+    MediaClock mClock;
+    VsyncSource* mVsync;
+    FrameScheduler mFrameScheduler;
+    AudioSink* mAudioSink;
+    AudioPlayer mAudioPlayer;
+    bool mHasAudio;
+    int64_t mOpenTime;
+
+    std::atomic<int64_t> mDemuxedPackets;
+    std::atomic<int64_t> mDecodedFrames;
+    std::atomic<int64_t> mRenderedFrames;
+    std::atomic<int64_t> mLateFrames;
+    std::atomic<int64_t> mDemuxUs;
+    std::atomic<int64_t> mDecodeUs;
+    std::atomic<int64_t> mRenderUs;
+    LatencyRecorder mDemuxLatency;
+    LatencyRecorder mDecodeLatency;
+    LatencyRecorder mRenderLatency;
+    std::atomic<int64_t> mStartupUs;
+    std::atomic<int64_t> mFirstPacketUs;
+    std::atomic<int64_t> mFirstFrameUs;
+
+    // 推流端通过SEI带过来的发送时间,解复用线程按pts记录下来,渲染线程取出来计算端到端延迟
+    int mNalLengthSize;
+    std::mutex mStampMutex;
+    std::map<int64_t, int64_t> mStamps;
+    LatencyRecorder mGlassLatency;
+
+    // Seek每调用一次mSeekSerial加一,解复用线程和解码线程处理完之后分别更新自己的序号
+    // mDecodeSerial和mSeekSerial不相等代表还有seek没有完成
+    std::mutex mSeekMutex;
+    int64_t mSeekTarget;
+    SeekMode mSeekMode;
+    std::atomic<int> mSeekSerial;
+    int mDemuxSerial;
+
+    // 解复用线程已经退出(读到结尾、出错或者停止),在mSeekMutex里面设置,之后的Seek直接返回false
+    std::atomic<bool> mDemuxFinished;
+    std::atomic<int> mDecodeSerial;
+    std::atomic<int64_t> mSeekTime;
+    int64_t mAudioSeekTarget;
+    LatencyRecorder mSeekLatency;
+
+    // 直播低延迟模式,决策和跳帧都在解复用线程里面进行
+    LiveController mLive;
+    bool mLiveMode;
+    bool mLiveJumpPending;
+
+    void demuxLoop();
+    void decodeLoop();
+    void renderLoop(VideoRenderer* renderer);
+    void vsyncRenderLoop(VideoRenderer* renderer);
+
+    // 从帧队列取出下一个需要显示的帧,seek还没有完成时的旧帧和已经太晚的帧直接丢掉
+    // block为false的时候队列为空马上返回false
+    bool popFrame(bool block, AVFrame** frame, int64_t* presentTime);
+    void presentFrame(VideoRenderer* renderer, AVFrame* frame);
+
+    void recordStamp(AVPacket* packet);
+    void checkStamp(int64_t pts, int64_t now);
+
+    // 解复用线程里面执行seek,解码线程读到seek标记之后清空解码器
+    void seekInput();
+    void flushDecoder(AVPacket* seekPacket);
+    bool isSeeking();
+
+    // 解复用线程每读到一个数据包调用一次,按照缓冲的时长调整播放速度或者跳到下一个关键帧
+    // 跳帧的时候返回false,这个数据包需要丢掉
+    bool updateLive(AVPacket* packet);
+    void jumpToKeyFrame();
+    void setSpeed(double speed);
+
+    // 等到指定的系统时间,返回比指定时间晚了多少微秒
+    int64_t waitUntil(int64_t time);
+};
+
+#endif
@@ -0,0 +1,9 @@
+# 打印每个库和总共的大小,用法: cmake -DLIBS="a.so;b.so" -P print_size.cmake
+set(TOTAL 0)
+foreach(lib ${LIBS})
+    file(SIZE ${lib} size)
+    math(EXPR TOTAL "${TOTAL} + ${size}")
+    get_filename_component(name ${lib} NAME)
+    message("${name}: ${size} bytes")
+endforeach()
+message("native libs total: ${TOTAL} bytes")
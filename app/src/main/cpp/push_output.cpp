@@ -0,0 +1,366 @@
+#include "push_output.h"
+#include "reconnect.h"
+
+#include <iostream>
+#include <string.h>
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/time.h>
+}
+
+using namespace std;
+
+PushOutput::PushOutput(const string &url, const string &format, const AVDictionary *options)
+        : mUrl(url),
+          mFormat(format),
+          mOptions(NULL),
+          mVideoStreamIndex(-1),
+          mOutput(NULL),
+          mPacketQueue(PACKET_QUEUE_SIZE),
+          mAbort(false),
+          mFinishing(false),
+          mConnected(false),
+          mFailed(false),
+          mResync(false),
+          mWaitKeyFrame(false),
+          mSentPackets(0),
+          mSentBytes(0),
+          mDroppedPackets(0),
+          mWriteErrors(0),
+          mReconnects(0),
+          mBitrateKbps(0),
+          mConnectTime(0),
+          mConnectCount(0),
+          mWindowStart(0),
+          mWindowBytes(0),
+          mWriteCalls(0),
+          mWriteCallsPerSec(0),
+          mPrevWriteCalls(0),
+          mWindowWriteCalls(0) {
+    av_dict_copy(&mOptions, options, 0);
+}
+
+PushOutput::~PushOutput() {
+    Stop();
+    for(AVCodecParameters* codecParam : mCodecParams) {
+        avcodec_parameters_free(&codecParam);
+    }
+    av_dict_free(&mOptions);
+}
+
+bool PushOutput::Start(AVFormatContext* input, int videoStreamIndex) {
+    for(size_t i = 0 ; i < input->nb_streams ; i++) {
+        AVCodecParameters* codecParam = avcodec_parameters_alloc();
+        if(NULL == codecParam || avcodec_parameters_copy(codecParam, input->streams[i]->codecpar) < 0) {
+            cout << "can't copy codec paramters, stream index " << i << endl;
+            avcodec_parameters_free(&codecParam);
+            return false;
+        }
+        mCodecParams.push_back(codecParam);
+        mTimeBases.push_back(input->streams[i]->time_base);
+    }
+
+    mVideoStreamIndex = videoStreamIndex;
+    mAbort = false;
+    mFinishing = false;
+    mWriteThread = thread(&PushOutput::writeLoop, this);
+    return true;
+}
+
+void PushOutput::Push(const AVPacket* packet, const GopCache& gop) {
+    lock_guard<mutex> lock(mPushMutex);
+
+    // 没有连接的时候数据直接丢弃,连接成功之后会从GOP缓存补上
+    if(mFailed || !mConnected) {
+        mDroppedPackets++;
+        return;
+    }
+
+    // 刚连接上,从最近一个关键帧开始发送,GOP缓存里面已经包含了当前的数据包
+    if(mResync) {
+        mResync = false;
+        mWaitKeyFrame = mVideoStreamIndex >= 0;
+        if(!gop.IsEmpty()) {
+            bool queued = true;
+            for(const AVPacket* cached : gop.GetPackets()) {
+                if(!enqueue(cached)) {
+                    queued = false;
+                    break;
+                }
+            }
+            if(queued) {
+                mWaitKeyFrame = false;
+                return;
+            }
+
+            // 缓存的GOP比队列还大,只能丢掉等下一个关键帧
+            mPacketQueue.Flush([](AVPacket* packet) { av_packet_free(&packet); });
+        }
+    }
+
+    if(mWaitKeyFrame) {
+        if(packet->stream_index != mVideoStreamIndex || !(packet->flags & AV_PKT_FLAG_KEY)) {
+            mDroppedPackets++;
+            return;
+        }
+        mWaitKeyFrame = false;
+    }
+
+    if(!enqueue(packet)) {
+        // 队列满了说明这个目的地写得比读取慢,丢弃数据并等待下一个关键帧重新开始
+        mWaitKeyFrame = mVideoStreamIndex >= 0;
+    }
+}
+
+bool PushOutput::enqueue(const AVPacket* packet) {
+    // av_packet_clone只是增加数据的引用计数,不会拷贝压缩数据
+    AVPacket* clone = av_packet_clone(packet);
+    if(NULL == clone || !mPacketQueue.TryPush(clone)) {
+        av_packet_free(&clone);
+        mDroppedPackets++;
+        return false;
+    }
+    return true;
+}
+
+void PushOutput::Finish() {
+    mFinishing = true;
+    mPacketQueue.Close();
+    if(mWriteThread.joinable()) {
+        mWriteThread.join();
+    }
+}
+
+void PushOutput::Stop() {
+    mAbort = true;
+    mPacketQueue.Abort();
+    if(mWriteThread.joinable()) {
+        mWriteThread.join();
+    }
+    mPacketQueue.Flush([](AVPacket* packet) { av_packet_free(&packet); });
+}
+
+const string& PushOutput::GetUrl() {
+    return mUrl;
+}
+
+OutputStats PushOutput::GetStats() {
+    OutputStats stats;
+    stats.url = mUrl;
+    stats.connected = mConnected;
+    stats.failed = mFailed;
+    stats.queue = mPacketQueue.GetStats();
+    stats.sentPackets = mSentPackets;
+    stats.sentBytes = mSentBytes;
+    stats.droppedPackets = mDroppedPackets;
+    stats.writeErrors = mWriteErrors;
+    stats.reconnects = mReconnects;
+    stats.bitrateKbps = mBitrateKbps;
+    stats.writeCalls = mWriteCalls;
+    stats.writeCallsPerSec = mWriteCallsPerSec;
+
+    int64_t duration = mConnectTime > 0 ? av_gettime_relative() - mConnectTime : 0;
+    stats.avgBitrateKbps = duration > 0 ? stats.sentBytes * 8 * 1000 / duration : 0;
+    return stats;
+}
+
+void PushOutput::writeLoop() {
+    // 本地文件写入失败一般是磁盘满了之类的问题,重试也没有用,只有网络地址才重连
+    Backoff backoff(IsNetworkUrl(mUrl) ? -1 : 0);
+    auto stopped = [this] { return mAbort || mFinishing; };
+
+    while(!mAbort) {
+        if(!connect()) {
+            if(!backoff.Wait(stopped)) {
+                break;
+            }
+            continue;
+        }
+        if(mConnectCount++ > 0) {
+            mReconnects++;
+        }
+        backoff.Reset();
+
+        // 断开期间队列里可能还有过时的数据,清空之后让读取线程从GOP缓存重新开始
+        {
+            lock_guard<mutex> lock(mPushMutex);
+            mPacketQueue.Flush([](AVPacket* packet) { av_packet_free(&packet); });
+            mResync = true;
+            mConnected = true;
+        }
+
+        if(writePackets()) {
+            // 输入结束或者Stop
+            disconnect(!mAbort);
+            return;
+        }
+
+        // 写入失败一般是网络断开,断开之后读取线程放入的数据都会被丢弃
+        mWriteErrors++;
+        disconnect(false);
+        if(!backoff.Wait(stopped)) {
+            break;
+        }
+    }
+
+    // 重试次数用完了,这个目的地不再继续推送,其他目的地不受影响
+    if(!mAbort && !mFinishing) {
+        mFailed = true;
+    }
+    mPacketQueue.Abort();
+}
+
+bool PushOutput::writePackets() {
+    AVPacket* packet = NULL;
+    while(mPacketQueue.Pop(packet)) {
+        bool written = writePacket(packet);
+        av_packet_free(&packet);
+        if(!written) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PushOutput::connect() {
+    // 本地文件可以根据后缀名推测封装格式,rtmp只支持flv,其他网络协议(udp、srt等)默认使用mpegts
+    const char* format = mFormat.empty() ? NULL : mFormat.c_str();
+    if(NULL == format && 0 == mUrl.compare(0, 4, "rtmp")) {
+        format = "flv";
+    }
+    if(avformat_alloc_output_context2(&mOutput, NULL, format, mUrl.c_str()) < 0
+        && (NULL != format || avformat_alloc_output_context2(&mOutput, NULL, "mpegts", mUrl.c_str()) < 0)) {
+        cout << "can't alloc output context for " << mUrl << endl;
+        return false;
+    }
+
+    // 阻塞的网络操作会定期调用interruptCallback,Stop的时候可以让它们立即返回
+    mOutput->interrupt_callback.callback = interruptCallback;
+    mOutput->interrupt_callback.opaque = this;
+
+    do {
+        bool result = true;
+        for(size_t i = 0 ; i < mCodecParams.size() ; i++) {
+            AVStream* stream = avformat_new_stream(mOutput, NULL);
+            if(NULL == stream || avcodec_parameters_copy(stream->codecpar, mCodecParams[i]) < 0) {
+                cout << "can't create stream, index " << i << endl;
+                result = false;
+                break;
+            }
+
+            // 输入的codec_tag不一定被输出的封装格式支持,设置为0让FFmpeg根据codec_id重新选择
+            if(av_codec_get_id(mOutput->oformat->codec_tag, stream->codecpar->codec_tag) != stream->codecpar->codec_id) {
+                stream->codecpar->codec_tag = 0;
+            }
+            stream->time_base = mTimeBases[i];
+        }
+        if(!result) {
+            break;
+        }
+
+        // avio_open2会把用掉的参数从字典里面删除,所以每次连接都用一份拷贝
+        if(!(mOutput->oformat->flags & AVFMT_NOFILE)) {
+            AVDictionary* options = NULL;
+            av_dict_copy(&options, mOptions, 0);
+            int ret = avio_open2(&mOutput->pb, mUrl.c_str(), AVIO_FLAG_WRITE, &mOutput->interrupt_callback, &options);
+            av_dict_free(&options);
+            if(ret < 0) {
+                cout << "can't open avio " << mUrl << endl;
+                break;
+            }
+        }
+
+        // flv需要设置flvflags为no_duration_filesize,否则直播流结束的时候会因为无法回写文件头报错
+        AVDictionary* opts = NULL;
+        if(0 == strcmp(mOutput->oformat->name, "flv")) {
+            av_dict_set(&opts, "flvflags", "no_duration_filesize", 0);
+        }
+        int ret = avformat_write_header(mOutput, &opts);
+        av_dict_free(&opts);
+        if(ret < 0) {
+            cout << "write header to " << mUrl << " failed" << endl;
+            break;
+        }
+
+        mConnectTime = av_gettime_relative();
+        mWindowStart = mConnectTime;
+        mWindowBytes = 0;
+        mPrevWriteCalls = mWriteCalls;
+        mWindowWriteCalls = getWriteCalls();
+        if(mWindowWriteCalls < 0) {
+            mWindowWriteCalls = 0;
+        }
+        cout << "output " << mUrl << " connected" << endl;
+        return true;
+    } while(0);
+
+    disconnect(false);
+    return false;
+}
+
+void PushOutput::disconnect(bool writeTrailer) {
+    if(NULL == mOutput) {
+        return;
+    }
+
+    if(writeTrailer && mConnected) {
+        av_write_trailer(mOutput);
+    }
+    if(!(mOutput->oformat->flags & AVFMT_NOFILE) && NULL != mOutput->pb) {
+        avio_closep(&mOutput->pb);
+    }
+    avformat_free_context(mOutput);
+    mOutput = NULL;
+    mConnected = false;
+}
+
+bool PushOutput::writePacket(AVPacket* packet) {
+    int index = packet->stream_index;
+    int size = packet->size;
+
+    // 输出流的time_base在avformat_write_header之后可能被封装格式修改(例如flv固定是1/1000)
+    av_packet_rescale_ts(packet, mTimeBases[index], mOutput->streams[index]->time_base);
+    packet->pos = -1;
+
+    // av_interleaved_write_frame会接管packet的数据,写完之后packet会被重置
+    if(av_interleaved_write_frame(mOutput, packet) < 0) {
+        cout << "write to " << mUrl << " failed" << endl;
+        return false;
+    }
+
+    mSentPackets++;
+    mSentBytes += size;
+
+    // 按一秒的窗口统计当前码率
+    mWindowBytes += size;
+    int64_t now = av_gettime_relative();
+    int64_t writeCalls = getWriteCalls();
+    if(writeCalls >= 0) {
+        mWriteCalls = mPrevWriteCalls + writeCalls;
+    }
+    if(now - mWindowStart >= AV_TIME_BASE) {
+        mBitrateKbps = mWindowBytes * 8 * 1000 / (now - mWindowStart);
+        if(writeCalls >= 0) {
+            mWriteCallsPerSec = (writeCalls - mWindowWriteCalls) * AV_TIME_BASE / (now - mWindowStart);
+            mWindowWriteCalls = writeCalls;
+        }
+        mWindowStart = now;
+        mWindowBytes = 0;
+    }
+    return true;
+}
+
+int64_t PushOutput::getWriteCalls() {
+    // 统计数据是rtmp协议的只读参数,通过AVIOContext -> URLContext -> RTMPContext查找
+    int64_t writeCalls = -1;
+    if(NULL == mOutput->pb || av_opt_get_int(mOutput->pb, "rtmp_write_calls", AV_OPT_SEARCH_CHILDREN, &writeCalls) < 0) {
+        return -1;
+    }
+    return writeCalls;
+}
+
+int PushOutput::interruptCallback(void* context) {
+    // 结束推流的时候如果还在连接服务器,也不需要再等了
+    PushOutput* output = static_cast<PushOutput*>(context);
+    return output->mAbort || (output->mFinishing && !output->mConnected) ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+#ifndef __PUSH_OUTPUT_H__
+#define __PUSH_OUTPUT_H__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "blocking_queue.h"
+#include "gop_cache.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 单个推流目的地的统计数据
+struct OutputStats {
+    std::string url;
+    bool connected;
+    bool failed;
+    QueueStats queue;          // 读取线程 -> 写线程
+    int64_t sentPackets;
+    int64_t sentBytes;
+    int64_t droppedPackets;    // 队列满或者等待关键帧而丢弃的数据包
+    int64_t writeErrors;
+    int64_t reconnects;
+    int64_t bitrateKbps;       // 最近一秒的码率
+    int64_t avgBitrateKbps;    // 连接之后的平均码率
+
+    // rtmp协议层向socket写数据的次数(所有连接的总和)和最近一秒的次数,其他协议没有这个统计,都是0
+    // 握手的每次写入也算在内,之后每个rtmp消息(包括拆分出来的所有chunk)只写一次
+    int64_t writeCalls;
+    int64_t writeCallsPerSec;
+};
+
+// 一个推流目的地(rtmp服务器、本地flv/ts文件等)
+// 每个目的地都有自己的写线程和有界队列,连接服务器和写入数据都在写线程里进行
+// 读取线程调用Push放入数据包的时候不会阻塞,队列满了就丢弃,所以一个目的地网络慢或者断开不会影响其他目的地
+// 丢包之后要等到下一个视频关键帧才继续放入数据,避免服务器收到无法解码的残缺GOP
+// 网络地址断开之后会按指数退避自动重连,连接(或者重连)成功之后先发送GopCache里面最近的一个GOP,
+// 服务器那边的观众不需要等下一个关键帧就能看到画面
+class PushOutput {
+public:
+    // format为空的时候根据url推测封装格式,rtmp地址使用flv
+    // options是打开url时传给协议层的参数,例如rtmp的listen,每次连接(或者重连)都会使用
+    PushOutput(const std::string &url, const std::string &format, const AVDictionary *options = NULL);
+    ~PushOutput();
+
+    // 拷贝输入流的轨道信息并启动写线程
+    bool Start(AVFormatContext *input, int videoStreamIndex);
+
+    // 由读取线程调用,不会阻塞,这里只会增加packet数据的引用计数,调用者仍然需要释放自己的packet
+    // gop是包含了这个packet在内的最近一个GOP,刚连接上的时候用它补齐数据
+    void Push(const AVPacket *packet, const GopCache &gop);
+
+    // 写完队列里剩下的数据之后写入文件尾并结束写线程
+    void Finish();
+
+    // 丢弃队列里的数据立即结束写线程
+    void Stop();
+
+    const std::string &GetUrl();
+
+    OutputStats GetStats();
+
+private:
+    static const int PACKET_QUEUE_SIZE = 256;
+
+    std::string mUrl;
+    std::string mFormat;
+    AVDictionary *mOptions;
+
+    // 输入流轨道的拷贝,写线程用它创建输出流,不依赖输入的AVFormatContext
+    std::vector<AVCodecParameters *> mCodecParams;
+    std::vector<AVRational> mTimeBases;
+    int mVideoStreamIndex;
+
+    AVFormatContext *mOutput;
+    BlockingQueue<AVPacket *> mPacketQueue;
+    std::thread mWriteThread;
+    std::atomic<bool> mAbort;
+    std::atomic<bool> mFinishing;
+    std::atomic<bool> mConnected;
+    std::atomic<bool> mFailed;
+
+    // 写线程连接成功之后设置mResync,读取线程下一次Push的时候清空队列并放入GOP缓存
+    // 两边都需要同时修改队列和这两个标记,所以用mPushMutex保护
+    std::mutex mPushMutex;
+    bool mResync;
+    bool mWaitKeyFrame;
+
+    std::atomic<int64_t> mSentPackets;
+    std::atomic<int64_t> mSentBytes;
+    std::atomic<int64_t> mDroppedPackets;
+    std::atomic<int64_t> mWriteErrors;
+    std::atomic<int64_t> mReconnects;
+    std::atomic<int64_t> mBitrateKbps;
+    std::atomic<int64_t> mConnectTime;
+    int mConnectCount;
+    int64_t mWindowStart;
+    int64_t mWindowBytes;
+    std::atomic<int64_t> mWriteCalls;
+    std::atomic<int64_t> mWriteCallsPerSec;
+    int64_t mPrevWriteCalls;      // 之前的连接写数据的次数
+    int64_t mWindowWriteCalls;    // 当前连接在统计窗口开始时写数据的次数
+
+    void writeLoop();
+
+    // 把队列里的数据写到当前连接,队列结束的时候返回true,写入失败返回false
+    bool writePackets();
+
+    // 放入一个数据包的引用,队列满的时候丢弃并返回false
+    bool enqueue(const AVPacket *packet);
+
+    bool connect();
+
+    void disconnect(bool writeTrailer);
+
+    bool writePacket(AVPacket *packet);
+
+    // 当前连接的rtmp协议层向socket写数据的次数,不是rtmp协议的时候返回-1
+    int64_t getWriteCalls();
+
+    static int interruptCallback(void *context);
+};
+
+#endif
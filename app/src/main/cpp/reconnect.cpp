@@ -0,0 +1,106 @@
+#include "reconnect.h"
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+using namespace std;
+
+// 上一个连接最后一个数据包没有时长的时候,按这个间隔接上新的连接
+static const int64_t DEFAULT_GAP_US = 40000;
+
+Backoff::Backoff(int maxAttempts, int64_t initialDelayUs, int64_t maxDelayUs)
+        : mMaxAttempts(maxAttempts),
+          mInitialDelayUs(initialDelayUs),
+          mMaxDelayUs(maxDelayUs),
+          mAttempts(0) {
+}
+
+bool Backoff::Wait(const function<bool()>& abort) {
+    if(mMaxAttempts >= 0 && mAttempts >= mMaxAttempts) {
+        return false;
+    }
+
+    int64_t delay = mInitialDelayUs;
+    for(int i = 0 ; i < mAttempts && delay < mMaxDelayUs ; i++) {
+        delay *= 2;
+    }
+    if(delay > mMaxDelayUs) {
+        delay = mMaxDelayUs;
+    }
+    mAttempts++;
+
+    // 分段睡眠,退出的时候不用等完整个间隔
+    int64_t end = av_gettime_relative() + delay;
+    while(!abort()) {
+        int64_t remain = end - av_gettime_relative();
+        if(remain <= 0) {
+            return true;
+        }
+        av_usleep(remain > 10000 ? 10000 : remain);
+    }
+    return false;
+}
+
+void Backoff::Reset() {
+    mAttempts = 0;
+}
+
+int Backoff::GetAttempts() {
+    return mAttempts;
+}
+
+TimestampRebaser::TimestampRebaser() {
+    Reset();
+}
+
+void TimestampRebaser::Restart() {
+    mRestart = true;
+}
+
+void TimestampRebaser::Rebase(AVPacket* packet, AVRational inTimeBase, AVRational outTimeBase) {
+    int64_t ts = AV_NOPTS_VALUE != packet->dts ? packet->dts : packet->pts;
+    if(mRestart && AV_NOPTS_VALUE != ts) {
+        mRestart = false;
+        if(AV_NOPTS_VALUE != mLastDtsUs) {
+            int64_t gap = mLastDurationUs > 0 ? mLastDurationUs : DEFAULT_GAP_US;
+            mOffsetUs = mLastDtsUs + gap - av_rescale_q(ts, inTimeBase, AV_TIME_BASE_Q);
+        }
+    }
+
+    int64_t offset = av_rescale_q(mOffsetUs, AV_TIME_BASE_Q, outTimeBase);
+    if(AV_NOPTS_VALUE != packet->pts) {
+        packet->pts = av_rescale_q(packet->pts, inTimeBase, outTimeBase) + offset;
+    }
+    if(AV_NOPTS_VALUE != packet->dts) {
+        packet->dts = av_rescale_q(packet->dts, inTimeBase, outTimeBase) + offset;
+    }
+    packet->duration = av_rescale_q(packet->duration, inTimeBase, outTimeBase);
+
+    if(AV_NOPTS_VALUE != ts) {
+        int64_t dts = av_rescale_q(ts, inTimeBase, AV_TIME_BASE_Q) + mOffsetUs;
+        if(AV_NOPTS_VALUE == mLastDtsUs || dts > mLastDtsUs) {
+            mLastDtsUs = dts;
+            mLastDurationUs = av_rescale_q(packet->duration, outTimeBase, AV_TIME_BASE_Q);
+        }
+    }
+}
+
+void TimestampRebaser::Reset() {
+    mRestart = false;
+    mOffsetUs = 0;
+    mLastDtsUs = AV_NOPTS_VALUE;
+    mLastDurationUs = 0;
+}
+
+bool IsLiveInput(AVFormatContext* formatContext) {
+    // 有些demuxer(例如rtsp)自己管理网络连接,没有AVIOContext,它们都是直播流
+    if(NULL == formatContext->pb) {
+        return NULL != formatContext->iformat && (formatContext->iformat->flags & AVFMT_NOFILE);
+    }
+    return !(formatContext->pb->seekable & AVIO_SEEKABLE_NORMAL);
+}
+
+bool IsNetworkUrl(const string& url) {
+    return string::npos != url.find("://") && 0 != url.compare(0, 5, "file:");
+}
@@ -0,0 +1,62 @@
+#ifndef __RECONNECT_H__
+#define __RECONNECT_H__
+
+#include <functional>
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 断线重连的指数退避: 第n次重试之前等待min(initialDelay * 2^n, maxDelay)
+// 网络刚断开的时候很快重试,一直连不上的时候慢慢拉长间隔,避免频繁重连给服务器和设备带来压力
+class Backoff {
+public:
+    // maxAttempts小于0代表不限制重试次数
+    explicit Backoff(int maxAttempts = -1, int64_t initialDelayUs = 500000, int64_t maxDelayUs = 8000000);
+
+    // 等待到下一次重试的时间,超过重试次数或者abort返回true的时候返回false
+    bool Wait(const std::function<bool()>& abort);
+
+    // 连接成功之后重置,下次断开的时候重新从initialDelay开始
+    void Reset();
+
+    int GetAttempts();
+
+private:
+    int mMaxAttempts;
+    int64_t mInitialDelayUs;
+    int64_t mMaxDelayUs;
+    int mAttempts;
+};
+
+// 重连之后新连接的时间戳一般会从0重新开始(或者跳到一个完全不同的值)
+// TimestampRebaser把新连接的时间戳接到上一个连接最后一个数据包后面,让下游(服务器、解码器、时钟)看到连续递增的dts
+// 所有轨道使用同一个偏移,所以音视频的相对关系不会改变
+class TimestampRebaser {
+public:
+    TimestampRebaser();
+
+    // 开始了一个新的连接,之后的第一个数据包会被接到上一个连接的后面
+    void Restart();
+
+    // 加上偏移并把时间戳从inTimeBase换算到outTimeBase
+    // outTimeBase一般是第一个连接的time_base,这样重连之后下游也不需要关心time_base的变化
+    void Rebase(AVPacket* packet, AVRational inTimeBase, AVRational outTimeBase);
+
+    void Reset();
+
+private:
+    bool mRestart;
+    int64_t mOffsetUs;
+    int64_t mLastDtsUs;
+    int64_t mLastDurationUs;
+};
+
+// 直播流(不能seek的网络流)读取失败的时候才需要重连,本地文件和点播文件读到结尾就是正常结束
+bool IsLiveInput(AVFormatContext* formatContext);
+
+// 本地文件没有重连的意义
+bool IsNetworkUrl(const std::string& url);
+
+#endif
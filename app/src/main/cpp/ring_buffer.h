@@ -0,0 +1,99 @@
+#ifndef __RING_BUFFER_H__
+#define __RING_BUFFER_H__
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// 字节环形缓冲区,用于在音频解码线程和音频输出线程之间传递PCM数据
+// Write在空间不够的时候会阻塞,让解码线程不会无限制地往前解码
+// Read不会阻塞,因为它是在音频设备的回调里面调用的,数据不够的时候读到多少算多少
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity)
+            : mBuffer(capacity),
+              mReadPos(0),
+              mSize(0),
+              mAborted(false) {
+    }
+
+    // 写入全部数据,空间不够的时候等待消费者读取,被Abort的时候返回false
+    bool Write(const uint8_t *data, size_t size) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (size > 0) {
+            mNotFull.wait(lock, [this] { return mSize < mBuffer.size() || mAborted; });
+            if (mAborted) {
+                return false;
+            }
+
+            size_t writePos = (mReadPos + mSize) % mBuffer.size();
+            size_t count = mBuffer.size() - mSize;
+            if (count > mBuffer.size() - writePos) {
+                count = mBuffer.size() - writePos;
+            }
+            if (count > size) {
+                count = size;
+            }
+            memcpy(mBuffer.data() + writePos, data, count);
+            mSize += count;
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    // 读取最多size个字节,返回实际读取的字节数
+    size_t Read(uint8_t *data, size_t size) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t total = 0;
+        while (total < size && mSize > 0) {
+            size_t count = mBuffer.size() - mReadPos;
+            if (count > mSize) {
+                count = mSize;
+            }
+            if (count > size - total) {
+                count = size - total;
+            }
+            memcpy(data + total, mBuffer.data() + mReadPos, count);
+            mReadPos = (mReadPos + count) % mBuffer.size();
+            mSize -= count;
+            total += count;
+        }
+        mNotFull.notify_all();
+        return total;
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReadPos = 0;
+        mSize = 0;
+        mNotFull.notify_all();
+    }
+
+    void Abort() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mAborted = true;
+        mNotFull.notify_all();
+    }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSize;
+    }
+
+    size_t Capacity() {
+        return mBuffer.size();
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mNotFull;
+    std::vector<uint8_t> mBuffer;
+    size_t mReadPos;
+    size_t mSize;
+    bool mAborted;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "rtmp_relay.h"
+
+#include <iostream>
+
+using namespace std;
+
+RtmpRelay::RtmpRelay(int port, int players, const string& path)
+        : mPort(port),
+          mPlayers(players),
+          mPath(path),
+          mPublishing(false) {
+}
+
+RtmpRelay::~RtmpRelay() {
+    Stop();
+}
+
+bool RtmpRelay::Start() {
+    // 播放端口都是输出,每次播放端断开之后PushOutput重连的时候会重新监听
+    AVDictionary* options = NULL;
+    av_dict_set(&options, "listen", "1", 0);
+    for(int i = 0 ; i < mPlayers ; i++) {
+        mSender.AddOutput(GetPlayUrl(i), "flv", options);
+    }
+    av_dict_free(&options);
+
+    // 推流端口是输入,推流端断开之后VideoSender重连输入的时候也会重新监听
+    mSender.SetInputOption("listen", "1");
+    mSender.SetFastOpen(true);
+    mThread = thread(&RtmpRelay::relayLoop, this);
+    return true;
+}
+
+void RtmpRelay::relayLoop() {
+    // Open会一直阻塞到推流端连接上来并且发送了音视频的序列头
+    cout << "relay waiting for publisher on " << GetPublishUrl() << endl;
+    if(!mSender.Open(GetPublishUrl())) {
+        cout << "relay open " << GetPublishUrl() << " failed" << endl;
+        return;
+    }
+
+    // Run启动的时候各个播放端口才开始监听
+    mPublishing = true;
+    mSender.Run();
+    mPublishing = false;
+}
+
+void RtmpRelay::Stop() {
+    // 监听和读取都会检查中断回调,所以Stop可以让阻塞在Open或者Run里面的转发线程马上返回
+    mSender.Stop();
+    if(mThread.joinable()) {
+        mThread.join();
+    }
+    mSender.Close();
+    mPublishing = false;
+}
+
+string RtmpRelay::GetPublishUrl() {
+    return getUrl(mPort);
+}
+
+string RtmpRelay::GetPlayUrl(int index) {
+    return getUrl(mPort + 1 + index);
+}
+
+bool RtmpRelay::IsPublishing() {
+    return mPublishing;
+}
+
+vector<OutputStats> RtmpRelay::GetStats() {
+    return mSender.GetStats();
+}
+
+string RtmpRelay::getUrl(int port) {
+    return "rtmp://127.0.0.1:" + to_string(port) + "/" + mPath;
+}
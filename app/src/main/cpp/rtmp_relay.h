@@ -0,0 +1,49 @@
+#ifndef __RTMP_RELAY_H__
+#define __RTMP_RELAY_H__
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "video_sender.h"
+
+// 进程内的rtmp转发服务,代替外部的rtmp服务器做不依赖网络的端到端测试
+// 利用FFmpeg rtmp协议的listen模式(rtmp_server_handshake),一个监听端口只能接受一个连接,所以:
+//   推流地址: rtmp://127.0.0.1:<port>/<app>/<stream>,接受一个推流端
+//   播放地址: rtmp://127.0.0.1:<port + 1 + i>/<app>/<stream>,每个端口服务一个播放端
+// 转发本身就是一个VideoSender: 输入是推流端口,输出是各个播放端口
+// 播放端断开之后对应的端口会重新监听,新的播放端连上来之后先收到GOP缓存,马上就能出画面
+class RtmpRelay {
+public:
+    RtmpRelay(int port, int players, const std::string& path = "live/livestream");
+    ~RtmpRelay();
+
+    // 在后台线程等待推流端连接并开始转发
+    bool Start();
+
+    void Stop();
+
+    std::string GetPublishUrl();
+
+    std::string GetPlayUrl(int index);
+
+    // 推流端是否已经连接上,并且播放端口开始监听了
+    bool IsPublishing();
+
+    std::vector<OutputStats> GetStats();
+
+private:
+    int mPort;
+    int mPlayers;
+    std::string mPath;
+    VideoSender mSender;
+    std::thread mThread;
+    std::atomic<bool> mPublishing;
+
+    std::string getUrl(int port);
+
+    void relayLoop();
+};
+
+#endif
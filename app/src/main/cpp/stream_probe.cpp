@@ -0,0 +1,263 @@
+#include "stream_probe.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// 快速打开的时候格式探测和avformat_find_stream_info最多读取的字节数和时长
+static const char* FAST_PROBE_SIZE = "32768";
+static const char* FAST_ANALYZE_DURATION = "500000";
+
+// 最多缓存多少个url的流参数
+static const size_t MAX_CACHED_URLS = 32;
+
+// 缓存的一个轨道的参数
+struct CachedStream {
+    AVCodecParameters* codecpar;
+    AVRational frameRate;
+};
+
+// 所有StreamProbe共享的缓存,解复用线程和推流线程都可能访问,需要加锁
+static mutex sCacheMutex;
+static map<string, vector<CachedStream>> sCache;
+
+static void freeCachedStreams(vector<CachedStream>& streams) {
+    for(CachedStream& stream : streams) {
+        avcodec_parameters_free(&stream.codecpar);
+    }
+    streams.clear();
+}
+
+// 判断解码需要的参数是否都有了,只关心音视频轨道
+static bool isStreamComplete(const AVCodecParameters* codecpar) {
+    if(AVMEDIA_TYPE_VIDEO == codecpar->codec_type) {
+        return AV_CODEC_ID_NONE != codecpar->codec_id
+               && codecpar->width > 0
+               && codecpar->height > 0
+               && codecpar->format >= 0;
+    }
+    if(AVMEDIA_TYPE_AUDIO == codecpar->codec_type) {
+        return AV_CODEC_ID_NONE != codecpar->codec_id
+               && codecpar->sample_rate > 0
+               && codecpar->channels > 0;
+    }
+    return true;
+}
+
+static bool isComplete(AVFormatContext* formatContext) {
+    // FLV这种没有文件头的格式,要读到数据包才会创建轨道,AVFMTCTX_NOHEADER去掉之后才代表轨道都创建出来了
+    if((formatContext->ctx_flags & AVFMTCTX_NOHEADER) || 0 == formatContext->nb_streams) {
+        return false;
+    }
+    for(unsigned int i = 0 ; i < formatContext->nb_streams ; i++) {
+        if(!isStreamComplete(formatContext->streams[i]->codecpar)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 用解析器从视频包的SPS里面解析出宽高和像素格式,只解析码流不解码,耗时可以忽略
+// 返回是否尝试过解析
+static bool parseVideoParams(AVFormatContext* formatContext, const AVPacket* packet) {
+    AVCodecParameters* codecpar = formatContext->streams[packet->stream_index]->codecpar;
+    if(AVMEDIA_TYPE_VIDEO != codecpar->codec_type || isStreamComplete(codecpar)) {
+        return false;
+    }
+
+    AVCodecParserContext* parser = av_parser_init(codecpar->codec_id);
+    AVCodecContext* context = avcodec_alloc_context3(NULL);
+
+    // 解析器需要从extradata里面读取avcC格式的SPS/PPS
+    if(NULL != parser && NULL != context && avcodec_parameters_to_context(context, codecpar) >= 0) {
+        // 解复用出来的数据包都是完整的一帧,不需要解析器再去查找帧边界
+        parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+
+        uint8_t* data = NULL;
+        int size = 0;
+        av_parser_parse2(parser, context, &data, &size, packet->data, packet->size, packet->pts, packet->dts, packet->pos);
+        if(parser->width > 0 && parser->height > 0) {
+            codecpar->width = parser->width;
+            codecpar->height = parser->height;
+        }
+        if(parser->format >= 0) {
+            codecpar->format = parser->format;
+        }
+    }
+
+    av_parser_close(parser);
+    avcodec_free_context(&context);
+    return true;
+}
+
+// 用同一个url上一次的参数补上缺少的参数,编码格式不一样的轨道不会使用
+static bool applyCache(AVFormatContext* formatContext, const string& url) {
+    lock_guard<mutex> lock(sCacheMutex);
+    map<string, vector<CachedStream>>::iterator it = sCache.find(url);
+    if(it == sCache.end()) {
+        return false;
+    }
+
+    bool applied = false;
+    for(unsigned int i = 0 ; i < formatContext->nb_streams ; i++) {
+        AVStream* stream = formatContext->streams[i];
+        AVCodecParameters* codecpar = stream->codecpar;
+        if(isStreamComplete(codecpar)) {
+            continue;
+        }
+
+        for(const CachedStream& cached : it->second) {
+            if(cached.codecpar->codec_type != codecpar->codec_type || cached.codecpar->codec_id != codecpar->codec_id) {
+                continue;
+            }
+
+            // 只补缺少的参数,从码流里面读到的参数优先
+            if(AVMEDIA_TYPE_VIDEO == codecpar->codec_type) {
+                if(codecpar->width <= 0 || codecpar->height <= 0) {
+                    codecpar->width = cached.codecpar->width;
+                    codecpar->height = cached.codecpar->height;
+                }
+                if(codecpar->format < 0) {
+                    codecpar->format = cached.codecpar->format;
+                }
+                if(stream->avg_frame_rate.num <= 0) {
+                    stream->avg_frame_rate = cached.frameRate;
+                }
+            } else {
+                if(codecpar->sample_rate <= 0) {
+                    codecpar->sample_rate = cached.codecpar->sample_rate;
+                }
+                if(codecpar->channels <= 0) {
+                    codecpar->channels = cached.codecpar->channels;
+                    codecpar->channel_layout = cached.codecpar->channel_layout;
+                }
+            }
+            applied = true;
+            break;
+        }
+    }
+    return applied;
+}
+
+StreamProbe::StreamProbe() : mSkipped(false), mCached(false), mProbePackets(0) {
+}
+
+StreamProbe::~StreamProbe() {
+    Clear();
+}
+
+void StreamProbe::SetFastOpenOptions(AVDictionary** options) {
+    av_dict_set(options, "probesize", FAST_PROBE_SIZE, 0);
+    av_dict_set(options, "analyzeduration", FAST_ANALYZE_DURATION, 0);
+}
+
+int StreamProbe::Probe(AVFormatContext* formatContext, const string& url) {
+    Clear();
+    mSkipped = false;
+    mCached = false;
+    mProbePackets = 0;
+
+    // 带文件头的格式打开之后轨道就已经创建好了,一般只差视频的像素格式,读到第一个视频包就够了
+    // FLV要读到音视频的第一个数据包才会创建轨道,这个时候序列头已经被解复用器读取并设置成extradata
+    bool parsed = false;
+    while(!isComplete(formatContext) && mProbePackets < MAX_PROBE_PACKETS) {
+        // 轨道都已经创建出来,视频包也解析过了还是缺少参数的话(比如没有对应的解析器),再往下读也没有用
+        if(parsed && !(formatContext->ctx_flags & AVFMTCTX_NOHEADER)) {
+            break;
+        }
+
+        AVPacket* packet = av_packet_alloc();
+        if(NULL == packet) {
+            break;
+        }
+        if(av_read_frame(formatContext, packet) < 0) {
+            av_packet_free(&packet);
+            break;
+        }
+        if(parseVideoParams(formatContext, packet)) {
+            parsed = true;
+        }
+        mPending.push_back(packet);
+        mProbePackets++;
+    }
+
+    if(!isComplete(formatContext)) {
+        mCached = applyCache(formatContext, url);
+    }
+
+    if(isComplete(formatContext)) {
+        mSkipped = true;
+        return 0;
+    }
+
+    // 还是缺少参数的话只能交给avformat_find_stream_info,已经读出来的数据包仍然会最先从ReadFrame返回
+    return avformat_find_stream_info(formatContext, NULL);
+}
+
+int StreamProbe::ReadFrame(AVFormatContext* formatContext, AVPacket* packet) {
+    if(mPending.empty()) {
+        return av_read_frame(formatContext, packet);
+    }
+
+    AVPacket* pending = mPending.front();
+    mPending.pop_front();
+    av_packet_move_ref(packet, pending);
+    av_packet_free(&pending);
+    return 0;
+}
+
+void StreamProbe::SaveStreamInfo(const string& url, AVFormatContext* formatContext) {
+    vector<CachedStream> streams;
+    for(unsigned int i = 0 ; i < formatContext->nb_streams ; i++) {
+        AVStream* stream = formatContext->streams[i];
+        AVMediaType type = stream->codecpar->codec_type;
+        if((AVMEDIA_TYPE_VIDEO != type && AVMEDIA_TYPE_AUDIO != type) || !isStreamComplete(stream->codecpar)) {
+            continue;
+        }
+
+        CachedStream cached = {avcodec_parameters_alloc(), stream->avg_frame_rate};
+        if(NULL == cached.codecpar || avcodec_parameters_copy(cached.codecpar, stream->codecpar) < 0) {
+            avcodec_parameters_free(&cached.codecpar);
+            continue;
+        }
+        streams.push_back(cached);
+    }
+
+    lock_guard<mutex> lock(sCacheMutex);
+    map<string, vector<CachedStream>>::iterator it = sCache.find(url);
+    if(it != sCache.end()) {
+        freeCachedStreams(it->second);
+        sCache.erase(it);
+    }
+    if(streams.empty()) {
+        return;
+    }
+
+    // 缓存满了随便淘汰一个,这只是个加速打开的缓存,丢了也只是退回到正常的探测
+    if(sCache.size() >= MAX_CACHED_URLS) {
+        freeCachedStreams(sCache.begin()->second);
+        sCache.erase(sCache.begin());
+    }
+    sCache[url] = streams;
+}
+
+void StreamProbe::Clear() {
+    for(AVPacket* packet : mPending) {
+        av_packet_free(&packet);
+    }
+    mPending.clear();
+}
+
+bool StreamProbe::IsSkipped() {
+    return mSkipped;
+}
+
+bool StreamProbe::IsCached() {
+    return mCached;
+}
+
+int StreamProbe::GetProbePackets() {
+    return mProbePackets;
+}
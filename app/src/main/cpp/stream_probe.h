@@ -0,0 +1,56 @@
+#ifndef __STREAM_PROBE_H__
+#define __STREAM_PROBE_H__
+
+#include <deque>
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 直播流的快速探测,用来代替avformat_find_stream_info
+// avformat_find_stream_info默认最多会读5MB或者5秒的数据,还要把前几帧解码出来才能确定宽高和像素格式,rtmp直播要好几秒才能看到画面
+// 实际上FLV的metadata和音视频序列头已经带上了解码需要的参数,只差视频的宽高和像素格式
+// 这些可以用AVCodecParser从第一个视频包的SPS里面解析出来,不需要解码,所以读到这几个包就可以跳过avformat_find_stream_info
+// 同一个url上一次打开得到的参数也会缓存下来,这一次解析不出来的参数可以从缓存里面补上
+// 探测过程中读出来的数据包会保存下来,之后通过ReadFrame最先返回,不会丢掉任何数据
+class StreamProbe {
+public:
+    StreamProbe();
+    ~StreamProbe();
+
+    // 在avformat_open_input之前调用,限制格式探测和avformat_find_stream_info读取的数据量
+    static void SetFastOpenOptions(AVDictionary** options);
+
+    // 返回值和avformat_find_stream_info一样,失败的时候小于0
+    int Probe(AVFormatContext* formatContext, const std::string& url);
+
+    // 先返回探测的时候读出来的数据包,取完之后再调用av_read_frame
+    int ReadFrame(AVFormatContext* formatContext, AVPacket* packet);
+
+    // 打开成功之后保存流参数,下一次快速打开同一个url的时候使用
+    static void SaveStreamInfo(const std::string& url, AVFormatContext* formatContext);
+
+    // 释放还没有读取的数据包,重连之前需要调用
+    void Clear();
+
+    // 上一次Probe是否跳过了avformat_find_stream_info
+    bool IsSkipped();
+
+    // 上一次Probe是否用到了缓存的流参数
+    bool IsCached();
+
+    // 上一次Probe读取的数据包数量
+    int GetProbePackets();
+
+private:
+    // 最多读取这么多个数据包,还探测不出来就交给avformat_find_stream_info
+    static const int MAX_PROBE_PACKETS = 64;
+
+    std::deque<AVPacket*> mPending;
+    bool mSkipped;
+    bool mCached;
+    int mProbePackets;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "surface_texture_helper.h"
+#include "common.h"
+
+SurfaceTextureHelper::SurfaceTextureHelper()
+        : mSurfaceTexture(NULL),
+          mSurface(NULL),
+          mUpdateTexImage(NULL),
+          mGetTransformMatrix(NULL),
+          mMatrix(NULL) {
+}
+
+bool SurfaceTextureHelper::Init(JNIEnv *env, int oesTexture) {
+    // new SurfaceTexture(oesTexture)
+    jclass surfaceTextureClass = env->FindClass("android/graphics/SurfaceTexture");
+    jmethodID surfaceTextureInit = env->GetMethodID(surfaceTextureClass, "<init>", "(I)V");
+    jobject surfaceTexture = env->NewObject(surfaceTextureClass, surfaceTextureInit, oesTexture);
+    if (env->ExceptionCheck() || NULL == surfaceTexture) {
+        env->ExceptionClear();
+        LOGD("create SurfaceTexture failed");
+        return false;
+    }
+    mUpdateTexImage = env->GetMethodID(surfaceTextureClass, "updateTexImage", "()V");
+    mGetTransformMatrix = env->GetMethodID(surfaceTextureClass, "getTransformMatrix", "([F)V");
+
+    // new Surface(surfaceTexture)
+    jclass surfaceClass = env->FindClass("android/view/Surface");
+    jmethodID surfaceInit = env->GetMethodID(surfaceClass, "<init>", "(Landroid/graphics/SurfaceTexture;)V");
+    jobject surface = env->NewObject(surfaceClass, surfaceInit, surfaceTexture);
+    if (env->ExceptionCheck() || NULL == surface) {
+        env->ExceptionClear();
+        LOGD("create Surface failed");
+        env->DeleteLocalRef(surfaceTexture);
+        return false;
+    }
+
+    // MediaCodec会在解码线程里面使用Surface,所以需要转成全局引用
+    mSurfaceTexture = env->NewGlobalRef(surfaceTexture);
+    mSurface = env->NewGlobalRef(surface);
+
+    // 变换矩阵每帧都要读取,提前创建好数组避免每帧分配
+    jfloatArray matrix = env->NewFloatArray(16);
+    mMatrix = (jfloatArray) env->NewGlobalRef(matrix);
+
+    env->DeleteLocalRef(matrix);
+    env->DeleteLocalRef(surface);
+    env->DeleteLocalRef(surfaceTexture);
+    env->DeleteLocalRef(surfaceClass);
+    env->DeleteLocalRef(surfaceTextureClass);
+    return true;
+}
+
+void SurfaceTextureHelper::Destroy(JNIEnv *env) {
+    if (NULL != mSurface) {
+        jclass surfaceClass = env->FindClass("android/view/Surface");
+        env->CallVoidMethod(mSurface, env->GetMethodID(surfaceClass, "release", "()V"));
+        env->DeleteLocalRef(surfaceClass);
+        env->DeleteGlobalRef(mSurface);
+        mSurface = NULL;
+    }
+
+    if (NULL != mSurfaceTexture) {
+        jclass surfaceTextureClass = env->FindClass("android/graphics/SurfaceTexture");
+        env->CallVoidMethod(mSurfaceTexture, env->GetMethodID(surfaceTextureClass, "release", "()V"));
+        env->DeleteLocalRef(surfaceTextureClass);
+        env->DeleteGlobalRef(mSurfaceTexture);
+        mSurfaceTexture = NULL;
+    }
+
+    if (NULL != mMatrix) {
+        env->DeleteGlobalRef(mMatrix);
+        mMatrix = NULL;
+    }
+}
+
+jobject SurfaceTextureHelper::GetSurface() {
+    return mSurface;
+}
+
+void SurfaceTextureHelper::UpdateTexImage(JNIEnv *env) {
+    env->CallVoidMethod(mSurfaceTexture, mUpdateTexImage);
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGD("updateTexImage failed");
+    }
+}
+
+void SurfaceTextureHelper::GetTransformMatrix(JNIEnv *env, float matrix[16]) {
+    env->CallVoidMethod(mSurfaceTexture, mGetTransformMatrix, mMatrix);
+    env->GetFloatArrayRegion(mMatrix, 0, 16, matrix);
+}
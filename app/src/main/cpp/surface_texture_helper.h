@@ -0,0 +1,30 @@
+#ifndef __SURFACE_TEXTURE_HELPER_H__
+#define __SURFACE_TEXTURE_HELPER_H__
+
+#include <jni.h>
+
+// 通过JNI创建和操作java层的SurfaceTexture
+// MediaCodec把画面输出到GetSurface返回的Surface上,渲染线程调用UpdateTexImage之后画面就会出现在OES纹理里
+// 除了Init,其他方法都需要在创建OES纹理的那个EGL上下文所在的线程调用
+class SurfaceTextureHelper {
+public:
+    SurfaceTextureHelper();
+
+    bool Init(JNIEnv *env, int oesTexture);
+    void Destroy(JNIEnv *env);
+
+    // 返回android.view.Surface对象,用于传给AVMediaCodecContext
+    jobject GetSurface();
+
+    void UpdateTexImage(JNIEnv *env);
+    void GetTransformMatrix(JNIEnv *env, float matrix[16]);
+
+private:
+    jobject mSurfaceTexture;
+    jobject mSurface;
+    jmethodID mUpdateTexImage;
+    jmethodID mGetTransformMatrix;
+    jfloatArray mMatrix;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <string.h>
+#include <GLES3/gl3.h>
+#include "texture_stream.h"
+#include "common.h"
+
+TextureStream::TextureStream()
+        : mFormat(GL_LUMINANCE),
+          mBytesPerPixel(1),
+          mUsePbo(false),
+          mIndex(0),
+          mWidth(0),
+          mHeight(0) {
+    for (int i = 0; i < RING_SIZE; ++i) {
+        mTextures[i] = 0;
+        mPbos[i] = 0;
+    }
+}
+
+void TextureStream::Init(GLenum format, int bytesPerPixel, bool usePbo) {
+    release();
+    mFormat = format;
+    mBytesPerPixel = bytesPerPixel;
+    mUsePbo = usePbo;
+}
+
+bool TextureStream::Upload(const uint8_t *data, int lineSize, int height) {
+    int width = lineSize / mBytesPerPixel;
+    if (width != mWidth || height != mHeight) {
+        if (!allocate(width, height)) {
+            return false;
+        }
+    }
+
+    // 写入环形队列里面的下一个纹理,上一帧使用的纹理可能还在被gpu读取
+    int index = (mIndex + 1) % RING_SIZE;
+    glBindTexture(GL_TEXTURE_2D, mTextures[index]);
+
+    if (mUsePbo) {
+        GLsizeiptr size = (GLsizeiptr) lineSize * height;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPbos[index]);
+
+        // GL_MAP_INVALIDATE_BUFFER_BIT告诉驱动不需要保留旧数据,
+        // 如果gpu还在从这个PBO读取,驱动会分配一块新的内存给我们,而不是等待gpu读取完成
+        void *buffer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (NULL != buffer) {
+            memcpy(buffer, data, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // 绑定了PBO之后最后一个参数是PBO里的偏移,数据由gpu异步从PBO拷贝到纹理
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, mFormat, GL_UNSIGNED_BYTE, 0);
+        } else {
+            LOGD("glMapBufferRange failed");
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, mFormat, GL_UNSIGNED_BYTE, data);
+    }
+
+    mIndex = index;
+    return true;
+}
+
+void TextureStream::Bind(int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, mTextures[mIndex]);
+}
+
+void TextureStream::Destroy() {
+    release();
+}
+
+bool TextureStream::allocate(int width, int height) {
+    release();
+
+    glGenTextures(RING_SIZE, mTextures);
+    for (int i = 0; i < RING_SIZE; ++i) {
+        if (0 == mTextures[i]) {
+            LOGD("glGenTextures failed");
+            release();
+            return false;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, mTextures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, mFormat, width, height, 0, mFormat, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    if (mUsePbo) {
+        // GL_STREAM_DRAW表示数据每次写入之后只会被使用一次
+        glGenBuffers(RING_SIZE, mPbos);
+        for (int i = 0; i < RING_SIZE; ++i) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPbos[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) width * height * mBytesPerPixel, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mIndex = 0;
+    return true;
+}
+
+void TextureStream::release() {
+    for (int i = 0; i < RING_SIZE; ++i) {
+        if (0 != mTextures[i]) {
+            glDeleteTextures(1, mTextures + i);
+            mTextures[i] = 0;
+        }
+        if (0 != mPbos[i]) {
+            glDeleteBuffers(1, mPbos + i);
+            mPbos[i] = 0;
+        }
+    }
+    mWidth = 0;
+    mHeight = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef __TEXTURE_STREAM_H__
+#define __TEXTURE_STREAM_H__
+
+#include <stdint.h>
+#include <GLES2/gl2.h>
+
+// 负责把一个平面(例如YUV420P的Y分量)的数据逐帧上传到纹理
+// 直接对正在被绘制的纹理调用glTexSubImage2D,驱动需要等上一帧的绘制用完这个纹理才能修改它,会让cpu等待gpu
+// 所以这里用一个环形队列轮流使用多个纹理,每一帧都写入上一帧没有在用的纹理:
+//   OpenGL ES 3.0以上: 每个纹理配一个PBO,cpu只需要把数据拷贝到映射出来的PBO内存里,
+//                      真正传输到纹理的工作由gpu异步完成,glTexSubImage2D会立即返回
+//   OpenGL ES 2.0:     不支持PBO,只能直接glTexSubImage2D,但是轮流写入不同的纹理仍然可以避免等待
+class TextureStream {
+public:
+    TextureStream();
+
+    // format是纹理格式(例如GL_LUMINANCE),bytesPerPixel是一个像素在内存里占用的字节数
+    // usePbo需要当前上下文是OpenGL ES 3.0以上
+    void Init(GLenum format, int bytesPerPixel, bool usePbo);
+
+    // 上传一帧数据,lineSize是一行的字节数,纹理的宽度就是lineSize / bytesPerPixel
+    // 尺寸变化的时候会重新创建纹理
+    bool Upload(const uint8_t *data, int lineSize, int height);
+
+    // 把最近一次上传的纹理绑定到指定的纹理单元上
+    void Bind(int unit);
+
+    void Destroy();
+
+private:
+    // 三个纹理轮流使用: 一个正在被gpu绘制,一个可能还在队列里等待绘制,一个用于写入新数据
+    static const int RING_SIZE = 3;
+
+    GLenum mFormat;
+    int mBytesPerPixel;
+    bool mUsePbo;
+
+    GLuint mTextures[RING_SIZE];
+    GLuint mPbos[RING_SIZE];
+    int mIndex;
+    int mWidth;
+    int mHeight;
+
+    bool allocate(int width, int height);
+
+    void release();
+};
+
+#endif
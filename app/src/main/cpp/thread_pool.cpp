@@ -0,0 +1,36 @@
+#include "thread_pool.h"
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+using namespace std;
+
+ThreadPool::ThreadPool(int threadCount) : mTasks(MAX_PENDING_TASKS) {
+    if(threadCount <= 0) {
+        threadCount = av_cpu_count();
+    }
+    for(int i = 0 ; i < threadCount ; i++) {
+        mThreads.push_back(thread(&ThreadPool::workLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    // Close之后工作线程会把剩下的任务执行完,Pop返回false的时候退出
+    mTasks.Close();
+    for(thread& t : mThreads) {
+        t.join();
+    }
+}
+
+int ThreadPool::GetThreadCount() {
+    return (int) mThreads.size();
+}
+
+void ThreadPool::workLoop() {
+    function<void()> task;
+    while(mTasks.Pop(task)) {
+        task();
+        task = nullptr;
+    }
+}
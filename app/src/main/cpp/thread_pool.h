@@ -0,0 +1,47 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "blocking_queue.h"
+
+// 固定线程数的线程池,任务按照提交的顺序执行
+// 任务队列用的是BlockingQueue,排队的任务太多的时候Submit会阻塞,不会无限堆积
+// 析构的时候会等排队的任务都执行完再退出,所以不要在任务里面等待同一个线程池里面的其他任务,线程都被占满的时候会死锁
+class ThreadPool {
+public:
+    // threadCount为0代表按照cpu核数创建
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    // 提交一个任务,通过返回的future获取结果,任务抛出的异常也会在future.get的时候重新抛出
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> Submit(F task) {
+        typedef typename std::result_of<F()>::type Result;
+
+        // std::function要求可以拷贝,packaged_task只能移动,所以用shared_ptr包一层
+        std::shared_ptr<std::packaged_task<Result()>> packaged = std::make_shared<std::packaged_task<Result()>>(task);
+        std::future<Result> future = packaged->get_future();
+        if(!mTasks.Push([packaged] { (*packaged)(); })) {
+            // 线程池已经关闭,直接在当前线程执行,保证future一定有结果
+            (*packaged)();
+        }
+        return future;
+    }
+
+    int GetThreadCount();
+
+private:
+    static const size_t MAX_PENDING_TASKS = 256;
+
+    BlockingQueue<std::function<void()>> mTasks;
+    std::vector<std::thread> mThreads;
+
+    void workLoop();
+};
+
+#endif
@@ -0,0 +1,390 @@
+#include "thumbnail_extractor.h"
+#include "reconnect.h"
+
+#include <future>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+using namespace std;
+
+// 一个位置最多往后读多少个视频包去找关键帧,避免坏文件或者seek不准的时候一直读到文件末尾
+static const int MAX_PACKETS_PER_THUMBNAIL = 600;
+
+// 每一段至少几个位置,位置太少的话打开文件的耗时比提取还多,不值得再拆分
+static const int MIN_TARGETS_PER_TASK = 2;
+
+// 一段位置的提取上下文,解复用器、解码器、SwsContext和jpeg编码器在这一段里面复用
+class ThumbnailContext {
+public:
+    ThumbnailContext()
+            : mFormatContext(NULL),
+              mCodecContext(NULL),
+              mSwsContext(NULL),
+              mEncoder(NULL),
+              mFrame(NULL),
+              mScaled(NULL),
+              mPacket(NULL),
+              mStreamIndex(-1),
+              mWidth(0),
+              mHeight(0),
+              mReadPackets(0),
+              mDecodedFrames(0),
+              mSeeks(0) {
+    }
+
+    ~ThumbnailContext() {
+        av_packet_free(&mPacket);
+        av_frame_free(&mFrame);
+        av_frame_free(&mScaled);
+        avcodec_free_context(&mEncoder);
+        avcodec_free_context(&mCodecContext);
+        sws_freeContext(mSwsContext);
+        avformat_close_input(&mFormatContext);
+    }
+
+    bool Open(const string& url, const ThumbnailConfig& config) {
+        mConfig = config;
+
+        // 网络协议会忽略mmap参数
+        AVDictionary* options = NULL;
+        if(config.useMmap) {
+            av_dict_set(&options, "mmap", "1", 0);
+        }
+        int ret = avformat_open_input(&mFormatContext, url.c_str(), NULL, &options);
+        av_dict_free(&options);
+        if(ret < 0 || avformat_find_stream_info(mFormatContext, NULL) < 0) {
+            cout << "thumbnail: can't open " << url << endl;
+            return false;
+        }
+
+        AVCodec* codec = NULL;
+        mStreamIndex = av_find_best_stream(mFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+        if(mStreamIndex < 0 || NULL == codec) {
+            cout << "thumbnail: no video stream in " << url << endl;
+            return false;
+        }
+
+        // 多个位置已经在线程池里面并行了,每个解码器只用一个线程,而且只解关键帧
+        AVStream* stream = mFormatContext->streams[mStreamIndex];
+        mCodecContext = avcodec_alloc_context3(codec);
+        if(NULL == mCodecContext || avcodec_parameters_to_context(mCodecContext, stream->codecpar) < 0) {
+            return false;
+        }
+        mCodecContext->thread_count = 1;
+        mCodecContext->skip_frame = AVDISCARD_NONKEY;
+        if(avcodec_open2(mCodecContext, codec, NULL) < 0) {
+            cout << "thumbnail: can't open decoder" << endl;
+            return false;
+        }
+
+        // 其他轨道的包解复用器直接丢掉,不用再返回给我们
+        for(unsigned int i = 0 ; i < mFormatContext->nb_streams ; i++) {
+            if((int) i != mStreamIndex) {
+                mFormatContext->streams[i]->discard = AVDISCARD_ALL;
+            }
+        }
+
+        mFrame = av_frame_alloc();
+        mPacket = av_packet_alloc();
+        if(NULL == mFrame || NULL == mPacket) {
+            return false;
+        }
+        calculateSize(stream->codecpar->width, stream->codecpar->height);
+        return mWidth > 0 && mHeight > 0 && (THUMBNAIL_JPEG != mConfig.format || openEncoder());
+    }
+
+    // targetUs是AV_NOPTS_VALUE的时候不seek,直接取当前位置之后的第一个关键帧
+    Thumbnail Extract(int64_t targetUs) {
+        Thumbnail thumbnail;
+        thumbnail.targetUs = targetUs;
+        thumbnail.ptsUs = AV_NOPTS_VALUE;
+        thumbnail.width = mWidth;
+        thumbnail.height = mHeight;
+
+        if(AV_NOPTS_VALUE != targetUs && !seek(targetUs)) {
+            return thumbnail;
+        }
+
+        AVStream* stream = mFormatContext->streams[mStreamIndex];
+        for(int i = 0 ; i < MAX_PACKETS_PER_THUMBNAIL ; i++) {
+            if(av_read_frame(mFormatContext, mPacket) < 0) {
+                break;
+            }
+            if(mPacket->stream_index != mStreamIndex || !(mPacket->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(mPacket);
+                continue;
+            }
+            mReadPackets++;
+
+            bool decoded = decodeKeyFrame();
+            av_packet_unref(mPacket);
+            if(!decoded) {
+                continue;
+            }
+
+            int64_t pts = mFrame->best_effort_timestamp;
+            thumbnail.ptsUs = AV_NOPTS_VALUE == pts ? AV_NOPTS_VALUE : av_rescale_q(pts, stream->time_base, AV_TIME_BASE_Q);
+            bool converted = THUMBNAIL_JPEG == mConfig.format ? encodeJpeg(thumbnail.data) : convertRgba(thumbnail.data);
+            av_frame_unref(mFrame);
+            if(!converted) {
+                thumbnail.data.clear();
+            }
+            break;
+        }
+        return thumbnail;
+    }
+
+    int64_t GetReadPackets() {
+        return mReadPackets;
+    }
+
+    int64_t GetDecodedFrames() {
+        return mDecodedFrames;
+    }
+
+    int64_t GetSeeks() {
+        return mSeeks;
+    }
+
+private:
+    ThumbnailConfig mConfig;
+    AVFormatContext* mFormatContext;
+    AVCodecContext* mCodecContext;
+    SwsContext* mSwsContext;
+    AVCodecContext* mEncoder;
+    AVFrame* mFrame;
+    AVFrame* mScaled;
+    AVPacket* mPacket;
+    int mStreamIndex;
+    int mWidth;
+    int mHeight;
+    int64_t mReadPackets;
+    int64_t mDecodedFrames;
+    int64_t mSeeks;
+
+    void calculateSize(int videoWidth, int videoHeight) {
+        mWidth = mConfig.width;
+        mHeight = mConfig.height;
+        if(videoWidth <= 0 || videoHeight <= 0) {
+            mWidth = 0;
+            mHeight = 0;
+            return;
+        }
+        if(mWidth <= 0 && mHeight <= 0) {
+            mWidth = videoWidth;
+            mHeight = videoHeight;
+        } else if(mHeight <= 0) {
+            mHeight = (int) av_rescale(mWidth, videoHeight, videoWidth);
+        } else if(mWidth <= 0) {
+            mWidth = (int) av_rescale(mHeight, videoWidth, videoHeight);
+        }
+
+        // jpeg用的是yuv420,宽高需要是偶数
+        mWidth = FFMAX(2, mWidth & ~1);
+        mHeight = FFMAX(2, mHeight & ~1);
+    }
+
+    bool openEncoder() {
+        AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        if(NULL == codec) {
+            cout << "thumbnail: mjpeg encoder is not enabled" << endl;
+            return false;
+        }
+        mEncoder = avcodec_alloc_context3(codec);
+        if(NULL == mEncoder) {
+            return false;
+        }
+        mEncoder->width = mWidth;
+        mEncoder->height = mHeight;
+        mEncoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        mEncoder->time_base = {1, 25};
+        mEncoder->thread_count = 1;
+
+        // 固定质量编码,每一张都用同样的qscale
+        mEncoder->flags |= AV_CODEC_FLAG_QSCALE;
+        mEncoder->global_quality = FF_QP2LAMBDA * mConfig.jpegQuality;
+        if(avcodec_open2(mEncoder, codec, NULL) < 0) {
+            cout << "thumbnail: can't open mjpeg encoder" << endl;
+            return false;
+        }
+
+        // 缩放的结果直接写到这个帧里面再编码,每一张都复用
+        mScaled = av_frame_alloc();
+        if(NULL == mScaled) {
+            return false;
+        }
+        mScaled->format = AV_PIX_FMT_YUVJ420P;
+        mScaled->width = mWidth;
+        mScaled->height = mHeight;
+        return av_frame_get_buffer(mScaled, 0) >= 0;
+    }
+
+    bool seek(int64_t targetUs) {
+        // 定位到目标时间之前最近的关键帧,找不到的话(比如目标在第一个关键帧之前)放宽成离目标最近的关键帧
+        AVStream* stream = mFormatContext->streams[mStreamIndex];
+        int64_t target = av_rescale_q(targetUs, AV_TIME_BASE_Q, stream->time_base);
+        if(AV_NOPTS_VALUE != stream->start_time) {
+            target += stream->start_time;
+        }
+        mSeeks++;
+        if(avformat_seek_file(mFormatContext, mStreamIndex, INT64_MIN, target, target, 0) < 0
+           && avformat_seek_file(mFormatContext, mStreamIndex, INT64_MIN, target, INT64_MAX, 0) < 0) {
+            cout << "thumbnail: seek to " << targetUs << "us failed" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // 送入关键帧之后马上排空,解码器有帧重排序延迟的时候也不需要再送后面的帧
+    // 排空之后要flush才能继续送下一个位置的包
+    bool decodeKeyFrame() {
+        mDecodedFrames++;
+        bool decoded = avcodec_send_packet(mCodecContext, mPacket) >= 0
+                       && avcodec_send_packet(mCodecContext, NULL) >= 0
+                       && avcodec_receive_frame(mCodecContext, mFrame) >= 0;
+        avcodec_flush_buffers(mCodecContext);
+        return decoded;
+    }
+
+    // sws_getCachedContext在参数不变的时候直接返回原来的SwsContext,只有视频中途改变了分辨率才会重新创建
+    bool updateSwsContext(AVPixelFormat format) {
+        mSwsContext = sws_getCachedContext(mSwsContext, mFrame->width, mFrame->height, (AVPixelFormat) mFrame->format,
+                                           mWidth, mHeight, format, SWS_BILINEAR, NULL, NULL, NULL);
+        return NULL != mSwsContext;
+    }
+
+    bool convertRgba(vector<uint8_t>& data) {
+        if(!updateSwsContext(AV_PIX_FMT_RGBA)) {
+            return false;
+        }
+        data.resize(mWidth * mHeight * 4);
+        uint8_t* dst[4] = {data.data(), NULL, NULL, NULL};
+        int dstLinesize[4] = {mWidth * 4, 0, 0, 0};
+        return sws_scale(mSwsContext, mFrame->data, mFrame->linesize, 0, mFrame->height, dst, dstLinesize) > 0;
+    }
+
+    bool encodeJpeg(vector<uint8_t>& data) {
+        // 编码器可能还引用着上一张的缓冲,需要确保可写
+        if(!updateSwsContext(AV_PIX_FMT_YUVJ420P) || av_frame_make_writable(mScaled) < 0) {
+            return false;
+        }
+        if(sws_scale(mSwsContext, mFrame->data, mFrame->linesize, 0, mFrame->height, mScaled->data, mScaled->linesize) <= 0) {
+            return false;
+        }
+
+        // mjpeg每一帧都是独立的jpeg,送一帧就能马上取出一个包
+        mScaled->pts = mDecodedFrames;
+        AVPacket* packet = av_packet_alloc();
+        bool encoded = NULL != packet
+                       && avcodec_send_frame(mEncoder, mScaled) >= 0
+                       && avcodec_receive_packet(mEncoder, packet) >= 0;
+        if(encoded) {
+            data.assign(packet->data, packet->data + packet->size);
+        }
+        av_packet_free(&packet);
+        return encoded;
+    }
+};
+
+ThumbnailExtractor::ThumbnailExtractor(int threadCount)
+        : mPool(threadCount),
+          mExtractions(0),
+          mThumbnails(0),
+          mSeeks(0),
+          mReadPackets(0),
+          mDecodedFrames(0) {
+}
+
+vector<Thumbnail> ThumbnailExtractor::Extract(const string& url, const ThumbnailConfig& config) {
+    mExtractions++;
+
+    // 不知道时长的话只能取第一个关键帧
+    vector<int64_t> targets;
+    int64_t duration = config.count > 1 ? probeDuration(url) : AV_NOPTS_VALUE;
+    if(AV_NOPTS_VALUE == duration || duration <= 0) {
+        targets.push_back(AV_NOPTS_VALUE);
+    } else {
+        // 取每一段的中间,避开片头的黑屏和文件末尾
+        for(int i = 0 ; i < config.count ; i++) {
+            targets.push_back(duration * (2 * i + 1) / (2 * config.count));
+        }
+    }
+
+    // 按时间顺序切成连续的几段,每一段在一个线程里面顺序seek,解复用器的缓存和索引可以复用
+    int tasks = FFMIN(mPool.GetThreadCount(), (int) targets.size() / MIN_TARGETS_PER_TASK);
+    tasks = FFMAX(1, tasks);
+    vector<future<vector<Thumbnail>>> futures;
+    for(int i = 0 ; i < tasks ; i++) {
+        size_t begin = targets.size() * i / tasks;
+        size_t end = targets.size() * (i + 1) / tasks;
+        vector<int64_t> range(targets.begin() + begin, targets.begin() + end);
+        futures.push_back(mPool.Submit([this, url, config, range] {
+            return extractRange(url, config, range);
+        }));
+    }
+
+    vector<Thumbnail> thumbnails;
+    for(future<vector<Thumbnail>>& f : futures) {
+        vector<Thumbnail> range = f.get();
+        for(Thumbnail& thumbnail : range) {
+            if(!thumbnail.data.empty()) {
+                mThumbnails++;
+            }
+            thumbnails.push_back(move(thumbnail));
+        }
+    }
+    return thumbnails;
+}
+
+vector<Thumbnail> ThumbnailExtractor::extractRange(const string& url, const ThumbnailConfig& config,
+                                                   const vector<int64_t>& targets) {
+    vector<Thumbnail> thumbnails;
+    ThumbnailContext context;
+    bool opened = context.Open(url, config);
+    for(int64_t target : targets) {
+        if(opened) {
+            thumbnails.push_back(context.Extract(target));
+        } else {
+            Thumbnail thumbnail;
+            thumbnail.targetUs = target;
+            thumbnail.ptsUs = AV_NOPTS_VALUE;
+            thumbnail.width = 0;
+            thumbnail.height = 0;
+            thumbnails.push_back(thumbnail);
+        }
+    }
+    mSeeks += context.GetSeeks();
+    mReadPackets += context.GetReadPackets();
+    mDecodedFrames += context.GetDecodedFrames();
+    return thumbnails;
+}
+
+int64_t ThumbnailExtractor::probeDuration(const string& url) {
+    AVFormatContext* formatContext = NULL;
+    if(avformat_open_input(&formatContext, url.c_str(), NULL, NULL) < 0) {
+        return AV_NOPTS_VALUE;
+    }
+
+    // FLV和MP4打开的时候就能从文件头里面读到时长,读不到的格式才需要探测
+    if(AV_NOPTS_VALUE == formatContext->duration) {
+        avformat_find_stream_info(formatContext, NULL);
+    }
+    int64_t duration = IsLiveInput(formatContext) ? AV_NOPTS_VALUE : formatContext->duration;
+    avformat_close_input(&formatContext);
+    return duration;
+}
+
+ThumbnailStats ThumbnailExtractor::GetStats() {
+    ThumbnailStats stats;
+    stats.extractions = mExtractions;
+    stats.thumbnails = mThumbnails;
+    stats.seeks = mSeeks;
+    stats.readPackets = mReadPackets;
+    stats.decodedFrames = mDecodedFrames;
+    return stats;
+}
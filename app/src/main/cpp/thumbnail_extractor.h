@@ -0,0 +1,99 @@
+#ifndef __THUMBNAIL_EXTRACTOR_H__
+#define __THUMBNAIL_EXTRACTOR_H__
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+enum ThumbnailFormat {
+    THUMBNAIL_RGBA,   // 每个像素4字节,一行正好是width * 4字节,可以直接用Bitmap.copyPixelsFromBuffer
+    THUMBNAIL_JPEG    // 用FFmpeg的mjpeg编码器压缩好的jpeg文件内容
+};
+
+struct ThumbnailConfig {
+    // 在整个视频里面均匀地取多少张,直播流或者不知道时长的流只能取第一个关键帧
+    int count;
+
+    // 缩略图的宽高,其中一个是0的话按照视频的宽高比计算,都是0的话保持视频原来的大小
+    int width;
+    int height;
+
+    ThumbnailFormat format;
+
+    // jpeg的质量,对应mjpeg编码器的qscale,2最好,31最差
+    int jpegQuality;
+
+    // 本地文件用mmap映射之后读取,不再每次都调用read,seek也只是移动位置
+    // 提取的过程中文件被截断的话进程会收到SIGBUS,可能被改写的文件要关掉
+    bool useMmap;
+
+    ThumbnailConfig()
+            : count(10),
+              width(160),
+              height(0),
+              format(THUMBNAIL_JPEG),
+              jpegQuality(5),
+              useMmap(true) {}
+};
+
+struct Thumbnail {
+    int64_t targetUs;            // 要取的位置,单位是微秒
+    int64_t ptsUs;               // 实际解出来的关键帧的位置,失败的时候是AV_NOPTS_VALUE
+    int width;
+    int height;
+    std::vector<uint8_t> data;   // RGBA像素或者jpeg文件内容,失败的时候为空
+};
+
+struct ThumbnailStats {
+    int64_t extractions;     // 调用Extract的次数
+    int64_t thumbnails;      // 成功取到的缩略图数量
+    int64_t seeks;           // seek的次数
+    int64_t readPackets;     // 读取的视频包数量
+    int64_t decodedFrames;   // 送进解码器的关键帧数量,正常情况下和缩略图的数量一样
+};
+
+// 缩略图提取
+// 原来是用VideoDecoder::NextFrame从头解码到指定位置,耗时和视频的时长成正比
+// 这里对每个位置:
+//   avformat_seek_file跳到这个位置之前最近的关键帧
+//   只把关键帧送进解码器,skip_frame设置成AVDISCARD_NONKEY,万一有标记错的非关键帧解码器也会直接丢掉
+//   送完关键帧马上排空解码器拿到画面,不用等后面的帧
+//   用复用的SwsContext缩放成小图,直接输出RGBA或者jpeg
+// 所以耗时只和缩略图的数量成正比
+// 多个位置会分成几段交给线程池并行提取,每一段有自己的解复用器、解码器和SwsContext,段内按时间顺序处理
+// 同一个ThumbnailExtractor可以在多个线程里面同时调用Extract,共用一个线程池
+class ThumbnailExtractor {
+public:
+    // threadCount为0代表按照cpu核数
+    explicit ThumbnailExtractor(int threadCount = 0);
+
+    // 阻塞直到所有缩略图都取完,返回的数组长度和实际取的位置数量一样,单张失败的话对应的data为空
+    // 不要在线程池的任务里面调用
+    std::vector<Thumbnail> Extract(const std::string& url, const ThumbnailConfig& config = ThumbnailConfig());
+
+    ThumbnailStats GetStats();
+
+private:
+    ThreadPool mPool;
+
+    std::atomic<int64_t> mExtractions;
+    std::atomic<int64_t> mThumbnails;
+    std::atomic<int64_t> mSeeks;
+    std::atomic<int64_t> mReadPackets;
+    std::atomic<int64_t> mDecodedFrames;
+
+    // 在一个线程里面按顺序提取一段位置的缩略图
+    std::vector<Thumbnail> extractRange(const std::string& url, const ThumbnailConfig& config,
+                                        const std::vector<int64_t>& targets);
+
+    // 打开输入,返回时长,直播流或者不知道时长返回AV_NOPTS_VALUE
+    static int64_t probeDuration(const std::string& url);
+};
+
+#endif
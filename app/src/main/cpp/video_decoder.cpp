@@ -3,6 +3,8 @@
 #include <iostream>
 
 extern "C" {
+#include <libavcodec/mediacodec.h>
+#include <libavutil/opt.h>
 #include <libavutil/time.h>
 }
 
@@ -14,28 +16,50 @@ VideoDecoder::VideoDecoder() :
         mPacket(NULL),
         mFrame(NULL),
         mVideoStreamIndex(-1),
+        mAudioStreamIndex(-1),
+        mVideoTimeBase({0, 1}),
+        mAudioTimeBase({0, 1}),
+        mInputVideoIndex(-1),
+        mInputAudioIndex(-1),
+        mReconnectAttempts(0),
+        mFastOpen(false),
+        mReadAheadSize(0),
+        mReadAhead(false),
+        mReadAheadFill(0),
+        mReadAheadStalls(0),
+        mReadAheadStallUs(0),
+        mPrevStalls(0),
+        mPrevStallUs(0),
+        mOpenStats({0, 0, false, false, false, 0}),
+        mWaitKeyFrame(false),
+        mAborted(false),
+        mReconnects(0),
+        mReadAudio(false),
         mVideoWidth(-1),
         mVideoHegiht(-1),
         mDecodecStart(-1),
-        mLastDecodecTime(-1),
-        mPixelFormat(AV_PIX_FMT_NONE) {
+        mFrameRate({0, 1}),
+        mNextPts(AV_NOPTS_VALUE),
+        mPixelFormat(AV_PIX_FMT_NONE),
+        mDecoderState(DECODER_RUNNING),
+        mFastMode(false),
+        mHardware(false),
+        mSeekable(false),
+        mSeekTarget(AV_NOPTS_VALUE),
+        mSeekStart(-1),
+        mSeekPending(false),
+        mLastSeekUs(0),
+        mSeekDiscardedFrames(0),
+        mSeekSkippedPackets(0) {
 }
 
-bool VideoDecoder::Load(const string& url) {
+bool VideoDecoder::Load(const string& url, const DecoderConfig& config) {
     mUrl = url;
-
-    // 打开文件流读取文件头解析出视频信息如轨道信息、时长等
-    // mFormatContext初始化为NULL,如果打开成功,它会被设置成非NULL的值
-    // 这个方法实际可以打开多种来源的数据,url可以是本地路径、rtmp地址等
-    // 在不需要的时候通过avformat_close_input关闭文件流
-    if(avformat_open_input(&mFormatContext, url.c_str(), NULL, NULL) < 0) {
-        cout << "open " << url << " failed" << endl;
-        return false;
-    }
-
-    // 对于没有文件头的格式如MPEG或者H264裸流等,可以通过这个函数解析前几帧得到视频的信息
-    if(avformat_find_stream_info(mFormatContext, NULL) < 0) {
-        cout << "can't find stream info in " << url << endl;
+    mReconnectAttempts = config.reconnectAttempts;
+    mFastOpen = config.fastOpen;
+    mReadAheadSize = config.readAheadSize;
+    mAborted = false;
+    if(!openInput(&mOpenStats)) {
         return false;
     }
 
@@ -52,10 +76,172 @@ bool VideoDecoder::Load(const string& url) {
         return false;
     }
 
+    // 查找和视频轨道关联的音频轨道,没有音频的话mAudioStreamIndex小于0
+    mAudioStreamIndex = av_find_best_stream(mFormatContext, AVMEDIA_TYPE_AUDIO, -1, mVideoStreamIndex, NULL, 0);
+
+    // 记录下第一次连接的轨道信息,解码线程和渲染线程只使用这些拷贝,不会访问重连时被替换掉的mFormatContext
+    mVideoTimeBase = mFormatContext->streams[mVideoStreamIndex]->time_base;
+    if(mAudioStreamIndex >= 0) {
+        mAudioTimeBase = mFormatContext->streams[mAudioStreamIndex]->time_base;
+    }
+    mInputVideoIndex = mVideoStreamIndex;
+    mInputAudioIndex = mAudioStreamIndex;
+    mRebaser.Reset();
+    updateDiscard();
+
+    // 猜测视频的帧率,用于在帧没有pts和时长的时候推算下一帧的pts
+    // 如果实在猜不出来就按30fps处理
+    mFrameRate = av_guess_frame_rate(mFormatContext, mFormatContext->streams[mVideoStreamIndex], NULL);
+    if(mFrameRate.num <= 0 || mFrameRate.den <= 0) {
+        mFrameRate = {30, 1};
+    }
+
     // 获取视频轨道的解码器相关参数
     AVCodecParameters* codecParam = mFormatContext->streams[mVideoStreamIndex]->codecpar;
     cout << "codec id = " << codecParam->codec_id << endl;
     
+    // 如果传入了Surface就优先尝试MediaCodec硬解,失败的话自动回退到软解
+    if(NULL != config.mediaCodecSurface && openMediaCodec(codecParam, config.mediaCodecSurface)) {
+        cout << "use h264_mediacodec" << endl;
+    } else if(!openSoftwareCodec(codecParam, config)) {
+        return false;
+    }
+
+    // 创建创建AVPacket接收数据包
+    // 无论是压缩的音频流还是压缩的视频流,都是由一个个数据包组成的
+    // 解码的过程实际就是从文件流中读取一个个数据包传给解码器去解码
+    // 对于视频，它通常应包含一个压缩帧
+    // 对于音频，它可能是一段压缩音频、包含多个压缩帧
+    // 在不需要的时候可以通过av_packet_free释放
+    mPacket = av_packet_alloc();
+    if(NULL == mPacket) {
+        cout << "can't alloc packet" << endl;
+        return false;
+    }
+
+    // 创建AVFrame接收解码器解码出来的原始数据(视频的画面帧或者音频的PCM裸流)
+    // 在不需要的时候可以通过av_frame_free释放
+    mFrame = av_frame_alloc();
+    if(NULL == mFrame) {
+        cout << "can't alloc frame" << endl;
+        return false;
+    }
+
+    // 可以从解码器上下文获取视频的尺寸
+    // 这个尺寸实际上是从AVCodecParameters里面复制过去的,所以直接用codecParam->width、codecParam->height也可以
+    mVideoWidth = mCodecContext->width;
+    mVideoHegiht =  mCodecContext->height;
+
+    // 可以从解码器上下文获取视频的像素格式
+    // 这个像素格式实际上是从AVCodecParameters里面复制过去的,所以直接用codecParam->format也可以
+    mPixelFormat = mCodecContext->pix_fmt;
+
+    // flv的keyframes元数据、mp4的stss在打开的时候就会被解复用器建成关键帧索引,seek的时候直接按照索引定位到文件位置
+    mSeekable = !IsLiveInput(mFormatContext);
+
+    // 记下这次探测到的参数,下次快速打开同一个url的时候可以直接使用
+    StreamProbe::SaveStreamInfo(mUrl, mFormatContext);
+    return true;
+}
+
+bool VideoDecoder::openInput(OpenStats* stats) {
+    // 打开文件流读取文件头解析出视频信息如轨道信息、时长等
+    // mFormatContext初始化为NULL,如果打开成功,它会被设置成非NULL的值
+    // 这个方法实际可以打开多种来源的数据,url可以是本地路径、rtmp地址等
+    // 在不需要的时候通过avformat_close_input关闭文件流
+    // 阻塞的网络操作会定期调用interruptCallback,Abort的时候可以让它们立即返回
+    mFormatContext = avformat_alloc_context();
+    if(NULL == mFormatContext) {
+        return false;
+    }
+    mFormatContext->interrupt_callback.callback = interruptCallback;
+    mFormatContext->interrupt_callback.opaque = this;
+
+    // 快速打开的时候限制探测的数据量,默认的probesize和analyzeduration对直播流来说太大了
+    AVDictionary* options = NULL;
+    if(mFastOpen) {
+        StreamProbe::SetFastOpenOptions(&options);
+    }
+
+    // 网络流套一层async协议,由它的I/O线程提前读socket
+    string url = mUrl;
+    mReadAhead = mReadAheadSize > 0 && IsNetworkUrl(mUrl);
+    if(mReadAhead) {
+        url = "async:" + mUrl;
+        av_dict_set_int(&options, "read_ahead_size", mReadAheadSize, 0);
+        av_dict_set_int(&options, "read_back_size", mReadAheadSize / 4, 0);
+    }
+
+    int64_t start = av_gettime_relative();
+    int ret = avformat_open_input(&mFormatContext, url.c_str(), NULL, &options);
+    av_dict_free(&options);
+    if(ret < 0) {
+        cout << "open " << mUrl << " failed" << endl;
+        return false;
+    }
+    int64_t opened = av_gettime_relative();
+
+    // 对于没有文件头的格式如MPEG或者H264裸流等,可以通过这个函数解析前几帧得到视频的信息
+    // 快速打开的时候先尝试从序列头和第一个视频包得到这些信息,不够的时候才会调用它
+    mProbe.Clear();
+    ret = mFastOpen ? mProbe.Probe(mFormatContext, mUrl) : avformat_find_stream_info(mFormatContext, NULL);
+    if(ret < 0) {
+        cout << "can't find stream info in " << mUrl << endl;
+        return false;
+    }
+
+    if(NULL != stats) {
+        stats->openUs = opened - start;
+        stats->probeUs = av_gettime_relative() - opened;
+        stats->fastOpen = mFastOpen;
+        stats->probeSkipped = mFastOpen && mProbe.IsSkipped();
+        stats->cachedParams = mFastOpen && mProbe.IsCached();
+        stats->probePackets = mFastOpen ? mProbe.GetProbePackets() : 0;
+    }
+    return true;
+}
+
+bool VideoDecoder::reconnect() {
+    if(mReconnectAttempts <= 0 || mAborted || !IsNetworkUrl(mUrl) || !IsLiveInput(mFormatContext)) {
+        return false;
+    }
+
+    mPrevStalls = mReadAheadStalls;
+    mPrevStallUs = mReadAheadStallUs;
+    Backoff backoff(mReconnectAttempts);
+    while(backoff.Wait([this] { return mAborted.load(); })) {
+        cout << "reconnect " << mUrl << ", attempt " << backoff.GetAttempts() << endl;
+        avformat_close_input(&mFormatContext);
+        if(!openInput()) {
+            avformat_close_input(&mFormatContext);
+            continue;
+        }
+
+        // 视频解码器已经按照原来的参数打开了,编码格式变了的话就没法继续解码
+        int videoIndex = av_find_best_stream(mFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        if(videoIndex < 0 || mFormatContext->streams[videoIndex]->codecpar->codec_id != mCodecContext->codec_id) {
+            cout << "video stream changed after reconnect" << endl;
+            continue;
+        }
+        mInputVideoIndex = videoIndex;
+        mInputAudioIndex = mAudioStreamIndex < 0 ? -1
+                           : av_find_best_stream(mFormatContext, AVMEDIA_TYPE_AUDIO, -1, videoIndex, NULL, 0);
+        updateDiscard();
+
+        // 新连接的第一个关键帧之前的数据无法解码,时间戳从这个关键帧开始接上
+        mWaitKeyFrame = true;
+        mRebaser.Restart();
+        mReconnects++;
+        return true;
+    }
+    return false;
+}
+
+int VideoDecoder::interruptCallback(void* context) {
+    return static_cast<VideoDecoder*>(context)->mAborted ? 1 : 0;
+}
+
+bool VideoDecoder::openSoftwareCodec(AVCodecParameters* codecParam, const DecoderConfig& config) {
     // 通过codec_id获取到对应的解码器
     // codec_id是enum AVCodecID类型,我们可以通过它知道视频流的格式,如AV_CODEC_ID_H264(0x1B)、AV_CODEC_ID_H265(0xAD)等
     // 当然如果是音频轨道的话它的值可能是AV_CODEC_ID_MP3(0x15001)、AV_CODEC_ID_AAC(0x15002)等
@@ -73,13 +259,31 @@ bool VideoDecoder::Load(const string& url) {
         return false;
     }
 
-
     // 设置解码器参数
     if(avcodec_parameters_to_context(mCodecContext, codecParam) < 0) {
         cout << "can't set codec params" << endl;
         return false;
     }
 
+    // 设置多线程解码,默认的thread_count是1,也就是说不设置的话软解只会用到一个cpu核
+    // thread_count设置成0的话FFmpeg会按照cpu核数自动选择线程数
+    mCodecContext->thread_count = config.threadCount;
+    if(config.lowDelay) {
+        // 帧级多线程每个线程都要缓存一帧,会带来thread_count-1帧的延迟,所以低延迟模式只用slice级多线程
+        mCodecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        mCodecContext->thread_type = FF_THREAD_SLICE;
+    } else if(DECODER_THREAD_FRAME == config.threadType) {
+        mCodecContext->thread_type = FF_THREAD_FRAME;
+    } else if(DECODER_THREAD_SLICE == config.threadType) {
+        mCodecContext->thread_type = FF_THREAD_SLICE;
+    } else {
+        mCodecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+
+    if(NULL != config.framePool) {
+        config.framePool->Attach(mCodecContext);
+    }
+
     // 打开解码器,从源码里面看到在avcodec_free_context释放解码器上下文的时候会close,
     // 所以我们可以不用自己调用avcodec_close去关闭
     if(avcodec_open2(mCodecContext, codec, NULL) < 0) {
@@ -87,36 +291,81 @@ bool VideoDecoder::Load(const string& url) {
         return false;
     }
 
-    // 创建创建AVPacket接收数据包
-    // 无论是压缩的音频流还是压缩的视频流,都是由一个个数据包组成的
-    // 解码的过程实际就是从文件流中读取一个个数据包传给解码器去解码
-    // 对于视频，它通常应包含一个压缩帧
-    // 对于音频，它可能是一段压缩音频、包含多个压缩帧
-    // 在不需要的时候可以通过av_packet_free释放
-    mPacket = av_packet_alloc();
-    if(NULL == mPacket) {
-        cout << "can't alloc packet" << endl;
+    return true;
+}
+
+// 内存不足、解码器状态不对这些错误再解下去也没有用
+// 其他的比如AVERROR_INVALIDDATA是数据本身损坏了,只影响当前这一帧,直播流里面偶尔会有
+static bool isRecoverableError(int error) {
+    return error < 0
+           && error != AVERROR(EAGAIN)
+           && error != AVERROR_EOF
+           && error != AVERROR(ENOMEM)
+           && error != AVERROR(EINVAL)
+           && error != AVERROR_BUG
+           && error != AVERROR_EXTERNAL;
+}
+
+// MediaCodec解码器同时支持输出到Surface(AV_PIX_FMT_MEDIACODEC)和输出到内存(NV12等)
+// 默认的get_format会跳过需要额外设置的硬件格式,所以这里要手动选择AV_PIX_FMT_MEDIACODEC
+static AVPixelFormat getMediaCodecFormat(AVCodecContext*, const AVPixelFormat* formats) {
+    for(const AVPixelFormat* format = formats; *format != AV_PIX_FMT_NONE; format++) {
+        if(*format == AV_PIX_FMT_MEDIACODEC) {
+            return *format;
+        }
+    }
+    return formats[0];
+}
+
+bool VideoDecoder::openMediaCodec(AVCodecParameters* codecParam, void* surface) {
+    // 编译脚本里面只打开了h264_mediacodec
+    if(codecParam->codec_id != AV_CODEC_ID_H264) {
         return false;
     }
 
-    // 创建AVFrame接收解码器解码出来的原始数据(视频的画面帧或者音频的PCM裸流)
-    // 在不需要的时候可以通过av_frame_free释放
-    mFrame = av_frame_alloc();
-    if(NULL == mFrame) {
-        cout << "can't alloc frame" << endl;
+    AVCodec* codec = avcodec_find_decoder_by_name("h264_mediacodec");
+    if(codec == NULL) {
+        cout << "can't find h264_mediacodec" << endl;
         return false;
     }
 
-    // 可以从解码器上下文获取视频的尺寸
-    // 这个尺寸实际上是从AVCodecParameters里面复制过去的,所以直接用codecParam->width、codecParam->height也可以
-    mVideoWidth = mCodecContext->width;
-    mVideoHegiht =  mCodecContext->height;
+    mCodecContext = avcodec_alloc_context3(codec);
+    if (mCodecContext == NULL) {
+        cout << "can't alloc codec context" << endl;
+        return false;
+    }
 
-    // 可以从解码器上下文获取视频的像素格式
-    // 这个像素格式实际上是从AVCodecParameters里面复制过去的,所以直接用codecParam->format也可以
-    mPixelFormat = mCodecContext->pix_fmt;
+    do {
+        if(avcodec_parameters_to_context(mCodecContext, codecParam) < 0) {
+            cout << "can't set codec params" << endl;
+            break;
+        }
 
-    return true;
+        // 将Surface通过AVMediaCodecContext交给MediaCodec,解码出来的画面不会拷贝回内存,而是直接送到Surface上
+        // 这个Surface是由SurfaceTexture创建的,所以画面最终会出现在SurfaceTexture绑定的OES纹理上
+        // AVMediaCodecContext会在av_mediacodec_default_free的时候释放
+        AVMediaCodecContext* mediaCodecContext = av_mediacodec_alloc_context();
+        if(NULL == mediaCodecContext) {
+            break;
+        }
+        if(av_mediacodec_default_init(mCodecContext, mediaCodecContext, surface) < 0) {
+            av_free(mediaCodecContext);
+            break;
+        }
+        mCodecContext->get_format = getMediaCodecFormat;
+
+        if(avcodec_open2(mCodecContext, codec, NULL) < 0) {
+            cout << "can't open h264_mediacodec" << endl;
+            av_mediacodec_default_free(mCodecContext);
+            break;
+        }
+
+        mHardware = true;
+        return true;
+    } while(0);
+
+    avcodec_free_context(&mCodecContext);
+    return false;
 }
 
 AVPixelFormat VideoDecoder::GetPixelFormat() {
@@ -126,17 +375,39 @@ AVPixelFormat VideoDecoder::GetPixelFormat() {
 void VideoDecoder::Release() {
     mUrl = "";
     mVideoStreamIndex = -1;
+    mAudioStreamIndex = -1;
+    mVideoTimeBase = {0, 1};
+    mAudioTimeBase = {0, 1};
+    mInputVideoIndex = -1;
+    mInputAudioIndex = -1;
+    mReconnectAttempts = 0;
+    mFastOpen = false;
+    mProbe.Clear();
+    mOpenStats = {0, 0, false, false, false, 0};
+    mWaitKeyFrame = false;
+    mRebaser.Reset();
+    mReadAudio = false;
     mVideoWidth = -1;
     mVideoHegiht = -1;
     mDecodecStart = -1;
-    mLastDecodecTime = -1;
+    mFrameRate = {0, 1};
+    mNextPts = AV_NOPTS_VALUE;
     mPixelFormat = AV_PIX_FMT_NONE;
+    mDecoderState = DECODER_RUNNING;
+    mSeekable = false;
+    mSeekTarget = AV_NOPTS_VALUE;
+    mSeekStart = -1;
+    mSeekPending = false;
 
     if(NULL != mFormatContext) {
         avformat_close_input(&mFormatContext);
     }
 
     if (NULL != mCodecContext) {
+        // avcodec_free_context不会释放hwaccel_context,所以MediaCodec的上下文需要自己释放
+        if(mHardware) {
+            av_mediacodec_default_free(mCodecContext);
+        }
         avcodec_free_context(&mCodecContext);
     }
     
@@ -150,72 +421,81 @@ void VideoDecoder::Release() {
 }
 
 AVFrame* VideoDecoder::NextFrame() {
-    // 从文件流里面读取出数据包,这里的数据包是编解码层的压缩数据
-    if(av_read_frame(mFormatContext, mPacket) < 0) {
-        return NULL;
-    }
-
-    AVFrame* frame = NULL;
-
-    // 这里的数据包可能是各个流的包,所以需要通过stream_index过滤出我们需要的视频流
-    // 然后通过avcodec_send_packet将数据包发送给解码器
-    // 接着通过avcodec_receive_frame读取到解码器解出来的原始像素数据
+    // 由于视频压缩帧存在i帧、b帧、p帧这些类型,并不是每种帧都可以直接解码出原始画面
+    // b帧是双向差别帧，也就是说b帧记录的是本帧与前后帧的差别,还需要后面的帧才能解码
+    // 所以一个数据包送进去不一定能马上解出一帧,也可能一次解出好几帧
+    // 这里循环地先尝试从解码器读取画面,读不到的时候再送入新的数据包,直到解出一帧或者解码器完全排空
     // avcodec_receive_frame内会调用av_frame_unref将上一帧的内存清除,而最后一帧的数据也会在Release的时候被av_frame_free清除
     // 所以不需要手动调用av_frame_unref
-    if(mPacket->stream_index == mVideoStreamIndex
-        && avcodec_send_packet(mCodecContext, mPacket) == 0
-        && avcodec_receive_frame(mCodecContext, mFrame) == 0) {
-        frame = mFrame;
-
-        // 由于解码的速度比较快,我们可以等到需要播放的时候再去解码下一帧
-        // 这样可以降低cpu的占用,也能减少绘制线程堆积画面队列造成内存占用过高
-        // 由于这个demo没有单独的解码线程,在渲染线程进行解码,sdl渲染本身就耗时
-        // 所以就算不延迟也会发现画面是正常速度播放的
-        // 可以将绘制的代码注释掉,然后在该方法内加上打印,会发现一下子就解码完整个视频了
-        if(AV_NOPTS_VALUE == mFrame->pts) {
-            // 有些视频流不带pts数据,按30fps将每帧间隔统一成32ms
-            int64_t sleep = 32000 - (av_gettime() - mLastDecodecTime);
-            if(mLastDecodecTime != -1 && sleep > 0) {
-                av_usleep(sleep);
+    while(true) {
+        DecodeStatus status = ReceiveFrame(mFrame);
+        if(DECODE_FRAME == status) {
+            // 极速模式下不做任何延迟,用于测试解码本身的吞吐量
+            if(!mFastMode) {
+                waitForPresentTime();
             }
-            mLastDecodecTime = av_gettime();
-        } else {
-            // 带pts数据的视频流,我们计算出这一帧应该在什么时候播放,如果时间还没有到就添加延迟
-
-            // time_base即pts的单位,AVRational是个分数,代表几分之几秒
-            AVRational timebase = mFormatContext->streams[mPacket->stream_index]->time_base;
-
-            // 我们用timebase.num * 1.0f / timebase.den计算出这个分数的值,然后*1000等到ms,再*1000得到us
-            // 后半部分的计算其实可以放到VideoDecoder::Load里面保存到成员变量,但是为了讲解方便就放在这里了
-            int64_t pts = mFrame->pts * 1000 * 1000 * timebase.num * 1.0f / timebase.den;
+            return mFrame;
+        }
 
+        if(DECODE_NEED_PACKET != status) {
+            return NULL;
+        }
 
-            // 如果是第一帧就记录开始时间
-            if(-1 == mDecodecStart) {
-                mDecodecStart = av_gettime() - pts;
+        // 读到文件末尾之后送一个空包进去,让解码器把缓存的帧都吐出来
+        // 上一次SendPacket返回EAGAIN的话mPacket里面还留着那个包,先重新送它
+        if(mPacket->size > 0 || ReadPacket(mPacket)) {
+            if(AVERROR(EAGAIN) == SendPacket(mPacket)) {
+                continue;
             }
 
-            // 当前时间减去开始时间,得到当前播放到了视频的第几微秒
-            int64_t now = av_gettime() - mDecodecStart;
-
-            // 如果这一帧的播放时间还没有到就等到播放时间到了再返回
-            if(pts > now) {
-                av_usleep(pts - now);
-            }
+            // 送入解码器之后压缩数据包的数据就不需要了,将它释放
+            av_packet_unref(mPacket);
+        } else {
+            SendPacket(NULL);
         }
     }
+}
 
-    // 解码完成之后压缩数据包的数据就不需要了,将它释放
-    av_packet_unref(mPacket);
+void VideoDecoder::waitForPresentTime() {
+    // 由于解码的速度比较快,我们可以等到需要播放的时候再去解码下一帧
+    // 这样可以降低cpu的占用,也能减少绘制线程堆积画面队列造成内存占用过高
+    // 由于这个demo没有单独的解码线程,在渲染线程进行解码,sdl渲染本身就耗时
+    // 所以就算不延迟也会发现画面是正常速度播放的
+    // 可以打开极速模式(SetFastMode),会发现一下子就解码完整个视频了
+    // 我们计算出这一帧应该在什么时候播放,如果时间还没有到就添加延迟
+    int64_t pts = GetFramePts(mFrame);
+
+    // 如果是第一帧就记录开始时间,之后每一帧的播放时间都相对这个时间计算,所以不会累积误差
+    if(-1 == mDecodecStart) {
+        mDecodecStart = av_gettime_relative() - pts;
+    }
 
-    // 由于视频压缩帧存在i帧、b帧、p帧这些类型,并不是每种帧都可以直接解码出原始画面
-    // b帧是双向差别帧，也就是说b帧记录的是本帧与前后帧的差别,还需要后面的帧才能解码
-    // 如果这一帧AVPacket没有解码出数据来的话,就递归调用NextFrame解码下一帧,直到解出下一帧原生画面来
-    if(frame == NULL) {
-        return NextFrame();
+    // 当前时间减去开始时间,得到当前播放到了视频的第几微秒
+    int64_t now = av_gettime_relative() - mDecodecStart;
+
+    // 如果这一帧的播放时间还没有到就等到播放时间到了再返回
+    if(pts > now) {
+        av_usleep(pts - now);
     }
+}
+
+int64_t VideoDecoder::GetFramePts(AVFrame* frame) {
+    // time_base即pts的单位,AVRational是个分数,代表几分之几秒
+    // 不要用timebase.num * 1.0f / timebase.den这样的浮点数去计算,float只有24位精度,播放几分钟之后误差就很明显了
+    // av_rescale_q用整数运算精确地将pts从time_base换算成微秒(AV_TIME_BASE_Q)
+    return av_rescale_q(frame->pts, GetTimeBase(), AV_TIME_BASE_Q);
+}
 
-    return frame;
+int64_t VideoDecoder::GetFrameDuration(AVFrame* frame) {
+    return av_rescale_q(getFrameDuration(frame), GetTimeBase(), AV_TIME_BASE_Q);
+}
+
+int64_t VideoDecoder::getFrameDuration(AVFrame* frame) {
+    // 优先使用数据包里面带的时长,没有的话按照帧率计算,单位是time_base
+    if(frame->pkt_duration > 0) {
+        return frame->pkt_duration;
+    }
+    return av_rescale_q(1, av_inv_q(mFrameRate), GetTimeBase());
 }
 
 void VideoDecoder::DumpVideoInfo() {
@@ -228,4 +508,321 @@ int VideoDecoder::GetVideoWidth() {
 
 int VideoDecoder::GetVideoHeight() {
     return mVideoHegiht;
-}
\ No newline at end of file
+}
+
+bool VideoDecoder::IsHardware() {
+    return mHardware;
+}
+
+int VideoDecoder::GetThreadCount() {
+    // avcodec_open2之后thread_count会被设置成实际创建的线程数
+    return NULL == mCodecContext ? 0 : mCodecContext->thread_count;
+}
+
+int VideoDecoder::GetActiveThreadType() {
+    return NULL == mCodecContext ? 0 : mCodecContext->active_thread_type;
+}
+
+bool VideoDecoder::ReadPacket(AVPacket* packet) {
+    // 重连失败之后mFormatContext已经被关闭了
+    if(NULL == mFormatContext) {
+        return false;
+    }
+
+    while(true) {
+        // 直播流读取失败一般是网络断开了,重连成功之后继续读取
+        // 快速探测读出来的数据包会先返回
+        if(mProbe.ReadFrame(mFormatContext, packet) < 0) {
+            if(!reconnect() || NULL == mFormatContext) {
+                return false;
+            }
+            continue;
+        }
+        updateReadAheadStats();
+
+        // 跳过不需要的轨道的包
+        AVRational timeBase;
+        if(packet->stream_index == mInputVideoIndex) {
+            packet->stream_index = mVideoStreamIndex;
+            timeBase = mVideoTimeBase;
+        } else if(mReadAudio && packet->stream_index == mInputAudioIndex) {
+            packet->stream_index = mAudioStreamIndex;
+            timeBase = mAudioTimeBase;
+        } else {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        if(mWaitKeyFrame) {
+            if(packet->stream_index != mVideoStreamIndex || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(packet);
+                continue;
+            }
+            mWaitKeyFrame = false;
+        }
+
+        // 没有重连过的时候时间戳保持不变
+        AVStream* stream = mFormatContext->streams[packet->stream_index == mVideoStreamIndex ? mInputVideoIndex : mInputAudioIndex];
+        mRebaser.Rebase(packet, stream->time_base, timeBase);
+        return true;
+    }
+}
+
+void VideoDecoder::Abort() {
+    mAborted = true;
+}
+
+int64_t VideoDecoder::GetReconnectCount() {
+    return mReconnects;
+}
+
+OpenStats VideoDecoder::GetOpenStats() {
+    return mOpenStats;
+}
+
+ReadAheadStats VideoDecoder::GetReadAheadStats() {
+    ReadAheadStats stats;
+    stats.enabled = mReadAhead;
+    stats.fillBytes = mReadAheadFill;
+    stats.stalls = mReadAheadStalls;
+    stats.stallUs = mReadAheadStallUs;
+    return stats;
+}
+
+void VideoDecoder::updateReadAheadStats() {
+    if(!mReadAhead || NULL == mFormatContext->pb) {
+        return;
+    }
+
+    // 统计数据是async协议的只读参数,通过AVIOContext -> URLContext -> async的私有数据查找
+    int64_t value = 0;
+    if(av_opt_get_int(mFormatContext->pb, "fill_level", AV_OPT_SEARCH_CHILDREN, &value) >= 0) {
+        mReadAheadFill = value;
+    }
+    if(av_opt_get_int(mFormatContext->pb, "stall_count", AV_OPT_SEARCH_CHILDREN, &value) >= 0) {
+        mReadAheadStalls = mPrevStalls + value;
+    }
+    if(av_opt_get_int(mFormatContext->pb, "stall_time", AV_OPT_SEARCH_CHILDREN, &value) >= 0) {
+        mReadAheadStallUs = mPrevStallUs + value;
+    }
+}
+
+int VideoDecoder::SendPacket(AVPacket* packet) {
+    // 已经开始排空的解码器不能再送入数据
+    if(DECODER_RUNNING != mDecoderState) {
+        return AVERROR_EOF;
+    }
+
+    bool skip = NULL != packet && updateSkipFrame(packet);
+
+    // 软解在调用方把帧读完(ReceiveFrame返回DECODE_NEED_PACKET)之后总是能接收新的数据包,
+    // 但是MediaCodec的输入缓冲区都在使用中的时候还是会返回EAGAIN,这个包并没有被接收,
+    // 调用方需要留着它,先调用ReceiveFrame把输出读出来再重新送入,丢掉的话一直到下一个关键帧画面都是花的
+    int ret = avcodec_send_packet(mCodecContext, packet);
+    if(ret == AVERROR(EAGAIN)) {
+        return ret;
+    }
+
+    // 送入空包代表输入结束,解码器进入排空状态,之后avcodec_receive_frame会把缓存的帧都吐出来,最后返回AVERROR_EOF
+    if(NULL == packet) {
+        mDecoderState = DECODER_DRAINING;
+    }
+    if(skip) {
+        mSeekSkippedPackets++;
+    }
+
+    // 损坏的数据包会返回AVERROR_INVALIDDATA之类的错误,丢掉这个包继续解码后面的就好
+    if(ret < 0 && ret != AVERROR_EOF) {
+        cout << "send packet failed: " << ret << endl;
+    }
+    return ret;
+}
+
+DecodeStatus VideoDecoder::ReceiveFrame(AVFrame* frame) {
+    if(DECODER_FINISHED == mDecoderState) {
+        return DECODE_EOF;
+    }
+
+    int ret = 0;
+    while(0 == (ret = avcodec_receive_frame(mCodecContext, frame)) || isRecoverableError(ret)) {
+        // 损坏的数据解不出来这一帧,解码器本身没有问题,丢掉它继续读下一帧
+        // 运行状态下下一次avcodec_receive_frame一般会返回EAGAIN,调用方就会送入新的数据包
+        if(0 != ret) {
+            cout << "receive frame failed: " << ret << ", skip it" << endl;
+            continue;
+        }
+
+        // 有些视频流不带pts数据,先用解码器根据dts等信息推测出来的best_effort_timestamp
+        // 还是没有的话就根据上一帧的pts和时长推算,保证交出去的每一帧都有pts
+        if(AV_NOPTS_VALUE == frame->pts) {
+            frame->pts = frame->best_effort_timestamp;
+        }
+        if(AV_NOPTS_VALUE == frame->pts) {
+            frame->pts = AV_NOPTS_VALUE == mNextPts ? 0 : mNextPts;
+        }
+        int64_t duration = getFrameDuration(frame);
+        mNextPts = frame->pts + duration;
+
+        // 精确seek的时候,显示时间在目标时间之前结束的帧只是为了给后面的帧做参考,直接丢掉
+        if(AV_NOPTS_VALUE != mSeekTarget) {
+            if(frame->pts + duration <= mSeekTarget) {
+                mSeekDiscardedFrames++;
+                av_frame_unref(frame);
+                continue;
+            }
+            mSeekTarget = AV_NOPTS_VALUE;
+        }
+
+        if(mSeekPending) {
+            mSeekPending = false;
+            mLastSeekUs = av_gettime_relative() - mSeekStart;
+            mSeekLatency.Record(mLastSeekUs);
+        }
+        return DECODE_FRAME;
+    }
+
+    if(ret == AVERROR(EAGAIN)) {
+        // 解码器需要更多数据才能输出下一帧
+        return DECODE_NEED_PACKET;
+    }
+
+    if(ret == AVERROR_EOF) {
+        // 排空完成,解码器里面已经没有任何帧了
+        mDecoderState = DECODER_FINISHED;
+        return DECODE_EOF;
+    }
+
+    // 内存不足、参数错误这些没办法恢复
+    cout << "receive frame failed: " << ret << endl;
+    mDecoderState = DECODER_FINISHED;
+    return DECODE_ERROR;
+}
+
+bool VideoDecoder::Seek(int64_t timestampUs, SeekMode mode) {
+    if(!SeekInput(timestampUs)) {
+        return false;
+    }
+    FlushDecoder(timestampUs, mode);
+
+    // 还没有送进解码器的包是seek之前的位置
+    av_packet_unref(mPacket);
+    return true;
+}
+
+bool VideoDecoder::SeekInput(int64_t timestampUs) {
+    if(!mSeekable || NULL == mFormatContext) {
+        return false;
+    }
+    mSeekStart = av_gettime_relative();
+
+    // 按照视频轨道seek,解复用器会使用视频轨道的关键帧索引
+    // max_ts等于目标时间,代表定位到目标时间之前(包括目标时间)最近的关键帧,精确seek再从这里往后解码
+    // 目标时间在第一个关键帧之前的话找不到满足条件的关键帧,这时放宽成离目标时间最近的关键帧
+    AVStream* stream = mFormatContext->streams[mInputVideoIndex];
+    int64_t target = av_rescale_q(timestampUs, AV_TIME_BASE_Q, stream->time_base);
+    int ret = avformat_seek_file(mFormatContext, mInputVideoIndex, INT64_MIN, target, target, 0);
+    if(ret < 0) {
+        ret = avformat_seek_file(mFormatContext, mInputVideoIndex, INT64_MIN, target, INT64_MAX, 0);
+    }
+    if(ret < 0) {
+        cout << "seek to " << timestampUs << "us failed: " << ret << endl;
+        return false;
+    }
+
+    // 快速探测读出来还没有返回的数据包已经过时了
+    // 关键帧之前的音频包对应的画面解不出来,也一起跳过
+    mProbe.Clear();
+    mWaitKeyFrame = true;
+    return true;
+}
+
+void VideoDecoder::SkipToKeyFrame() {
+    mProbe.Clear();
+    mWaitKeyFrame = true;
+}
+
+void VideoDecoder::Flush() {
+    // 清空解码器内部缓存的参考帧和还没有输出的帧,排空之后的解码器也可以继续使用
+    avcodec_flush_buffers(mCodecContext);
+    mDecoderState = DECODER_RUNNING;
+    mNextPts = AV_NOPTS_VALUE;
+    mDecodecStart = -1;
+}
+
+void VideoDecoder::FlushDecoder(int64_t timestampUs, SeekMode mode) {
+    Flush();
+
+    mSeekTarget = SEEK_ACCURATE == mode ? av_rescale_q(timestampUs, AV_TIME_BASE_Q, mVideoTimeBase) : AV_NOPTS_VALUE;
+    mSeekPending = true;
+    mSeekDiscardedFrames = 0;
+    mSeekSkippedPackets = 0;
+}
+
+// 精确seek往后解码的时候,显示时间在目标时间之前的非参考帧(一般是B帧)不会被后面的帧用到,解码器可以直接跳过
+// 非参考帧本身也不需要做环路滤波,参考帧的环路滤波不能跳过,否则误差会一直传递到目标帧
+bool VideoDecoder::updateSkipFrame(const AVPacket* packet) {
+    bool skip = AV_NOPTS_VALUE != mSeekTarget
+                && AV_NOPTS_VALUE != packet->pts
+                && packet->pts + packet->duration <= mSeekTarget;
+    mCodecContext->skip_frame = skip ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    mCodecContext->skip_loop_filter = skip ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    return skip;
+}
+
+bool VideoDecoder::IsSeekable() {
+    return mSeekable;
+}
+
+int64_t VideoDecoder::GetDuration() {
+    return NULL == mFormatContext ? AV_NOPTS_VALUE : mFormatContext->duration;
+}
+
+SeekStats VideoDecoder::GetSeekStats() {
+    SeekStats stats;
+    stats.latency = mSeekLatency.GetStats();
+    stats.lastUs = mLastSeekUs;
+    stats.lastDiscardedFrames = mSeekDiscardedFrames;
+    stats.lastSkippedPackets = mSeekSkippedPackets;
+    return stats;
+}
+
+void VideoDecoder::SetFastMode(bool fastMode) {
+    mFastMode = fastMode;
+}
+
+AVStream* VideoDecoder::GetVideoStream() {
+    return mInputVideoIndex < 0 ? NULL : mFormatContext->streams[mInputVideoIndex];
+}
+
+AVStream* VideoDecoder::GetAudioStream() {
+    return mInputAudioIndex < 0 ? NULL : mFormatContext->streams[mInputAudioIndex];
+}
+
+bool VideoDecoder::IsAudioPacket(AVPacket* packet) {
+    return mAudioStreamIndex >= 0 && packet->stream_index == mAudioStreamIndex;
+}
+
+void VideoDecoder::SetReadAudio(bool readAudio) {
+    mReadAudio = readAudio;
+    updateDiscard();
+}
+
+// ReadPacket不会返回的轨道直接让解复用器丢掉,flv之类的解复用器会跳过这些数据,不再为每个包分配内存、拷贝数据和解析
+// 之后才出现的轨道(比如flv里面晚到的音频)还是默认值,读出来之后在ReadPacket里面丢掉
+void VideoDecoder::updateDiscard() {
+    if(NULL == mFormatContext) {
+        return;
+    }
+    for(unsigned int i = 0 ; i < mFormatContext->nb_streams ; i++) {
+        bool used = (int) i == mInputVideoIndex || (mReadAudio && (int) i == mInputAudioIndex);
+        mFormatContext->streams[i]->discard = used ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+}
+
+AVRational VideoDecoder::GetTimeBase() {
+    return mVideoTimeBase;
+}
+
+AVRational VideoDecoder::GetAudioTimeBase() {
+    return mAudioTimeBase;
+}
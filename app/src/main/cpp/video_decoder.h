@@ -1,21 +1,195 @@
+#ifndef __VIDEO_DECODER_H__
+#define __VIDEO_DECODER_H__
+
+#include <atomic>
 #include <string>
 
+#include "frame_pool.h"
+#include "latency_recorder.h"
+#include "reconnect.h"
+#include "stream_probe.h"
+
 extern "C" {
 #include <libavformat/avformat.h>
 }
 
+// ReceiveFrame的返回值
+enum DecodeStatus {
+    DECODE_FRAME,        // 成功解出一帧
+    DECODE_NEED_PACKET,  // 解码器里面的帧已经读完,需要送入新的数据包
+    DECODE_EOF,          // 解码器已经排空,不会再有新的帧
+    DECODE_ERROR         // 解码器出了没办法恢复的错误,损坏的数据只会丢掉对应的帧,不会返回这个
+};
+
+// 软解的多线程方式
+enum DecoderThreadType {
+    DECODER_THREAD_AUTO,   // 由解码器自己选择,支持帧级多线程就用帧级,否则用slice级
+    DECODER_THREAD_FRAME,  // 帧级多线程: 多个线程同时解不同的帧,吞吐量最高,但是每个线程会多缓存一帧带来延迟
+    DECODER_THREAD_SLICE   // slice级多线程: 多个线程同时解同一帧的不同slice,没有额外延迟,但是要视频本身分了多个slice才有效果
+};
+
+// Seek的方式
+enum SeekMode {
+    SEEK_KEYFRAME,   // 跳到目标时间之前最近的关键帧,只需要解码一帧,速度最快但是位置不精确,适合拖动进度条的时候预览
+    SEEK_ACCURATE    // 从关键帧开始往后解码到目标时间,中间的帧只解码不输出,位置精确到帧
+};
+
+struct SeekStats {
+    LatencyStats latency;        // 从开始seek到解码出seek之后第一帧的耗时
+    int64_t lastUs;              // 最近一次seek的耗时
+    int64_t lastDiscardedFrames; // 最近一次精确seek为了追上目标时间解码出来又丢掉的帧数
+    int64_t lastSkippedPackets;  // 最近一次精确seek允许解码器跳过非参考帧的数据包数量
+};
+
+struct DecoderConfig {
+    // 软解线程数,0代表按照cpu核数自动选择,1代表单线程解码
+    int threadCount;
+    DecoderThreadType threadType;
+
+    // 低延迟模式: 设置AV_CODEC_FLAG_LOW_DELAY并且只使用slice级多线程,解码器不会为了多线程缓存帧
+    // 适合直播这种对延迟敏感的场景
+    bool lowDelay;
+
+    // 安卓上可以传入一个android.view.Surface(jobject),这时会优先使用h264_mediacodec硬解
+    // 解码出来的画面直接输出到这个Surface,不会拷贝回内存,AVFrame的格式是AV_PIX_FMT_MEDIACODEC
+    // 硬解打开失败的时候会自动回退到软解
+    void* mediaCodecSurface;
+
+    // 直播流断开之后最多连续重连的次数,0代表不重连
+    // 重连之后从第一个关键帧继续,时间戳会接在断开之前的后面,解码器和时钟都感觉不到中断
+    int reconnectAttempts;
+
+    // 快速打开: 限制探测的数据量,FLV读到序列头和第一个视频包就不再调用avformat_find_stream_info
+    // 同一个url之前打开过的话还会用缓存的流参数补上缺少的参数,适合需要尽快出画面的直播
+    bool fastOpen;
+
+    // 软解的时候让解码器直接解到这个帧池的缓冲里面,避免每一帧都分配和释放画面内存,NULL代表使用FFmpeg默认的分配方式
+    // 帧池需要比VideoDecoder活得更久
+    FramePool* framePool;
+
+    // 网络流的预读缓冲大小(字节),0代表不预读
+    // 预读的时候通过FFmpeg的async协议打开url,由单独的I/O线程读socket填充环形缓冲,解复用只从缓冲里面拷贝数据,
+    // 网络抖动的时候解复用线程不会阻塞在socket上。缓冲满了之后要等解复用读走一半才继续读网络
+    // 同时保留readAheadSize/4已经读过的数据,小范围往回seek不需要重新请求
+    int readAheadSize;
+
+    DecoderConfig()
+            : threadCount(0),
+              threadType(DECODER_THREAD_AUTO),
+              lowDelay(false),
+              mediaCodecSurface(NULL),
+              reconnectAttempts(10),
+              fastOpen(false),
+              framePool(NULL),
+              readAheadSize(0) {}
+};
+
+// 网络预读的统计数据
+struct ReadAheadStats {
+    bool enabled;
+    int64_t fillBytes;    // 已经预读好、还没有被解复用读走的数据量
+    int64_t stalls;       // 解复用读数据的时候缓冲是空的、只能等网络的次数,包括重连之前的连接
+    int64_t stallUs;      // 等网络的总时间
+};
+
+// 打开输入的耗时,单位是微秒
+struct OpenStats {
+    int64_t openUs;       // avformat_open_input的耗时
+    int64_t probeUs;      // 探测流信息的耗时(avformat_find_stream_info或者快速探测)
+    bool fastOpen;
+    bool probeSkipped;    // 快速打开的时候跳过了avformat_find_stream_info
+    bool cachedParams;    // 用到了上一次打开同一个url时缓存的流参数
+    int probePackets;     // 快速探测读取的数据包数量
+};
+
 class VideoDecoder {
 public:
     VideoDecoder();
-    bool Load(const std::string& url);
+    bool Load(const std::string& url, const DecoderConfig& config = DecoderConfig());
     void Release();
 
     AVFrame* NextFrame();
 
+    // 下面几个方法将NextFrame拆分成解复用和解码两步,给多线程的Player使用
+    // ReadPacket只在解复用线程调用,SendPacket和ReceiveFrame只在解码线程调用
+    // 它们分别只访问AVFormatContext和AVCodecContext,所以可以在两个线程里面同时调用
+    // 直播流读取失败的时候ReadPacket内部会按指数退避重连,重连失败才返回false
+    bool ReadPacket(AVPacket* packet);
+
+    // 可以在任意线程调用,让阻塞在网络读取或者等待重连的ReadPacket尽快返回false
+    void Abort();
+
+    int64_t GetReconnectCount();
+
+    // 第一次打开输入的耗时
+    OpenStats GetOpenStats();
+
+    // 可以在任意线程调用,数据在每次ReadPacket之后更新
+    ReadAheadStats GetReadAheadStats();
+
+    // 默认ReadPacket只返回视频包,SetReadAudio(true)之后也会返回音频包,用IsAudioPacket区分
+    // 音频包需要交给AudioPlayer解码,VideoDecoder本身只解码视频
+    // GetAudioStream和GetVideoStream返回的是当前连接里面的轨道,重连之后可能是另一个AVStream,
+    // 当前连接没有这个轨道的时候返回NULL
+    AVStream* GetAudioStream();
+    AVStream* GetVideoStream();
+    bool IsAudioPacket(AVPacket* packet);
+    void SetReadAudio(bool readAudio);
+
+    // 解码器是一个状态机:
+    //   RUNNING:  ReceiveFrame返回DECODE_NEED_PACKET的时候通过SendPacket送入数据包
+    //   DRAINING: SendPacket(NULL)之后进入排空状态,ReceiveFrame会把缓存的帧都读出来
+    //   FINISHED: 排空完成或者出错,ReceiveFrame一直返回DECODE_EOF
+    // 调用方需要一直调用ReceiveFrame直到返回DECODE_NEED_PACKET才能送入下一个包,这样一个包解出多帧的时候不会丢帧
+    // SendPacket返回AVERROR(EAGAIN)代表解码器暂时没有接收这个包(MediaCodec的输入缓冲区满了),
+    // 调用方需要保留它,调用ReceiveFrame之后再送一次
+    int SendPacket(AVPacket* packet);
+    DecodeStatus ReceiveFrame(AVFrame* frame);
+
+    // 时间戳和GetFramePts是同一个时间轴,单位是微秒
+    // 直播流不能seek,返回false
+    // 只能在单线程使用NextFrame的时候调用,相当于SeekInput + FlushDecoder
+    bool Seek(int64_t timestampUs, SeekMode mode);
+
+    // 多线程的Player把seek拆成两步: 解复用线程调用SeekInput定位到目标时间之前的关键帧
+    // 解码线程在送入seek之后的第一个数据包之前调用FlushDecoder清空解码器里面缓存的帧
+    bool SeekInput(int64_t timestampUs);
+    void FlushDecoder(int64_t timestampUs, SeekMode mode);
+
+    // 直播追赶延迟的时候不seek,而是丢掉数据直到下一个关键帧: 解复用线程调用SkipToKeyFrame之后
+    // ReadPacket会丢掉下一个视频关键帧之前的所有数据包,解码线程在送入这个关键帧之前调用Flush
+    // Flush只清空解码器,不算作一次seek,直播流也可以调用
+    void SkipToKeyFrame();
+    void Flush();
+
+    // 本地文件和点播流可以seek,直播流不行
+    bool IsSeekable();
+    SeekStats GetSeekStats();
+
+    // 总时长,单位是微秒,直播流返回AV_NOPTS_VALUE
+    int64_t GetDuration();
+
+    // 极速模式: NextFrame不再按照pts延迟,用于测试纯解码的速度
+    void SetFastMode(bool fastMode);
+    AVRational GetTimeBase();
+
+    // ReadPacket返回的音频包的pts单位,重连之后也不变,不要用GetAudioStream()->time_base
+    AVRational GetAudioTimeBase();
+
+    // 获取帧的pts和时长,单位是微秒
+    // ReceiveFrame交出来的帧都保证有pts,没有pts的流会根据帧率推算
+    int64_t GetFramePts(AVFrame* frame);
+    int64_t GetFrameDuration(AVFrame* frame);
+
     void DumpVideoInfo();
     int GetVideoWidth();
     int GetVideoHeight();
     AVPixelFormat GetPixelFormat();
+    bool IsHardware();
+
+    // 解码器实际使用的线程数和多线程方式(FF_THREAD_FRAME/FF_THREAD_SLICE,0代表单线程)
+    int GetThreadCount();
+    int GetActiveThreadType();
 
 private:
     AVFormatContext* mFormatContext;
@@ -24,10 +198,71 @@ private:
     AVFrame* mFrame;
 
     std::string mUrl;
+
+    // 第一次连接时的轨道序号和time_base,重连之后ReadPacket返回的数据包也统一换算成它们
     int mVideoStreamIndex;
+    int mAudioStreamIndex;
+    AVRational mVideoTimeBase;
+    AVRational mAudioTimeBase;
+
+    // 当前连接里面视频和音频的轨道序号,重连之后可能和第一次连接不一样
+    int mInputVideoIndex;
+    int mInputAudioIndex;
+
+    int mReconnectAttempts;
+    bool mFastOpen;
+    int mReadAheadSize;
+    std::atomic<bool> mReadAhead;
+    std::atomic<int64_t> mReadAheadFill;
+    std::atomic<int64_t> mReadAheadStalls;
+    std::atomic<int64_t> mReadAheadStallUs;
+    int64_t mPrevStalls;      // 重连之前的连接等网络的次数和时间
+    int64_t mPrevStallUs;
+    StreamProbe mProbe;
+    OpenStats mOpenStats;
+    TimestampRebaser mRebaser;
+    bool mWaitKeyFrame;
+    std::atomic<bool> mAborted;
+    std::atomic<int64_t> mReconnects;
+
+    bool mReadAudio;
     int mVideoWidth;
     int mVideoHegiht;
     int64_t mDecodecStart;
-    int64_t mLastDecodecTime;
+    AVRational mFrameRate;
+    int64_t mNextPts;
     AVPixelFormat mPixelFormat;
-};
\ No newline at end of file
+
+    enum DecoderState {
+        DECODER_RUNNING,
+        DECODER_DRAINING,
+        DECODER_FINISHED
+    };
+    DecoderState mDecoderState;
+    bool mFastMode;
+    bool mHardware;
+
+    // 精确seek的目标时间(time_base),解码出来的帧在它之前的都会丢掉,AV_NOPTS_VALUE代表没有在seek
+    bool mSeekable;
+    int64_t mSeekTarget;
+    std::atomic<int64_t> mSeekStart;
+    bool mSeekPending;
+    LatencyRecorder mSeekLatency;
+    std::atomic<int64_t> mLastSeekUs;
+    std::atomic<int64_t> mSeekDiscardedFrames;
+    std::atomic<int64_t> mSeekSkippedPackets;
+
+    bool openInput(OpenStats* stats = NULL);
+    bool reconnect();
+    static int interruptCallback(void* context);
+    void updateReadAheadStats();
+
+    bool openSoftwareCodec(AVCodecParameters* codecParam, const DecoderConfig& config);
+    bool openMediaCodec(AVCodecParameters* codecParam, void* surface);
+    void waitForPresentTime();
+    bool updateSkipFrame(const AVPacket* packet);
+    void updateDiscard();
+    int64_t getFrameDuration(AVFrame* frame);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef __VIDEO_RENDERER_H__
+#define __VIDEO_RENDERER_H__
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// 渲染接口,Player的渲染线程通过它把解码出来的画面显示出来
+// 安卓上由EGLHelper + OpenGlDisplay实现,这样Player本身不依赖具体的显示方式
+class VideoRenderer {
+public:
+    virtual ~VideoRenderer() {}
+
+    virtual void Render(AVFrame* frame) = 0;
+};
+
+#endif
@@ -1,171 +1,328 @@
 #include "video_sender.h"
+#include "latency_stamp.h"
 
 #include <iostream>
 extern "C" {
-#include <libavformat/avformat.h>
 #include <libavutil/time.h>
 }
 
 using namespace std;
 
-static bool createOutputStreams(AVFormatContext* inputFormatContext, AVFormatContext* outputFormatContext) {
-    // 遍历输入流的所有轨道,拷贝编解码参数到输出流
-    for(int i = 0 ; i < inputFormatContext->nb_streams ; i++) {
-        // 为输出流创建轨道
-        AVStream* stream = avformat_new_stream(outputFormatContext, NULL);
-        if(NULL == stream) {
-            cout << "can't create stream, index " << i << endl;
-            return false;
-        }
+VideoSender::VideoSender()
+        : mInputFormatContext(NULL),
+          mVideoStreamIndex(-1),
+          mAbort(false),
+          mFastOpen(false),
+          mInputOptions(NULL),
+          mLatencyStamp(false),
+          mInputReconnects(0) {
+}
 
-        // 编解码参数在AVCodecParameters中保存,从输入流拷贝到输出流
-        if(avcodec_parameters_copy(stream->codecpar, inputFormatContext->streams[i]->codecpar) < 0) {
-            cout << "can't copy codec paramters, stream index " << i << endl;
-            return false;
-        }
+VideoSender::~VideoSender() {
+    Close();
+    av_dict_free(&mInputOptions);
+}
 
-        // codec_tag代表了音视频数据采用的码流格式,不同的封装格式如flv、mp4等的支持情况是不一样的
-        // 上面的avcodec_parameters_copy将输出流的codec_tag从输入拷贝过来变成了一样的
-        // 由于我们输出流在avformat_alloc_output_context2的时候写死了flv格式
-        // 如果输入流不是flv而是mp4等格式的话就可能会出现mp4里某种codec_tag在flv不支持导致推流失败的情况
-        // 这里我们可以用av_codec_get_id从输出流的oformat的支持的codec_tag列表里面查找codec_id
-        // 如果和codecpar的codec_id不一致的话代表不支持
-        if(av_codec_get_id(outputFormatContext->oformat->codec_tag, stream->codecpar->codec_tag) != stream->codecpar->codec_id) {
-            // 这里将codec_tag设置为0,FFmpeg会根据编码codec_id从封装格式的codec_tag列表中找到一个codec_tag
-            stream->codecpar->codec_tag = 0;
-        }
+void VideoSender::AddOutput(const string& destUrl, const string& format, const AVDictionary* options) {
+    AVDictionary* outputOptions = NULL;
+    av_dict_copy(&outputOptions, options, 0);
+    if(0 == destUrl.compare(0, 4, "rtmp")) {
+        // 推流的时候告诉服务器使用64KB的chunk,一个视频帧通常只有一个chunk,减少chunk头和写入的次数
+        // 协议层默认是128字节,调用者自己设置过的话不覆盖
+        av_dict_set(&outputOptions, "rtmp_chunk_size", "65536", AV_DICT_DONT_OVERWRITE);
+    }
+    mOutputs.push_back(new PushOutput(destUrl, format, outputOptions));
+    av_dict_free(&outputOptions);
+}
+
+void VideoSender::SetInputOption(const string& key, const string& value) {
+    av_dict_set(&mInputOptions, key.c_str(), value.c_str(), 0);
+}
+
+void VideoSender::SetLatencyStamp(bool latencyStamp) {
+    mLatencyStamp = latencyStamp;
+}
+
+void VideoSender::SetFastOpen(bool fastOpen) {
+    mFastOpen = fastOpen;
+}
+
+bool VideoSender::Open(const string& srcUrl) {
+    mSrcUrl = srcUrl;
+    if(!openInput()) {
+        return false;
+    }
+
+    // 打印输入视频信息
+    av_dump_format(mInputFormatContext, 0, srcUrl.c_str(), 0);
+
+    // 查找视频轨道,我们以视频轨道为基准去控制读取速度
+    mVideoStreamIndex = av_find_best_stream(mInputFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    mGopCache.SetVideoStreamIndex(mVideoStreamIndex);
+
+    mTimeBases.clear();
+    for(int i = 0 ; i < mInputFormatContext->nb_streams ; i++) {
+        mTimeBases.push_back(mInputFormatContext->streams[i]->time_base);
+    }
+    mRebaser.Reset();
+
+    if(mFastOpen) {
+        StreamProbe::SaveStreamInfo(srcUrl, mInputFormatContext);
     }
     return true;
 }
 
-bool VideoSender::Send(const string& srcUrl, const string& destUrl) {
-    bool result = false;
-    AVFormatContext* inputFormatContext = NULL;
-    AVFormatContext* outputFormatContext = NULL;
-    AVPacket* packet = NULL;
-
-    do {
-        // 打开文件流读取文件头解析出视频信息如轨道信息、时长等
-        // mFormatContext初始化为NULL,如果打开成功,它会被设置成非NULL的值
-        // 这个方法实际可以打开多种来源的数据,url可以是本地路径、rtmp地址等
-        // 在不需要的时候通过avformat_close_input关闭文件流
-        if(avformat_open_input(&inputFormatContext, srcUrl.c_str(), NULL, NULL) < 0) {
-            cout << "open " << srcUrl << " failed" << endl;
-            break;
+bool VideoSender::openInput() {
+    // 打开文件流读取文件头解析出视频信息如轨道信息、时长等
+    // 这个方法实际可以打开多种来源的数据,url可以是本地路径、rtmp地址等
+    // 阻塞的网络操作会定期调用interruptCallback,Stop的时候可以让它们立即返回
+    mInputFormatContext = avformat_alloc_context();
+    if(NULL == mInputFormatContext) {
+        return false;
+    }
+    mInputFormatContext->interrupt_callback.callback = interruptCallback;
+    mInputFormatContext->interrupt_callback.opaque = this;
+
+    // 快速打开的时候限制探测的数据量
+    AVDictionary* options = NULL;
+    av_dict_copy(&options, mInputOptions, 0);
+
+    if(mFastOpen) {
+        StreamProbe::SetFastOpenOptions(&options);
+    }
+    int ret = avformat_open_input(&mInputFormatContext, mSrcUrl.c_str(), NULL, &options);
+    av_dict_free(&options);
+    if(ret < 0) {
+        cout << "open " << mSrcUrl << " failed" << endl;
+        return false;
+    }
+
+    // 对于没有文件头的格式如MPEG或者H264裸流等,可以通过这个函数解析前几帧得到视频的信息
+    // 快速打开的时候先尝试从序列头和第一个视频包得到这些信息,探测读出来的数据包会在Run里面最先发送
+    mProbe.Clear();
+    ret = mFastOpen ? mProbe.Probe(mInputFormatContext, mSrcUrl) : avformat_find_stream_info(mInputFormatContext, NULL);
+    if(ret < 0) {
+        cout << "can't find stream info in " << mSrcUrl << endl;
+        avformat_close_input(&mInputFormatContext);
+        return false;
+    }
+    return true;
+}
+
+bool VideoSender::reconnectInput() {
+    if(!IsNetworkUrl(mSrcUrl) || !IsLiveInput(mInputFormatContext)) {
+        return false;
+    }
+
+    avformat_close_input(&mInputFormatContext);
+    Backoff backoff(INPUT_RECONNECT_ATTEMPTS);
+    while(backoff.Wait([this] { return mAbort.load(); })) {
+        cout << "reconnect " << mSrcUrl << ", attempt " << backoff.GetAttempts() << endl;
+        if(!openInput()) {
+            continue;
         }
 
-        // 对于没有文件头的格式如MPEG或者H264裸流等,可以通过这个函数解析前几帧得到视频的信息
-        if(avformat_find_stream_info(inputFormatContext, NULL) < 0) {
-            cout << "can't find stream info in " << srcUrl << endl;
-            break;
+        // 输出流已经按照原来的轨道创建好了,轨道变了就没法继续推送
+        bool sameStreams = mInputFormatContext->nb_streams == mTimeBases.size()
+                           && (mVideoStreamIndex < 0
+                               || AVMEDIA_TYPE_VIDEO == mInputFormatContext->streams[mVideoStreamIndex]->codecpar->codec_type);
+        if(!sameStreams) {
+            cout << "streams of " << mSrcUrl << " changed after reconnect" << endl;
+            avformat_close_input(&mInputFormatContext);
+            return false;
         }
 
-        // 打印输入视频信息
-        av_dump_format(inputFormatContext, 0, srcUrl.c_str(), 0);
+        mInputReconnects++;
+        mRebaser.Restart();
+        return true;
+    }
+    return false;
+}
+
+bool VideoSender::Run() {
+    if(NULL == mInputFormatContext || mOutputs.empty()) {
+        return false;
+    }
 
-        // 创建输出流上下文,outputFormatContext初始化为NULL,如果打开成功,它会被设置成非NULL的值,在不需要的时候使用avformat_free_context释放
-        // 输出流使用flv格式
-        if(avformat_alloc_output_context2(&outputFormatContext, NULL, "flv", destUrl.c_str()) < 0) {
-            cout << "can't alloc output context for " << destUrl << endl;
-            break;
+    // 每个目的地都拷贝一份轨道信息,然后在自己的线程里连接服务器
+    for(PushOutput* output : mOutputs) {
+        if(!output->Start(mInputFormatContext, mVideoStreamIndex)) {
+            cout << "start output " << output->GetUrl() << " failed" << endl;
         }
+    }
+
+    // 创建创建AVPacket接收数据包
+    // 无论是压缩的音频流还是压缩的视频流,都是由一个个数据包组成的
+    // 对于视频，它通常应包含一个压缩帧
+    // 对于音频，它可能是一段压缩音频、包含多个压缩帧
+    AVPacket* packet = av_packet_alloc();
+    if(NULL == packet) {
+        cout << "can't alloc packet" << endl;
+        return false;
+    }
+
+    // time_base即pts的单位,AVRational是个分数,代表几分之几秒
+    AVRational timeBase = mVideoStreamIndex >= 0 ? mTimeBases[mVideoStreamIndex] : AV_TIME_BASE_Q;
 
-        // 拷贝编解码参数
-        if(!createOutputStreams(inputFormatContext, outputFormatContext)) {
-            break;
+    //推流开始时间
+    int64_t startTime = av_gettime();
+
+    // 直播输入本身就是按照真实的速度到达的,再按pts控制速度只会增加延迟(例如转发服务)
+    bool live = IsLiveInput(mInputFormatContext);
+
+    // 只有avcC格式的H.264才能插入时间戳SEI
+    int nalLengthSize = 0;
+    if(mLatencyStamp && mVideoStreamIndex >= 0) {
+        nalLengthSize = GetNalLengthSize(mInputFormatContext->streams[mVideoStreamIndex]->codecpar);
+        if(0 == nalLengthSize) {
+            cout << "latency stamp only supports h264 in flv/mp4" << endl;
         }
+    }
 
-        // 打印输出视频信息
-        av_dump_format(outputFormatContext, 0, destUrl.c_str(), 1);
+    // 重连之后需要从关键帧开始,否则目的地收到的前几帧都无法解码
+    bool waitKeyFrame = false;
 
-        // 打开输出流,结束的时候使用avio_close关闭
-        if(avio_open(&outputFormatContext->pb, destUrl.c_str(), AVIO_FLAG_WRITE) < 0) {
-            cout << "can't open avio " << destUrl << endl;
-            break;
+    // 从文件流里面读取出数据包,这里的数据包是编解码层的压缩数据
+    while(!mAbort) {
+        if(mProbe.ReadFrame(mInputFormatContext, packet) < 0) {
+            // 直播流断开之后重连,本地文件读到结尾就是正常结束
+            if(mAbort || !reconnectInput()) {
+                break;
+            }
+            waitKeyFrame = mVideoStreamIndex >= 0;
+            continue;
         }
 
-        // 设置flvflags为no_duration_filesize用于解决下面的报错
-        // [flv @ 0x14f808e00] Failed to update header with correct duration.
-        // [flv @ 0x14f808e00] Failed to update header with correct filesize
-        AVDictionary * opts = NULL;
-        av_dict_set(&opts, "flvflags", "no_duration_filesize", 0);
-        if(avformat_write_header(outputFormatContext, opts ? &opts : NULL) < 0) {
-            cout << "write header to " << destUrl << " failed" << endl;
-            break;
+        // 有些格式会在读取的过程中出现新的轨道,输出流没有对应的轨道,直接跳过
+        int index = packet->stream_index;
+        if(index >= mTimeBases.size()) {
+            av_packet_unref(packet);
+            continue;
         }
 
-        // 创建创建AVPacket接收数据包
-        // 无论是压缩的音频流还是压缩的视频流,都是由一个个数据包组成的
-        // 解码的过程实际就是从文件流中读取一个个数据包传给解码器去解码
-        // 对于视频，它通常应包含一个压缩帧
-        // 对于音频，它可能是一段压缩音频、包含多个压缩帧
-        // 在不需要的时候可以通过av_packet_free释放
-        packet = av_packet_alloc();
-        if(NULL == packet) {
-            cout << "can't alloc packet" << endl;
-            break;
+        if(waitKeyFrame) {
+            if(index != mVideoStreamIndex || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(packet);
+                continue;
+            }
+            waitKeyFrame = false;
         }
 
-        // 查找视频轨道,实际上我们也可以通过遍历AVFormatContext的streams得到,代码如下:
-        // for(int i = 0 ; i < mFormatContext->nb_streams ; i++) {
-        //     if(mFormatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-        //         mVideoStreamIndex = i;
-        //         break;
-        //     }
-        // }
-        const int videoStreamIndex = av_find_best_stream(inputFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
-        
-        // time_base即pts的单位,AVRational是个分数,代表几分之几秒
-        AVRational timeBase = inputFormatContext->streams[videoStreamIndex]->time_base;
-        const float timeBaseFloat = timeBase.num * 1.0 / timeBase.den;
-
-        //推流开始时间
-        int64_t startTime = av_gettime();
-
-        // 从文件流里面读取出数据包,这里的数据包是编解码层的压缩数据
-        while(av_read_frame(inputFormatContext, packet) >= 0) {
-            // 我们以视频轨道为基准去同步时间
-            // 如果时间还没有到就添加延迟,避免向服务器推流速度过快
-            if(videoStreamIndex == packet->stream_index) {
-                if(AV_NOPTS_VALUE == packet->pts) {
-                    // 有些视频流不带pts数据,按30fps将间隔统一成32ms
-                    av_usleep(32000);
-                } else {
-                    // 带pts数据的视频流,我们计算出每一帧应该在什么时候播放
-                    int64_t nowTime = av_gettime() - startTime;
-                    int64_t pts = packet->pts * 1000 * 1000 * timeBaseFloat;
-                    if(pts > nowTime) {
-                        av_usleep(pts - nowTime);
-                    }
+        // 把时间戳接到断开之前的后面,并换算到第一次连接时的time_base,没有重连过的时候时间戳不变
+        mRebaser.Rebase(packet, mInputFormatContext->streams[index]->time_base, mTimeBases[index]);
+
+        // 我们以视频轨道为基准去同步时间
+        // 如果时间还没有到就添加延迟,避免向服务器推流速度过快
+        if(mVideoStreamIndex == index && !live) {
+            if(AV_NOPTS_VALUE == packet->pts) {
+                // 有些视频流不带pts数据,按30fps将间隔统一成32ms
+                av_usleep(32000);
+            } else {
+                // 带pts数据的视频流,我们计算出每一帧应该在什么时候播放
+                int64_t nowTime = av_gettime() - startTime;
+                // 用av_rescale_q精确换算成微秒,浮点数计算长时间推流之后会累积误差
+                int64_t pts = av_rescale_q(packet->pts, timeBase, AV_TIME_BASE_Q);
+                if(pts > nowTime) {
+                    av_usleep(pts - nowTime);
                 }
             }
-            // 往输出流写入数据
-            av_interleaved_write_frame(outputFormatContext, packet);
+        }
 
-            // 写入成之后压缩数据包的数据就不需要了,将它释放
-            av_packet_unref(packet);
+        // 时间戳在控制完速度之后再打,记录的是真正发出去的时间
+        if(nalLengthSize > 0 && mVideoStreamIndex == index) {
+            AddLatencyStamp(packet, nalLengthSize, av_gettime());
         }
 
-        // 写入视频尾部信息
-        av_write_trailer(outputFormatContext);
+        // 先放入GOP缓存,刚连接上的目的地会从缓存里最近的关键帧开始发送
+        mGopCache.Add(packet);
 
-        result = true;
-    } while(0);
+        // 分发给所有目的地,这里不会阻塞,慢的目的地会自己丢包
+        for(PushOutput* output : mOutputs) {
+            output->Push(packet, mGopCache);
+        }
 
-    if(NULL != packet) {
-        av_packet_free(&packet);
+        // 每个目的地都持有了自己的引用,这里的数据包就不需要了
+        av_packet_unref(packet);
     }
-    
-    if(NULL != outputFormatContext) {
-        if(NULL != outputFormatContext->pb) {
-            avio_close(outputFormatContext->pb);
+    av_packet_free(&packet);
+
+    // 正常结束的时候等所有目的地写完剩下的数据并写入文件尾
+    for(PushOutput* output : mOutputs) {
+        if(mAbort) {
+            output->Stop();
+        } else {
+            output->Finish();
         }
-        avformat_free_context(outputFormatContext);
     }
+    return !mAbort;
+}
 
-    if(NULL != inputFormatContext) {
-        avformat_close_input(&inputFormatContext);
+void VideoSender::Stop() {
+    mAbort = true;
+}
+
+void VideoSender::Close() {
+    for(PushOutput* output : mOutputs) {
+        delete output;
     }
+    mOutputs.clear();
 
+    if(NULL != mInputFormatContext) {
+        avformat_close_input(&mInputFormatContext);
+    }
+    mProbe.Clear();
+    mVideoStreamIndex = -1;
+    mTimeBases.clear();
+    mGopCache.Clear();
+}
+
+vector<OutputStats> VideoSender::GetStats() {
+    vector<OutputStats> stats;
+    for(PushOutput* output : mOutputs) {
+        stats.push_back(output->GetStats());
+    }
+    return stats;
+}
+
+int64_t VideoSender::GetInputReconnects() {
+    return mInputReconnects;
+}
+
+void VideoSender::DumpStats() {
+    cout << mSrcUrl << ": input reconnects " << mInputReconnects << endl;
+    for(const OutputStats& stats : GetStats()) {
+        cout << stats.url
+             << (stats.failed ? " failed" : (stats.connected ? " connected" : " disconnected"))
+             << ": sent " << stats.sentPackets << " packets " << stats.sentBytes << " bytes"
+             << ", dropped " << stats.droppedPackets
+             << ", bitrate " << stats.bitrateKbps << "kbps avg " << stats.avgBitrateKbps << "kbps"
+             << ", write calls " << stats.writeCalls << " (" << stats.writeCallsPerSec << "/s)"
+             << ", queue " << stats.queue.depth << "/" << stats.queue.capacity
+             << " max " << stats.queue.maxDepth << " full " << stats.queue.fullCount
+             << ", write errors " << stats.writeErrors
+             << ", reconnects " << stats.reconnects << endl;
+    }
+}
+
+bool VideoSender::Send(const string& srcUrl, const string& destUrl) {
+    return Send(srcUrl, vector<string>(1, destUrl));
+}
+
+bool VideoSender::Send(const string& srcUrl, const vector<string>& destUrls) {
+    VideoSender sender;
+    for(const string& destUrl : destUrls) {
+        sender.AddOutput(destUrl);
+    }
+
+    // 转推直播流的时候尽快开始推送
+    sender.SetFastOpen(IsNetworkUrl(srcUrl));
+
+    bool result = sender.Open(srcUrl) && sender.Run();
+    sender.DumpStats();
+    sender.Close();
     return result;
-}
\ No newline at end of file
+}
+
+int VideoSender::interruptCallback(void* context) {
+    return static_cast<VideoSender*>(context)->mAbort ? 1 : 0;
+}
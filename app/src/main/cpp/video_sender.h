@@ -1,6 +1,89 @@
+#ifndef __VIDEO_SENDER_H__
+#define __VIDEO_SENDER_H__
+
+#include <atomic>
 #include <string>
+#include <vector>
+
+#include "gop_cache.h"
+#include "push_output.h"
+#include "reconnect.h"
+#include "stream_probe.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
 
+// 推流引擎: 从一个输入读取数据包,分发给多个目的地(rtmp服务器、本地flv/ts文件等)
+// 读取线程按视频的pts控制读取速度,每个目的地在自己的线程里写入,互不影响
+// 输入是直播流的时候,断开之后会自动重连,从新连接的第一个关键帧开始继续推送,并且时间戳和断开之前保持连续
 class VideoSender {
 public:
+    VideoSender();
+    ~VideoSender();
+
+    // 需要在Run之前添加,format为空的时候根据url推测封装格式
+    // options是打开目的地url时传给协议层的参数,例如rtmp的listen
+    // rtmp目的地默认设置rtmp_chunk_size=65536,options里面有的话以options为准
+    void AddOutput(const std::string& destUrl, const std::string& format = "", const AVDictionary* options = NULL);
+
+    // 打开输入时传给协议层和解复用器的参数,需要在Open之前设置
+    // 比如本地文件可以设置mmap=1省掉每次read的系统调用,但是转推的过程中文件被截断或者重写的话进程会收到SIGBUS,
+    // 还在录制、不断变大的文件也只能读到打开时的大小,所以默认不开
+    void SetInputOption(const std::string& key, const std::string& value);
+
+    // 在H.264视频包里面插入带发送时间的SEI,播放端可以用它计算端到端延迟,见latency_stamp.h
+    void SetLatencyStamp(bool latencyStamp);
+
+    // 快速打开输入,需要在Open之前设置,见DecoderConfig::fastOpen
+    void SetFastOpen(bool fastOpen);
+
+    bool Open(const std::string& srcUrl);
+
+    // 在当前线程读取输入并分发,直到输入结束或者调用了Stop
+    bool Run();
+
+    // 可以在其他线程调用,让Run尽快返回
+    void Stop();
+
+    void Close();
+
+    std::vector<OutputStats> GetStats();
+
+    // 输入流的重连次数
+    int64_t GetInputReconnects();
+
+    void DumpStats();
+
     static bool Send(const std::string& srcUrl, const std::string& destUrl);
-};
\ No newline at end of file
+
+    static bool Send(const std::string& srcUrl, const std::vector<std::string>& destUrls);
+
+private:
+    // 直播输入最多连续重连的次数
+    static const int INPUT_RECONNECT_ATTEMPTS = 10;
+
+    std::string mSrcUrl;
+    AVFormatContext* mInputFormatContext;
+    int mVideoStreamIndex;
+    std::vector<PushOutput*> mOutputs;
+    std::atomic<bool> mAbort;
+    bool mFastOpen;
+    StreamProbe mProbe;
+    AVDictionary* mInputOptions;
+    bool mLatencyStamp;
+
+    // 第一次连接时各个轨道的time_base,重连之后的时间戳都换算到这些time_base上
+    std::vector<AVRational> mTimeBases;
+    TimestampRebaser mRebaser;
+    GopCache mGopCache;
+    std::atomic<int64_t> mInputReconnects;
+
+    bool openInput();
+
+    bool reconnectInput();
+
+    static int interruptCallback(void* context);
+};
+
+#endif
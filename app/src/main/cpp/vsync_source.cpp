@@ -0,0 +1,49 @@
+#include "vsync_source.h"
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+int64_t SystemTimeSource::Now() {
+    return av_gettime_relative();
+}
+
+void SystemTimeSource::SleepUntil(int64_t time) {
+    int64_t now = av_gettime_relative();
+    if(time > now) {
+        av_usleep(time - now);
+    }
+}
+
+TimerVsyncSource::TimerVsyncSource(TimeSource* time, double refreshRate)
+        : mTime(time),
+          mRefreshRate(refreshRate > 0 ? refreshRate : 60),
+          mStart(-1),
+          mCount(0) {
+}
+
+int64_t TimerVsyncSource::WaitForVsync() {
+    int64_t now = mTime->Now();
+    if(-1 == mStart) {
+        mStart = now;
+        mCount = 0;
+    } else {
+        // 跳过已经错过的vsync
+        mCount++;
+        while(getVsyncTime(mCount) < now) {
+            mCount++;
+        }
+    }
+
+    int64_t vsync = getVsyncTime(mCount);
+    mTime->SleepUntil(vsync);
+    return vsync + GetPeriodUs();
+}
+
+int64_t TimerVsyncSource::GetPeriodUs() {
+    return (int64_t) (1000000 / mRefreshRate + 0.5);
+}
+
+int64_t TimerVsyncSource::getVsyncTime(int64_t count) {
+    return mStart + (int64_t) (count * 1000000 / mRefreshRate + 0.5);
+}
@@ -0,0 +1,79 @@
+#ifndef __VSYNC_SOURCE_H__
+#define __VSYNC_SOURCE_H__
+
+#include <stdint.h>
+
+// 时间来源,单位微秒,时间基准和av_gettime_relative一样
+// VsyncSource和FrameScheduler只通过它读取时间和睡眠,在linux上可以换成ManualTimeSource,不用真的等待就能模拟几分钟的播放
+class TimeSource {
+public:
+    virtual ~TimeSource() {}
+
+    virtual int64_t Now() = 0;
+    virtual void SleepUntil(int64_t time) = 0;
+};
+
+// av_gettime_relative + av_usleep
+class SystemTimeSource : public TimeSource {
+public:
+    int64_t Now() override;
+    void SleepUntil(int64_t time) override;
+};
+
+// 手动推进的时间,SleepUntil直接把时间跳到指定的时间点,只能在一个线程里面使用
+class ManualTimeSource : public TimeSource {
+public:
+    explicit ManualTimeSource(int64_t now = 0) : mNow(now) {
+    }
+
+    int64_t Now() override {
+        return mNow;
+    }
+
+    void SleepUntil(int64_t time) override {
+        if(time > mNow) {
+            mNow = time;
+        }
+    }
+
+    // 模拟渲染等操作的耗时
+    void Advance(int64_t us) {
+        mNow += us;
+    }
+
+private:
+    int64_t mNow;
+};
+
+// 屏幕刷新信号,安卓上由ChoreographerVsyncSource实现
+class VsyncSource {
+public:
+    virtual ~VsyncSource() {}
+
+    // 阻塞到下一个vsync,返回这个时候开始渲染的画面实际显示到屏幕上的时间
+    // 渲染花的时间太长错过了vsync的话,直接等到之后的下一个,不会一口气补回来
+    virtual int64_t WaitForVsync() = 0;
+
+    // 刷新周期,单位微秒
+    virtual int64_t GetPeriodUs() = 0;
+};
+
+// 按照固定的刷新率用定时器模拟的vsync,vsync的时间都是相对第一次调用计算的,不会因为睡眠不准而累积误差
+// 画面在下一个vsync的时候才显示出来(双缓冲),所以WaitForVsync返回的是等到的vsync再加一个周期
+class TimerVsyncSource : public VsyncSource {
+public:
+    TimerVsyncSource(TimeSource* time, double refreshRate);
+
+    int64_t WaitForVsync() override;
+    int64_t GetPeriodUs() override;
+
+private:
+    TimeSource* mTime;
+    double mRefreshRate;
+    int64_t mStart;
+    int64_t mCount;
+
+    int64_t getVsyncTime(int64_t count);
+};
+
+#endif
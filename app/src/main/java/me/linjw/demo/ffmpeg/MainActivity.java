@@ -2,11 +2,14 @@ package me.linjw.demo.ffmpeg;
 
 import androidx.appcompat.app.AppCompatActivity;
 
+import android.content.SharedPreferences;
+import android.content.pm.PackageManager;
 import android.graphics.SurfaceTexture;
 import android.opengl.EGL14;
 import android.opengl.GLES20;
 import android.os.Bundle;
 import android.os.FileUtils;
+import android.os.SystemClock;
 import android.util.Log;
 import android.view.Surface;
 import android.view.TextureView;
@@ -19,8 +22,15 @@ import java.io.OutputStream;
 import me.linjw.demo.ffmpeg.databinding.ActivityMainBinding;
 
 public class MainActivity extends AppCompatActivity {
+    private static final String TAG = "FFmpegDemo";
+
+    // System.loadLibrary的耗时,库越小、依赖的so越少加载越快
+    private static final long sLoadLibraryUs;
+
     static {
+        long start = SystemClock.elapsedRealtimeNanos();
         System.loadLibrary("ffmpegdemo");
+        sLoadLibraryUs = (SystemClock.elapsedRealtimeNanos() - start) / 1000;
     }
 
     //需要自己搭建rtmp服务器
@@ -34,6 +44,7 @@ public class MainActivity extends AppCompatActivity {
         super.onCreate(savedInstanceState);
         binding = ActivityMainBinding.inflate(getLayoutInflater());
         setContentView(binding.getRoot());
+        logLoadLibraryCost();
 
         File file = new File(getFilesDir(), "video.flv");
 
@@ -42,7 +53,7 @@ public class MainActivity extends AppCompatActivity {
             OutputStream os = new FileOutputStream(file);
             FileUtils.copy(is, os);
         } catch (Exception e) {
-            Log.d("FFmpegDemo", "err", e);
+            Log.d(TAG, "err", e);
         }
 
         new Thread(new Runnable() {
@@ -59,7 +70,7 @@ public class MainActivity extends AppCompatActivity {
                 new Thread(new Runnable() {
                     @Override
                     public void run() {
-                        play("rtmp://" + SERVER_IP + "/live/livestream", new Surface(surface), width, height);
+                        play("rtmp://" + SERVER_IP + "/live/livestream", new Surface(surface), width, height, true);
                     }
                 }).start();
             }
@@ -82,7 +93,52 @@ public class MainActivity extends AppCompatActivity {
 
     }
 
+    // 打印加载native库的耗时,并且和上一次安装的apk对比,用来评估组件白名单和静态链接的效果
+    // 只对比安装之后第一次启动的耗时,之后的启动so已经在page cache里面,耗时会小很多
+    private void logLoadLibraryCost() {
+        long installTime;
+        try {
+            installTime = getPackageManager().getPackageInfo(getPackageName(), 0).lastUpdateTime;
+        } catch (PackageManager.NameNotFoundException e) {
+            return;
+        }
+
+        SharedPreferences prefs = getSharedPreferences("load_library", MODE_PRIVATE);
+        if (prefs.getLong("install_time", 0) == installTime) {
+            Log.d(TAG, "loadLibrary cost " + sLoadLibraryUs + "us");
+            return;
+        }
+
+        long lastCost = prefs.getLong("first_launch_cost", -1);
+        prefs.edit()
+                .putLong("install_time", installTime)
+                .putLong("first_launch_cost", sLoadLibraryUs)
+                .apply();
+        if (lastCost < 0) {
+            Log.d(TAG, "loadLibrary cost " + sLoadLibraryUs + "us (first launch)");
+        } else {
+            Log.d(TAG, "loadLibrary cost " + sLoadLibraryUs + "us (first launch), last install "
+                    + lastCost + "us, delta " + (sLoadLibraryUs - lastCost) + "us");
+        }
+    }
+
     public native void send(String srcFile, String destUrl);
 
-    public native void play(String url, Surface surface, int width, int height);
+    // hardware为true时优先使用MediaCodec硬解,硬解打开失败会自动回退到软解
+    public native void play(String url, Surface surface, int width, int height, boolean hardware);
+
+    // 跳到timeUs(微秒)播放,accurate为false时跳到之前最近的关键帧,速度更快但位置不精确
+    // 只有正在播放的本地文件或者点播流可以seek
+    public native boolean seek(long timeUs, boolean accurate);
+
+    // 直播低延迟模式的目标延迟(毫秒),最小500ms,0代表关闭,默认1000ms,下一次play的时候生效
+    // 缓冲的数据超过目标延迟的时候会稍微加快播放速度追赶,落后太多的时候直接跳到下一个关键帧
+    public native void setLiveTargetLatency(long timeMs);
+
+    // 正在播放的直播流的{当前延迟(毫秒), 缓冲的数据包数量},没有在播放的时候返回null
+    public native long[] getLiveStats();
+
+    // 在视频里面均匀地取count张宽度为width的jpeg缩略图,只解码关键帧,取失败的位置是null
+    // 会阻塞到所有缩略图都取完,不要在主线程调用
+    public native byte[][] extractThumbnails(String url, int count, int width);
 }
\ No newline at end of file
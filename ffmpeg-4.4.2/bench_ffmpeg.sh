@@ -0,0 +1,87 @@
+#!/bin/bash
+# 在开发机上分别用small和fast两种配置编译FFmpeg,用同一个视频跑ffmpeg_bench --mode decode,对比解码速度
+# 用法: ./bench_ffmpeg.sh <视频文件> [ffmpeg_bench的其他参数,比如--threads 1]
+# 两种配置和build_ffmpeg.sh里面的一致,只是目标平台换成了本机,而且只编译benchmark需要的组件,几分钟就能编译完
+# x86的汇编需要nasm,没有安装的话fast配置只有内联汇编,对比出来的差距会比安卓上小
+SRC=$(cd $(dirname $0); pwd)
+OUTPUT=$SRC/host
+BENCH_SRC=$SRC/../app/src/main/cpp
+JOBS=$(nproc)
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <video> [ffmpeg_bench options]"
+    exit 1
+fi
+VIDEO=$1
+shift
+
+COMPONENTS="\
+    --disable-everything \
+    --enable-decoder=h264,hevc,mpeg4,h263,flv,aac,mp3 \
+    --enable-parser=h264,hevc,mpeg4video,h263,aac,mpegaudio \
+    --enable-demuxer=flv,live_flv,mov,mpegts,h264,hevc \
+    --enable-muxer=flv \
+    --enable-protocol=file,rtmp,tcp"
+
+function build_host
+{
+PROFILE=$1
+case $PROFILE in
+fast)
+    PROFILE_FLAGS="--optflags=${OPTFLAGS:--O3}"
+    if ! command -v nasm > /dev/null; then
+        PROFILE_FLAGS="$PROFILE_FLAGS --disable-x86asm"
+    fi
+    ;;
+small)
+    PROFILE_FLAGS="--enable-small --disable-asm --optflags=-Os"
+    ;;
+esac
+
+# 源码目录里面有给安卓生成的config.h,FFmpeg不允许这种情况下在其他目录编译,所以拷贝一份源码
+echo "Build host FFmpeg($PROFILE)..."
+rm -rf $OUTPUT/build-$PROFILE
+mkdir -p $OUTPUT/build-$PROFILE
+(cd $SRC && tar cf - --exclude=./host --exclude=./android .) | (cd $OUTPUT/build-$PROFILE && tar xf -)
+# 仓库里的源码删掉了doc目录,但是顶层Makefile还会include里面的Makefile,--disable-doc的时候放两个空文件就可以
+if [ ! -f $OUTPUT/build-$PROFILE/doc/Makefile ]; then
+    mkdir -p $OUTPUT/build-$PROFILE/doc/examples
+    touch $OUTPUT/build-$PROFILE/doc/Makefile $OUTPUT/build-$PROFILE/doc/examples/Makefile
+fi
+(cd $OUTPUT/build-$PROFILE && ./configure \
+    --prefix=$OUTPUT/$PROFILE \
+    $PROFILE_FLAGS \
+    $COMPONENTS \
+    --enable-shared \
+    --disable-static \
+    --disable-programs \
+    --disable-doc \
+    --disable-avdevice \
+    --disable-avfilter \
+    --disable-swscale \
+    --disable-postproc \
+    && make -j $JOBS && make install) > $OUTPUT/build-$PROFILE.log 2>&1 || {
+    echo "build FFmpeg($PROFILE) failed, see $OUTPUT/build-$PROFILE.log"
+    exit 1
+}
+
+PKG_CONFIG_PATH=$OUTPUT/$PROFILE/lib/pkgconfig cmake -S $BENCH_SRC -B $OUTPUT/bench-$PROFILE > /dev/null \
+    && cmake --build $OUTPUT/bench-$PROFILE -j $JOBS > /dev/null || {
+    echo "build ffmpeg_bench($PROFILE) failed"
+    exit 1
+}
+}
+
+function run_bench
+{
+PROFILE=$1
+shift
+echo "==== $PROFILE ===="
+LD_LIBRARY_PATH=$OUTPUT/$PROFILE/lib $OUTPUT/bench-$PROFILE/ffmpeg_bench --mode decode "$@" $VIDEO \
+    | grep -E "decoder:|frame latency|fps"
+}
+
+build_host small
+build_host fast
+run_bench small "$@"
+run_bench fast "$@"
@@ -1,30 +1,92 @@
 #!/bin/bash
+# 用法: ./build_ffmpeg.sh [fast|small] [abi...]
+#   fast(默认): 打开NEON/x86汇编,-O3优化,解码速度是small的好几倍
+#   small:      --disable-asm --enable-small -Os,库最小但是所有SIMD代码都被去掉了,只适合对包大小极度敏感的场景
+# 环境变量:
+#   ENABLE_SMALL=1  fast配置也加上--enable-small(去掉一些查找表、用更小的代码实现),汇编仍然保留
+#   OPTFLAGS        fast配置的优化选项,默认-O3
+#   CHECKASM=1      额外编译tests/checkasm,连接了adb设备的话推到设备上运行,校验汇编代码的结果和C实现一致
+#   COMPONENTS=xxx  只编译components/xxx.txt里面列出的组件,比如COMPONENTS=player,不设置的话编译所有组件
+#   LINK=static     编译成带-ffunction-sections和LTO的静态库,CMake加上-DFFMPEG_STATIC=ON之后链接进libffmpegdemo.so
+# 编译结果放在android/<配置>[-<组件白名单>][-static]下面,不同的配置可以同时保留,方便对比
 API=21
 NDK=/Users/linjw/Library/Android/sdk/ndk/21.1.6352462
 TOOLCHAIN=$NDK/toolchains/llvm/prebuilt/darwin-x86_64
-OUTPUT=$(pwd)/android
+PROFILE=${1:-fast}
+VARIANT=$PROFILE
 ABIS=(armeabi-v7a arm64-v8a x86 x86_64)
+if [ $# -gt 1 ]; then
+    ABIS=(${@:2})
+fi
 
 SYSROOT=$TOOLCHAIN/sysroot
 
-function build
+case $PROFILE in
+fast)
+    PROFILE_FLAGS="--optflags=${OPTFLAGS:--O3}"
+    if [ "$ENABLE_SMALL" == "1" ]; then
+        PROFILE_FLAGS="$PROFILE_FLAGS --enable-small"
+    fi
+    ;;
+small)
+    PROFILE_FLAGS="--enable-small --disable-asm --optflags=-Os"
+    ;;
+*)
+    echo "unknown profile $PROFILE, use fast or small"
+    exit 1
+    ;;
+esac
+
+# 白名单里面每行一个configure选项,前面加上--disable-everything之后只会编译列出来的组件
+if [ -n "$COMPONENTS" ]; then
+    COMPONENTS_FILE=$(pwd)/components/$COMPONENTS.txt
+    if [ ! -f $COMPONENTS_FILE ]; then
+        echo "components file $COMPONENTS_FILE not found"
+        exit 1
+    fi
+    COMPONENT_FLAGS="--disable-everything $(grep -v '^\s*#' $COMPONENTS_FILE | xargs)"
+    VARIANT=$VARIANT-$COMPONENTS
+fi
+
+case ${LINK:-shared} in
+shared)
+    LINK_FLAGS="--enable-shared --disable-static"
+    LIB_DIR=jniLibs
+    ;;
+static)
+    # 每个函数和变量放在单独的段里面,链接libffmpegdemo.so的时候--gc-sections可以把用不到的代码去掉
+    # LTO编译出来的.o是bitcode,只能用llvm-ar打包,链接也要用lld
+    LINK_FLAGS="--enable-static --disable-shared --enable-pic --enable-lto --ar=$TOOLCHAIN/bin/llvm-ar --ranlib=$TOOLCHAIN/bin/llvm-ranlib --nm=$TOOLCHAIN/bin/llvm-nm"
+    LINK_CFLAGS="-ffunction-sections -fdata-sections"
+    LINK_LDFLAGS="-fuse-ld=lld"
+    LIB_DIR=staticLibs
+    VARIANT=$VARIANT-static
+    ;;
+*)
+    echo "unknown link type $LINK, use shared or static"
+    exit 1
+    ;;
+esac
+
+OUTPUT=$(pwd)/android/$VARIANT
+BASELINE=$(pwd)/android/$PROFILE
+
+function configure_ffmpeg
 {
-echo "Build FFmpeg for $CPU..."
 ./configure \
     --prefix=$PREFIX \
-    --enable-small \
-    --enable-shared \
+    $PROFILE_FLAGS \
+    $COMPONENT_FLAGS \
+    $ABI_FLAGS \
     --enable-neon \
     --enable-jni \
     --enable-mediacodec \
     --enable-decoder=h264_mediacodec \
     --enable-hwaccel=h264_mediacodec \
     --enable-cross-compile \
-    --disable-static \
     --disable-gpl \
     --disable-postproc \
     --disable-programs \
-    --disable-asm \
     --disable-ffmpeg \
     --disable-ffplay \
     --disable-ffprobe \
@@ -39,11 +101,54 @@ echo "Build FFmpeg for $CPU..."
     --cc=$CC \
     --cxx=$CXX \
     --sysroot=$SYSROOT \
-    --extra-cflags="-Os -fpic $OPTIMIZE_CFLAGS" 
+    --extra-cflags="-fpic $OPTIMIZE_CFLAGS $LINK_CFLAGS" \
+    --extra-ldflags="$LINK_LDFLAGS" \
+    "$@"
+}
+
+function build
+{
+echo "Build FFmpeg($VARIANT) for $CPU..."
+configure_ffmpeg $LINK_FLAGS
 make clean
 make -j 8
 make install
-echo "Buld FFmpeg for $CPU success"
+echo "Buld FFmpeg($VARIANT) for $CPU success"
+
+if [ "$CHECKASM" == "1" ]; then
+    checkasm
+fi
+}
+
+# checkasm链接的是静态库,所以要用静态库重新编译一次
+# 它会用随机数据分别调用每个汇编函数和对应的C实现,比较结果是否一致,同时检查有没有破坏callee-saved寄存器
+function checkasm
+{
+echo "Build checkasm for $CPU..."
+configure_ffmpeg --enable-static --disable-shared
+make clean
+make -j 8 checkasm
+mkdir -p $OUTPUT/checkasm/$ABI
+cp tests/checkasm/checkasm $OUTPUT/checkasm/$ABI/
+make clean
+
+# 只能在支持这个ABI的设备上运行,比如arm64的手机也可以跑armeabi-v7a
+if ! command -v adb > /dev/null || ! adb get-state > /dev/null 2>&1; then
+    echo "no adb device, checkasm for $ABI saved to $OUTPUT/checkasm/$ABI"
+    return
+fi
+if [[ "$(adb shell getprop ro.product.cpu.abilist)" != *"$ABI"* ]]; then
+    echo "device doesn't support $ABI, skip running checkasm"
+    return
+fi
+adb push $OUTPUT/checkasm/$ABI/checkasm /data/local/tmp/checkasm-$ABI > /dev/null
+adb shell chmod 755 /data/local/tmp/checkasm-$ABI
+if adb shell /data/local/tmp/checkasm-$ABI; then
+    echo "checkasm for $ABI passed"
+else
+    echo "checkasm for $ABI FAILED"
+    exit 1
+fi
 }
 
 function build_armeabi-v7a
@@ -55,7 +160,9 @@ CXX=$TOOLCHAIN/bin/armv7a-linux-androideabi$API-clang++
 SYSROOT=$TOOLCHAIN/sysroot
 CROSS_PREFIX=$TOOLCHAIN/bin/arm-linux-androideabi-
 PREFIX=$OUTPUT/armeabi-v7a
-OPTIMIZE_CFLAGS="-mfloat-abi=softfp -mfpu=vfp -marm -march=$CPU "
+# 之前是-mfpu=vfp,编译器不能生成NEON指令,FFmpeg的NEON汇编也依赖neon的fpu
+OPTIMIZE_CFLAGS="-mfloat-abi=softfp -mfpu=neon -marm -march=$CPU "
+ABI_FLAGS=""
 build
 }
 
@@ -69,6 +176,7 @@ SYSROOT=$TOOLCHAIN/sysroot
 CROSS_PREFIX=$TOOLCHAIN/bin/aarch64-linux-android-
 PREFIX=$OUTPUT/arm64-v8a
 OPTIMIZE_CFLAGS="-march=$CPU"
+ABI_FLAGS=""
 build
 }
 
@@ -82,6 +190,9 @@ SYSROOT=$TOOLCHAIN/sysroot
 CROSS_PREFIX=$TOOLCHAIN/bin/i686-linux-android-
 PREFIX=$OUTPUT/x86
 OPTIMIZE_CFLAGS="-march=i686 -mtune=intel -mssse3 -mfpmath=sse -m32"
+# 32位x86的汇编里有不是位置无关的代码,编译成so会产生text relocation,安卓6.0以上会拒绝加载
+# 所以只关闭独立的nasm汇编,内联汇编和编译器的向量化仍然保留
+ABI_FLAGS="--disable-x86asm"
 build
 }
 
@@ -95,27 +206,64 @@ SYSROOT=$TOOLCHAIN/sysroot
 CROSS_PREFIX=$TOOLCHAIN/bin/x86_64-linux-android-
 PREFIX=$OUTPUT/x86_64
 OPTIMIZE_CFLAGS="-march=$CPU -msse4.2 -mpopcnt -m64 -mtune=intel"
+# x86_64的汇编需要nasm
+ABI_FLAGS=""
 build
 }
 
 function merge_output
 {
     ABI=${1}
-    ABI_OS_DIR=$OUTPUT/jniLibs/$ABI
+    ABI_OS_DIR=$OUTPUT/$LIB_DIR/$ABI
 
     rm -rf $ABI_OS_DIR
     mkdir -p $ABI_OS_DIR
-    cp -rf $OUTPUT/$ABI/lib/*.so $ABI_OS_DIR/
+    if [ "$LIB_DIR" == "jniLibs" ]; then
+        cp -rf $OUTPUT/$ABI/lib/*.so $ABI_OS_DIR/
+    else
+        cp -rf $OUTPUT/$ABI/lib/*.a $ABI_OS_DIR/
+    fi
 
     rm -rf $OUTPUT/include
     cp -r $OUTPUT/$ABI/include $OUTPUT/include
 }
 
-rm -rf $OUTPUT/jniLibs
-mkdir -p $OUTPUT/jniLibs
+function dir_size
+{
+    du -cb $@ 2> /dev/null | tail -1 | cut -f1
+}
+
+# 打印每个ABI的库大小,和没有白名单的完整编译(android/<配置>)对比
+# 静态库里面是LTO的bitcode,大小没有参考意义,最终的大小要看CMake链接出来的libffmpegdemo.so,编译app的时候会打印出来
+# 加载耗时在app启动的时候打印,MainActivity会和上一次安装的版本对比
+function report_size
+{
+    ABI=${1}
+    SIZE=$(dir_size $OUTPUT/$LIB_DIR/$ABI/*)
+    if [ "$LIB_DIR" != "jniLibs" ]; then
+        echo "$ABI: static libs $SIZE bytes, see the CMake build for the size of libffmpegdemo.so"
+        return
+    fi
+
+    if [ "$OUTPUT" == "$BASELINE" ] || [ ! -d $BASELINE/jniLibs/$ABI ]; then
+        echo "$ABI: $SIZE bytes"
+        return
+    fi
+    BASELINE_SIZE=$(dir_size $BASELINE/jniLibs/$ABI/*)
+    echo "$ABI: $SIZE bytes, $PROFILE: $BASELINE_SIZE bytes, delta $((SIZE - BASELINE_SIZE)) bytes"
+}
+
+rm -rf $OUTPUT/$LIB_DIR
+mkdir -p $OUTPUT/$LIB_DIR
 
 for ABI in ${ABIS[@]}
 do
     eval build_$ABI
     merge_output $ABI
+done
+
+echo "FFmpeg($VARIANT) size:"
+for ABI in ${ABIS[@]}
+do
+    report_size $ABI
 done
\ No newline at end of file
@@ -34,7 +34,9 @@
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "url.h"
+#include <stdatomic.h>
 #include <stdint.h>
 
 #if HAVE_UNISTD_H
@@ -44,6 +46,7 @@
 #define BUFFER_CAPACITY         (4 * 1024 * 1024)
 #define READ_BACK_CAPACITY      (4 * 1024 * 1024)
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
+#define READ_SIZE               (32 * 1024)
 
 typedef struct RingBuffer
 {
@@ -63,9 +66,16 @@ typedef struct Context {
     int             seek_completed;
     int64_t         seek_ret;
 
-    int             inner_io_error;
+    int             seek_by_time;
+    int             seek_stream_index;
+    int64_t         seek_timestamp;
+    int             seek_flags;
+
     int             io_error;
     int             io_eof_reached;
+    int             refill_paused;
+    int             refill_level;
+    uint8_t        *read_buf;
 
     int64_t         logical_pos;
     int64_t         logical_size;
@@ -78,6 +88,17 @@ typedef struct Context {
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    /* options */
+    int             read_ahead_size;
+    int             read_back_size;
+    int             low_watermark;
+
+    /* statistics, exported as read-only options; atomic because they are
+     * read through av_opt_get_int() without holding the mutex */
+    atomic_int_least64_t fill_level;
+    atomic_int_least64_t stall_count;
+    atomic_int_least64_t stall_time;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -161,18 +182,6 @@ static int async_check_interrupt(void *arg)
     return c->abort_request;
 }
 
-static int wrapped_url_read(void *src, void *dst, int size)
-{
-    URLContext *h   = src;
-    Context    *c   = h->priv_data;
-    int         ret;
-
-    ret = ffurl_read(c->inner, dst, size);
-    c->inner_io_error = ret < 0 ? ret : 0;
-
-    return ret;
-}
-
 static void *async_buffer_task(void *arg)
 {
     URLContext   *h    = arg;
@@ -194,11 +203,17 @@ static void *async_buffer_task(void *arg)
         }
 
         if (c->seek_request) {
-            seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
+            if (c->seek_by_time)
+                seek_ret = c->inner->prot->url_read_seek(c->inner, c->seek_stream_index,
+                                                         c->seek_timestamp, c->seek_flags);
+            else
+                seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
             if (seek_ret >= 0) {
                 c->io_eof_reached = 0;
                 c->io_error       = 0;
+                c->refill_paused  = 0;
                 ring_reset(ring);
+                atomic_store_explicit(&c->fill_level, 0, memory_order_relaxed);
             }
 
             c->seek_completed = 1;
@@ -211,8 +226,15 @@ static void *async_buffer_task(void *arg)
             continue;
         }
 
+        /* Once the buffer is full, wait until the reader has drained it to
+         * the low watermark before refilling, so that the reader and this
+         * thread don't wake each other up for every few KB consumed. */
         fifo_space = ring_space(ring);
-        if (c->io_eof_reached || fifo_space <= 0) {
+        if (fifo_space <= 0)
+            c->refill_paused = 1;
+        else if (c->refill_paused && ring_size(ring) <= c->refill_level)
+            c->refill_paused = 0;
+        if (c->io_eof_reached || fifo_space <= 0 || c->refill_paused) {
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
             pthread_mutex_unlock(&c->mutex);
@@ -220,14 +242,19 @@ static void *async_buffer_task(void *arg)
         }
         pthread_mutex_unlock(&c->mutex);
 
-        to_copy = FFMIN(4096, fifo_space);
-        ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+        /* A single read, so that whatever has arrived on a live stream is
+         * handed to the reader right away instead of after a full block. */
+        to_copy = FFMIN(READ_SIZE, fifo_space);
+        ret = ffurl_read(c->inner, c->read_buf, to_copy);
 
         pthread_mutex_lock(&c->mutex);
-        if (ret <= 0) {
+        if (ret > 0) {
+            ring_generic_write(ring, c->read_buf, ret, NULL);
+            atomic_store_explicit(&c->fill_level, ring_size(ring), memory_order_relaxed);
+        } else {
             c->io_eof_reached = 1;
-            if (c->inner_io_error < 0)
-                c->io_error = c->inner_io_error;
+            if (ret < 0)
+                c->io_error = ret;
         }
 
         pthread_cond_signal(&c->cond_wakeup_main);
@@ -245,9 +272,19 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    ret = ring_init(&c->ring, c->read_ahead_size, c->read_back_size);
     if (ret < 0)
         goto fifo_fail;
+    c->refill_level = (int64_t)c->read_ahead_size * c->low_watermark / 100;
+    atomic_init(&c->fill_level,  0);
+    atomic_init(&c->stall_count, 0);
+    atomic_init(&c->stall_time,  0);
+
+    c->read_buf = av_malloc(READ_SIZE);
+    if (!c->read_buf) {
+        ret = AVERROR(ENOMEM);
+        goto url_fail;
+    }
 
     /* wrap interrupt callback */
     c->interrupt_callback = h->interrupt_callback;
@@ -299,6 +336,7 @@ cond_wakeup_main_fail:
 mutex_fail:
     ffurl_closep(&c->inner);
 url_fail:
+    av_freep(&c->read_buf);
     ring_destroy(&c->ring);
 fifo_fail:
     return ret;
@@ -322,6 +360,7 @@ static int async_close(URLContext *h)
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_mutex_destroy(&c->mutex);
     ffurl_closep(&c->inner);
+    av_freep(&c->read_buf);
     ring_destroy(&c->ring);
 
     return 0;
@@ -334,6 +373,7 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
     RingBuffer   *ring    = &c->ring;
     int           to_read = size;
     int           ret     = 0;
+    int64_t       stall_start = 0;
 
     pthread_mutex_lock(&c->mutex);
 
@@ -363,12 +403,22 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
                     ret = AVERROR_EOF;
             }
             break;
+        } else if (!stall_start) {
+            /* nothing buffered, the reader has to wait for the network */
+            stall_start = av_gettime_relative();
         }
         pthread_cond_signal(&c->cond_wakeup_background);
         pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
     }
 
-    pthread_cond_signal(&c->cond_wakeup_background);
+    if (stall_start) {
+        atomic_fetch_add_explicit(&c->stall_count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&c->stall_time, av_gettime_relative() - stall_start,
+                                  memory_order_relaxed);
+    }
+    atomic_store_explicit(&c->fill_level, ring_size(ring), memory_order_relaxed);
+    if (ring_size(ring) <= c->refill_level)
+        pthread_cond_signal(&c->cond_wakeup_background);
     pthread_mutex_unlock(&c->mutex);
 
     return ret;
@@ -466,13 +516,63 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
     return ret;
 }
 
+static int64_t async_read_seek(URLContext *h, int stream_index,
+                               int64_t timestamp, int flags)
+{
+    Context *c = h->priv_data;
+    int64_t  ret;
+
+    if (!c->inner->prot->url_read_seek)
+        return AVERROR(ENOSYS);
+
+    /* the inner protocol is only accessed from the background thread */
+    pthread_mutex_lock(&c->mutex);
+
+    c->seek_request      = 1;
+    c->seek_by_time      = 1;
+    c->seek_stream_index = stream_index;
+    c->seek_timestamp    = timestamp;
+    c->seek_flags        = flags;
+    c->seek_completed    = 0;
+    c->seek_ret          = 0;
+
+    while (1) {
+        if (async_check_interrupt(h)) {
+            /* drop the pending request as well, otherwise the background
+             * thread would later run it as a byte seek to seek_pos */
+            c->seek_request = 0;
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (c->seek_completed) {
+            ret = c->seek_ret;
+            break;
+        }
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+    c->seek_by_time = 0;
+
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
 #define OFFSET(x) offsetof(Context, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
 
 static const AVOption options[] = {
+    { "read_ahead_size", "Size of the buffer filled ahead of the reader by the I/O thread", OFFSET(read_ahead_size), AV_OPT_TYPE_INT, { .i64 = BUFFER_CAPACITY }, 4096, INT_MAX / 2, D },
+    { "read_back_size", "Size of the data kept behind the reader for short backward seeks", OFFSET(read_back_size), AV_OPT_TYPE_INT, { .i64 = READ_BACK_CAPACITY }, 0, INT_MAX / 2, D },
+    { "low_watermark", "Percentage of read_ahead_size below which a full buffer is refilled", OFFSET(low_watermark), AV_OPT_TYPE_INT, { .i64 = 50 }, 0, 100, D },
+    { "fill_level", "Number of bytes buffered ahead of the reader", OFFSET(fill_level), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "stall_count", "Number of reads that had to wait for the network", OFFSET(stall_count), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "stall_time", "Total time in microseconds reads waited for the network", OFFSET(stall_time), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
     {NULL},
 };
 
+#undef E
 #undef D
 #undef OFFSET
 
@@ -488,6 +588,7 @@ const URLProtocol ff_async_protocol = {
     .url_open2           = async_open,
     .url_read            = async_read,
     .url_seek            = async_seek,
+    .url_read_seek       = async_read_seek,
     .url_close           = async_close,
     .priv_data_size      = sizeof(Context),
     .priv_data_class     = &async_context_class,
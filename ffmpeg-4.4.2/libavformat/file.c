@@ -34,6 +34,9 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
@@ -74,9 +77,17 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_MMAP
+    uint8_t *map;       ///< whole file mapped for reading, NULL when read() is used
+    int64_t map_size;
+    int64_t pos;        ///< read position in the mapping
+    int64_t advised;    ///< end of the range already requested with MADV_WILLNEED
+    int page_size;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -84,6 +95,9 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map regular files into memory for reading instead of calling read(). "
+              "The file must not be truncated while open (SIGBUS), and a growing file is only read up to its size at open time",
+      offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -106,11 +120,88 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_MMAP
+/* how far ahead of the read position pages are requested from the kernel */
+#define MMAP_READ_AHEAD (2 * 1024 * 1024)
+
+/* madvise() is hidden by the strict POSIX mode on glibc, while bionic only
+ * has posix_madvise() since API level 23 */
+#if defined(MADV_SEQUENTIAL)
+#define file_madvise(addr, len, advice) madvise(addr, len, MADV_ ## advice)
+#elif defined(POSIX_MADV_SEQUENTIAL)
+#define file_madvise(addr, len, advice) posix_madvise(addr, len, POSIX_MADV_ ## advice)
+#else
+#define file_madvise(addr, len, advice) 0
+#endif
+
+static int file_open_mmap(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    void *map;
+
+    /* the whole file has to fit into the address space, which mostly
+     * matters for 32-bit systems; fall back to read() otherwise */
+    if (!S_ISREG(st->st_mode) || st->st_size <= 0 ||
+        (uint64_t)st->st_size > SIZE_MAX / 2)
+        return AVERROR(ENOSYS);
+
+    /* the mapping covers the size at open time only, and accessing pages
+     * past the end of a file truncated afterwards raises SIGBUS, so this
+     * is only suitable for files that don't change while being read */
+    map = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (map == MAP_FAILED) {
+        av_log(h, AV_LOG_VERBOSE, "mmap failed: %s, using read()\n",
+               av_err2str(AVERROR(errno)));
+        return AVERROR(errno);
+    }
+
+    /* sequential access lets the kernel read ahead aggressively and drop
+     * the pages behind the read position early */
+    file_madvise(map, st->st_size, SEQUENTIAL);
+
+    c->map       = map;
+    c->map_size  = st->st_size;
+    c->pos       = 0;
+    c->advised   = 0;
+    c->page_size = sysconf(_SC_PAGESIZE);
+    if (c->page_size <= 0)
+        c->page_size = 4096;
+    return 0;
+}
+
+static int file_read_mmap(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+
+    if (c->pos >= c->map_size)
+        return AVERROR_EOF;
+    size = FFMIN(size, c->map_size - c->pos);
+
+    /* keep requesting the pages a bit ahead, so that reading right after a
+     * seek doesn't fault in every page on its own */
+    if (c->pos + size > c->advised - MMAP_READ_AHEAD / 2) {
+        int64_t start = FFMAX(c->advised, c->pos) / c->page_size * c->page_size;
+        int64_t end   = FFMIN(c->pos + size + MMAP_READ_AHEAD, c->map_size);
+        if (end > start)
+            file_madvise(c->map + start, end - start, WILLNEED);
+        c->advised = end;
+    }
+
+    memcpy(buf, c->map + c->pos, size);
+    c->pos += size;
+    return size;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_MMAP
+    if (c->map)
+        return file_read_mmap(h, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -243,6 +334,12 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_MMAP
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !h->is_streamed && !fstat(fd, &st))
+        file_open_mmap(h, &st);
+#endif
+
     return 0;
 }
 
@@ -258,6 +355,24 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if HAVE_MMAP
+    if (c->map) {
+        if (whence == SEEK_CUR)
+            pos += c->pos;
+        else if (whence == SEEK_END)
+            pos += c->map_size;
+        else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        /* the pages at the new position have not been requested yet */
+        if (pos != c->pos)
+            c->advised = pos;
+        c->pos = pos;
+        return pos;
+    }
+#endif
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -266,6 +381,10 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
     return close(c->fd);
 }
 
@@ -1219,16 +1219,13 @@ retry_duration:
             flv->last_channels    =
             channels              = st->codecpar->channels;
         } else {
-            AVCodecParameters *par = avcodec_parameters_alloc();
-            if (!par) {
-                ret = AVERROR(ENOMEM);
-                goto leave;
-            }
-            par->sample_rate = sample_rate;
-            par->bits_per_coded_sample = bits_per_coded_sample;
-            flv_set_audio_codec(s, st, par, flags & FLV_AUDIO_CODECID_MASK);
-            sample_rate = par->sample_rate;
-            avcodec_parameters_free(&par);
+            /* only the sample rate implied by the codec id is needed here;
+             * use a scratch copy instead of allocating one for every packet */
+            AVCodecParameters par = { 0 };
+            par.sample_rate = sample_rate;
+            par.bits_per_coded_sample = bits_per_coded_sample;
+            flv_set_audio_codec(s, st, &par, flags & FLV_AUDIO_CODECID_MASK);
+            sample_rate = par.sample_rate;
         }
     } else if (stream_type == FLV_STREAM_TYPE_VIDEO) {
         int ret = flv_set_video_codec(s, st, flags & FLV_VIDEO_CODECID_MASK, 1);
@@ -148,6 +148,46 @@ int ff_rtmp_check_alloc_array(RTMPPacket **prev_pkt, int *nb_prev_pkt,
     return 0;
 }
 
+/**
+ * Create a packet received on a channel, reusing the payload buffer of the
+ * previous packet released on that channel when it is large enough. Every
+ * channel carries one kind of message (audio, video or commands), so after
+ * the first few packets the buffer fits and reassembling the following
+ * packets doesn't allocate anymore.
+ */
+static int rtmp_packet_create_reused(RTMPPacket *hist, RTMPPacket *pkt,
+                                     int channel_id, RTMPPacketType type,
+                                     int timestamp, int size)
+{
+    int ret;
+
+    if (size && hist->spare_size < size) {
+        // round up, so that slowly growing messages (e.g. the key frames
+        // of a stream) don't need a new buffer each time
+        int alloc_size = FFMAX(hist->spare_size, 1024);
+        while (alloc_size < size)
+            alloc_size *= 2;
+        av_freep(&hist->spare);
+        hist->spare = av_malloc(alloc_size);
+        if (!hist->spare) {
+            hist->spare_size = 0;
+            return AVERROR(ENOMEM);
+        }
+        hist->spare_size = alloc_size;
+    }
+
+    if ((ret = ff_rtmp_packet_create(pkt, channel_id, type, timestamp, 0)) < 0)
+        return ret;
+    pkt->size = size;
+    if (size) {
+        pkt->data        = hist->spare;
+        pkt->data_size   = hist->spare_size;
+        hist->spare      = NULL;
+        hist->spare_size = 0;
+    }
+    return 0;
+}
+
 int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
                         int chunk_size, RTMPPacket **prev_pkt, int *nb_prev_pkt)
 {
@@ -236,8 +276,9 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
     }
 
     if (!prev_pkt[channel_id].read) {
-        if ((ret = ff_rtmp_packet_create(p, channel_id, type, timestamp,
-                                         size)) < 0)
+        if ((ret = rtmp_packet_create_reused(&prev_pkt[channel_id], p,
+                                             channel_id, type, timestamp,
+                                             size)) < 0)
             return ret;
         p->read = written;
         p->offset = 0;
@@ -248,6 +289,7 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
         RTMPPacket *prev = &prev_pkt[channel_id];
         p->data          = prev->data;
         p->size          = prev->size;
+        p->data_size     = prev->data_size;
         p->channel_id    = prev->channel_id;
         p->type          = prev->type;
         p->ts_field      = prev->ts_field;
@@ -277,6 +319,7 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
     if (size > 0) {
        RTMPPacket *prev = &prev_pkt[channel_id];
        prev->data = p->data;
+       prev->data_size = p->data_size;
        prev->read = p->read;
        prev->offset = p->offset;
        p->data      = NULL;
@@ -302,19 +345,23 @@ int ff_rtmp_packet_read_internal(URLContext *h, RTMPPacket *p, int chunk_size,
     }
 }
 
-int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
-                         int chunk_size, RTMPPacket **prev_pkt_ptr,
-                         int *nb_prev_pkt)
+int ff_rtmp_packet_write_buf(URLContext *h, RTMPPacket *pkt,
+                             int chunk_size, RTMPPacket **prev_pkt_ptr,
+                             int *nb_prev_pkt, uint8_t **buf,
+                             unsigned int *buf_size)
 {
-    uint8_t pkt_hdr[16], *p = pkt_hdr;
+    uint8_t pkt_hdr[16], *p = pkt_hdr, *q;
     int mode = RTMP_PS_TWELVEBYTES;
     int off = 0;
-    int written = 0;
+    int nb_chunks, cont_size, written;
     int ret;
     RTMPPacket *prev_pkt;
     int use_delta; // flag if using timestamp delta, not RTMP_PS_TWELVEBYTES
     uint32_t timestamp; // full 32-bit timestamp or delta value
 
+    if (chunk_size <= 0)
+        return AVERROR(EINVAL);
+
     if ((ret = ff_rtmp_check_alloc_array(prev_pkt_ptr, nb_prev_pkt,
                                          pkt->channel_id)) < 0)
         return ret;
@@ -374,31 +421,48 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
     prev_pkt[pkt->channel_id].ts_field   = pkt->ts_field;
     prev_pkt[pkt->channel_id].extra      = pkt->extra;
 
-    if ((ret = ffurl_write(h, pkt_hdr, p - pkt_hdr)) < 0)
-        return ret;
-    written = p - pkt_hdr + pkt->size;
+    // serialize the header and all the chunks with their continuation headers
+    // into one buffer, so that the whole message goes out in a single write
+    // instead of one write per chunk and per continuation marker
+    nb_chunks = pkt->size > 0 ? (pkt->size + chunk_size - 1) / chunk_size : 1;
+    cont_size = 1 + (pkt->ts_field == 0xFFFFFF ? 4 : 0);
+    written   = p - pkt_hdr + pkt->size + (nb_chunks - 1) * cont_size;
+    av_fast_malloc(buf, buf_size, written);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+
+    q = *buf;
+    memcpy(q, pkt_hdr, p - pkt_hdr);
+    q += p - pkt_hdr;
     while (off < pkt->size) {
         int towrite = FFMIN(chunk_size, pkt->size - off);
-        if ((ret = ffurl_write(h, pkt->data + off, towrite)) < 0)
-            return ret;
+        memcpy(q, pkt->data + off, towrite);
+        q   += towrite;
         off += towrite;
         if (off < pkt->size) {
-            uint8_t marker = 0xC0 | pkt->channel_id;
-            if ((ret = ffurl_write(h, &marker, 1)) < 0)
-                return ret;
-            written++;
-            if (pkt->ts_field == 0xFFFFFF) {
-                uint8_t ts_header[4];
-                AV_WB32(ts_header, timestamp);
-                if ((ret = ffurl_write(h, ts_header, 4)) < 0)
-                    return ret;
-                written += 4;
-            }
+            bytestream_put_byte(&q, 0xC0 | pkt->channel_id);
+            if (pkt->ts_field == 0xFFFFFF)
+                bytestream_put_be32(&q, timestamp);
         }
     }
+
+    if ((ret = ffurl_write(h, *buf, written)) < 0)
+        return ret;
     return written;
 }
 
+int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
+                         int chunk_size, RTMPPacket **prev_pkt_ptr,
+                         int *nb_prev_pkt)
+{
+    uint8_t *buf = NULL;
+    unsigned int buf_size = 0;
+    int ret = ff_rtmp_packet_write_buf(h, pkt, chunk_size, prev_pkt_ptr,
+                                       nb_prev_pkt, &buf, &buf_size);
+    av_free(buf);
+    return ret;
+}
+
 int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
                           int timestamp, int size)
 {
@@ -408,6 +472,7 @@ int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
             return AVERROR(ENOMEM);
     }
     pkt->size       = size;
+    pkt->data_size  = size;
     pkt->channel_id = channel_id;
     pkt->type       = type;
     pkt->timestamp  = timestamp;
@@ -425,6 +490,41 @@ void ff_rtmp_packet_destroy(RTMPPacket *pkt)
     pkt->size = 0;
 }
 
+void ff_rtmp_packet_recycle(RTMPPacket *pkt, RTMPPacket *prev_pkt,
+                            int nb_prev_pkt)
+{
+    RTMPPacket *hist;
+
+    if (!pkt || !pkt->data || pkt->channel_id >= nb_prev_pkt) {
+        ff_rtmp_packet_destroy(pkt);
+        return;
+    }
+
+    // keep the larger of the two buffers
+    hist = &prev_pkt[pkt->channel_id];
+    if (pkt->data_size > hist->spare_size) {
+        av_free(hist->spare);
+        hist->spare      = pkt->data;
+        hist->spare_size = pkt->data_size;
+    } else {
+        av_free(pkt->data);
+    }
+    pkt->data = NULL;
+    pkt->size = 0;
+}
+
+void ff_rtmp_packet_history_free(RTMPPacket **prev_pkt, int *nb_prev_pkt)
+{
+    int i;
+
+    for (i = 0; i < *nb_prev_pkt; i++) {
+        ff_rtmp_packet_destroy(&(*prev_pkt)[i]);
+        av_freep(&(*prev_pkt)[i].spare);
+    }
+    av_freep(prev_pkt);
+    *nb_prev_pkt = 0;
+}
+
 static int amf_tag_skip(GetByteContext *gb)
 {
     AMFDataType type;
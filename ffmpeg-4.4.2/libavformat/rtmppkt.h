@@ -82,8 +82,11 @@ typedef struct RTMPPacket {
     uint32_t       extra;      ///< probably an additional channel ID used during streaming data
     uint8_t        *data;      ///< packet payload
     int            size;       ///< packet payload size
+    int            data_size;  ///< allocated size of data, may be larger than size for received packets
     int            offset;     ///< amount of data read so far
     int            read;       ///< amount read, including headers
+    uint8_t        *spare;     ///< payload buffer of a released packet, reused for the next packet on the channel (only in the history of read packets)
+    int            spare_size; ///< allocated size of spare
 } RTMPPacket;
 
 /**
@@ -106,6 +109,26 @@ int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
  */
 void ff_rtmp_packet_destroy(RTMPPacket *pkt);
 
+/**
+ * Release RTMP packet returned by ff_rtmp_packet_read(), keeping its payload
+ * buffer for reassembling the next packet on the same channel.
+ *
+ * @param pkt         packet
+ * @param prev_pkt    previously read packet headers for all channels
+ * @param nb_prev_pkt number of allocated elements in prev_pkt
+ */
+void ff_rtmp_packet_recycle(RTMPPacket *pkt, RTMPPacket *prev_pkt,
+                            int nb_prev_pkt);
+
+/**
+ * Free packet history, including partially read packets and the payload
+ * buffers kept for reuse.
+ *
+ * @param prev_pkt    packet history
+ * @param nb_prev_pkt number of allocated elements in prev_pkt
+ */
+void ff_rtmp_packet_history_free(RTMPPacket **prev_pkt, int *nb_prev_pkt);
+
 /**
  * Read RTMP packet sent by the server.
  *
@@ -151,6 +174,26 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *p,
                          int chunk_size, RTMPPacket **prev_pkt,
                          int *nb_prev_pkt);
 
+/**
+ * Send RTMP packet to the server with a single write, using a caller-owned
+ * buffer to assemble the header and all the chunks of the packet.
+ *
+ * @param h          reader context
+ * @param p          packet to send
+ * @param chunk_size current chunk size
+ * @param prev_pkt   previously sent packet headers for all channels
+ *                   (may be used for packet header compressing)
+ * @param nb_prev_pkt number of allocated elements in prev_pkt
+ * @param buf        serialization buffer, reallocated with av_fast_malloc()
+ *                   when it is too small and kept for subsequent calls
+ * @param buf_size   allocated size of buf
+ * @return number of bytes written on success, negative value otherwise
+ */
+int ff_rtmp_packet_write_buf(URLContext *h, RTMPPacket *p,
+                             int chunk_size, RTMPPacket **prev_pkt,
+                             int *nb_prev_pkt, uint8_t **buf,
+                             unsigned int *buf_size);
+
 /**
  * Print information and contents of RTMP packet.
  *
@@ -79,6 +79,10 @@ typedef struct RTMPContext {
     int           nb_prev_pkt[2];             ///< number of elements in prev_pkt
     int           in_chunk_size;              ///< size of the chunks incoming RTMP packets are divided into
     int           out_chunk_size;             ///< size of the chunks outgoing RTMP packets are divided into
+    int           chunk_size;                 ///< outgoing chunk size announced to the peer after the handshake, 0 to keep the default
+    uint8_t*      out_buf;                    ///< buffer the outgoing RTMP packets are serialized into
+    unsigned int  out_buf_size;               ///< allocated size of out_buf
+    int64_t       nb_writes;                  ///< number of writes to the connection, including the handshake
     int           is_input;                   ///< input/output flag
     char          *playpath;                  ///< stream identifier to play (with possible "mp4:" prefix)
     int           live;                       ///< 0: recorded, -1: live, -2: both
@@ -89,6 +93,11 @@ typedef struct RTMPContext {
     uint8_t*      flv_data;                   ///< buffer with data for demuxer
     int           flv_size;                   ///< current buffer size
     int           flv_off;                    ///< number of bytes read from current buffer
+    unsigned int  flv_alloc;                  ///< allocated size of flv_data (for input)
+    RTMPPacket    flv_pkt;                    ///< audio/video packet passed to the demuxer without copying it into flv_data
+    uint8_t       flv_pkt_header[RTMP_HEADER];///< FLV tag header generated for flv_pkt
+    uint8_t       flv_pkt_trailer[4];         ///< FLV previous tag size generated for flv_pkt
+    int           flv_pkt_off;                ///< number of bytes read from the FLV tag built around flv_pkt
     int           flv_nb_packets;             ///< number of flv packets published
     RTMPPacket    out_pkt;                    ///< rtmp packet, created from flv a/v or metadata (for output)
     uint32_t      receive_report_size;        ///< number of bytes after which we should report the number of received bytes to the peer
@@ -223,6 +232,32 @@ static void free_tracked_methods(RTMPContext *rt)
     rt->nb_tracked_methods   = 0;
 }
 
+/**
+ * Write raw data such as the handshake to the connection, and count the
+ * write.
+ */
+static int rtmp_stream_write(RTMPContext *rt, const uint8_t *buf, int size)
+{
+    int ret = ffurl_write(rt->stream, buf, size);
+    if (ret >= 0)
+        rt->nb_writes++;
+    return ret;
+}
+
+/**
+ * Write a packet to the connection with a single write from the shared
+ * output buffer, and count the write.
+ */
+static int rtmp_write_packet(RTMPContext *rt, RTMPPacket *pkt)
+{
+    int ret = ff_rtmp_packet_write_buf(rt->stream, pkt, rt->out_chunk_size,
+                                       &rt->prev_pkt[1], &rt->nb_prev_pkt[1],
+                                       &rt->out_buf, &rt->out_buf_size);
+    if (ret >= 0)
+        rt->nb_writes++;
+    return ret;
+}
+
 static int rtmp_send_packet(RTMPContext *rt, RTMPPacket *pkt, int track)
 {
     int ret;
@@ -244,8 +279,7 @@ static int rtmp_send_packet(RTMPContext *rt, RTMPPacket *pkt, int track)
             goto fail;
     }
 
-    ret = ff_rtmp_packet_write(rt->stream, pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, pkt);
 fail:
     ff_rtmp_packet_destroy(pkt);
     return ret;
@@ -490,8 +524,7 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     // we send. (We don't check for the acknowledgements currently.)
     bytestream_put_be32(&p, rt->max_sent_unacked);
     pkt.size = p - pkt.data;
-    ret = ff_rtmp_packet_write(rt->stream, &pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &pkt);
     ff_rtmp_packet_destroy(&pkt);
     if (ret < 0)
         return ret;
@@ -505,8 +538,7 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     bytestream_put_be32(&p, rt->max_sent_unacked);
     bytestream_put_byte(&p, 2); // dynamic
     pkt.size = p - pkt.data;
-    ret = ff_rtmp_packet_write(rt->stream, &pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &pkt);
     ff_rtmp_packet_destroy(&pkt);
     if (ret < 0)
         return ret;
@@ -519,8 +551,7 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     p = pkt.data;
     bytestream_put_be16(&p, 0); // 0 -> Stream Begin
     bytestream_put_be32(&p, 0); // Stream 0
-    ret = ff_rtmp_packet_write(rt->stream, &pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &pkt);
     ff_rtmp_packet_destroy(&pkt);
     if (ret < 0)
         return ret;
@@ -531,9 +562,10 @@ static int read_connect(URLContext *s, RTMPContext *rt)
         return ret;
 
     p = pkt.data;
+    if (rt->chunk_size)
+        rt->out_chunk_size = rt->chunk_size;
     bytestream_put_be32(&p, rt->out_chunk_size);
-    ret = ff_rtmp_packet_write(rt->stream, &pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &pkt);
     ff_rtmp_packet_destroy(&pkt);
     if (ret < 0)
         return ret;
@@ -567,8 +599,7 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     ff_amf_write_object_end(&p);
 
     pkt.size = p - pkt.data;
-    ret = ff_rtmp_packet_write(rt->stream, &pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &pkt);
     ff_rtmp_packet_destroy(&pkt);
     if (ret < 0)
         return ret;
@@ -582,8 +613,7 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     ff_amf_write_null(&p);
     ff_amf_write_number(&p, 8192);
     pkt.size = p - pkt.data;
-    ret = ff_rtmp_packet_write(rt->stream, &pkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &pkt);
     ff_rtmp_packet_destroy(&pkt);
 
     return ret;
@@ -927,6 +957,33 @@ static int gen_window_ack_size(URLContext *s, RTMPContext *rt)
     return rtmp_send_packet(rt, &pkt, 0);
 }
 
+/**
+ * Generate chunk size change message, send it to the server and use the
+ * new chunk size for all the following outgoing packets.
+ */
+static int gen_chunk_size(URLContext *s, RTMPContext *rt)
+{
+    RTMPPacket pkt;
+    uint8_t *p;
+    int ret;
+
+    if ((ret = ff_rtmp_packet_create(&pkt, RTMP_NETWORK_CHANNEL, RTMP_PT_CHUNK_SIZE,
+                                     0, 4)) < 0)
+        return ret;
+
+    p = pkt.data;
+    bytestream_put_be32(&p, rt->chunk_size);
+
+    if ((ret = rtmp_send_packet(rt, &pkt, 0)) < 0)
+        return ret;
+
+    rt->out_chunk_size = rt->chunk_size;
+    av_log(s, AV_LOG_DEBUG, "New outgoing chunk size = %d\n",
+           rt->out_chunk_size);
+
+    return 0;
+}
+
 /**
  * Generate check bandwidth message and send it to the server.
  */
@@ -1238,7 +1295,7 @@ static int rtmp_handshake(URLContext *s, RTMPContext *rt)
     if (client_pos < 0)
         return client_pos;
 
-    if ((ret = ffurl_write(rt->stream, tosend,
+    if ((ret = rtmp_stream_write(rt, tosend,
                            RTMP_HANDSHAKE_PACKET_SIZE + 1)) < 0) {
         av_log(s, AV_LOG_ERROR, "Cannot write RTMP handshake request\n");
         return ret;
@@ -1334,7 +1391,7 @@ static int rtmp_handshake(URLContext *s, RTMPContext *rt)
         }
 
         // write reply back to the server
-        if ((ret = ffurl_write(rt->stream, tosend,
+        if ((ret = rtmp_stream_write(rt, tosend,
                                RTMP_HANDSHAKE_PACKET_SIZE)) < 0)
             return ret;
 
@@ -1358,7 +1415,7 @@ static int rtmp_handshake(URLContext *s, RTMPContext *rt)
             }
         }
 
-        if ((ret = ffurl_write(rt->stream, serverdata + 1,
+        if ((ret = rtmp_stream_write(rt, serverdata + 1,
                                RTMP_HANDSHAKE_PACKET_SIZE)) < 0)
             return ret;
 
@@ -1400,7 +1457,7 @@ static int rtmp_send_hs_packet(RTMPContext* rt, uint32_t first_int,
 
     AV_WB32(arraydata, first_int);
     AV_WB32(arraydata + 4, second_int);
-    inoutsize = ffurl_write(rt->stream, arraydata,
+    inoutsize = rtmp_stream_write(rt, arraydata,
                             RTMP_HANDSHAKE_PACKET_SIZE);
     if (inoutsize != RTMP_HANDSHAKE_PACKET_SIZE) {
         av_log(rt, AV_LOG_ERROR, "Unable to write answer\n");
@@ -1436,7 +1493,7 @@ static int rtmp_server_handshake(URLContext *s, RTMPContext *rt)
         av_log(s, AV_LOG_ERROR, "RTMP protocol version mismatch\n");
         return AVERROR(EIO);
     }
-    if (ffurl_write(rt->stream, buffer, 1) <= 0) {                 // Send S0
+    if (rtmp_stream_write(rt, buffer, 1) <= 0) {                 // Send S0
         av_log(s, AV_LOG_ERROR,
                "Unable to write answer - RTMP S0\n");
         return AVERROR(EIO);
@@ -1499,11 +1556,12 @@ static int handle_chunk_size(URLContext *s, RTMPPacket *pkt)
         return AVERROR_INVALIDDATA;
     }
 
-    if (!rt->is_input) {
+    if (!rt->is_input && !rt->chunk_size) {
         /* Send the same chunk size change packet back to the server,
-         * setting the outgoing chunk size to the same as the incoming one. */
-        if ((ret = ff_rtmp_packet_write(rt->stream, pkt, rt->out_chunk_size,
-                                        &rt->prev_pkt[1], &rt->nb_prev_pkt[1])) < 0)
+         * setting the outgoing chunk size to the same as the incoming one.
+         * Not needed when we have announced our own chunk size, the chunk
+         * sizes of the two directions are independent. */
+        if ((ret = rtmp_write_packet(rt, pkt)) < 0)
             return ret;
         rt->out_chunk_size = AV_RB32(pkt->data);
     }
@@ -1846,8 +1904,7 @@ static int write_begin(URLContext *s)
     bytestream2_put_be16(&pbc, 0);          // 0 -> Stream Begin
     bytestream2_put_be32(&pbc, rt->nb_streamid);
 
-    ret = ff_rtmp_packet_write(rt->stream, &spkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &spkt);
 
     ff_rtmp_packet_destroy(&spkt);
 
@@ -1890,8 +1947,7 @@ static int write_status(URLContext *s, RTMPPacket *pkt,
     ff_amf_write_object_end(&pp);
 
     spkt.size = pp - spkt.data;
-    ret = ff_rtmp_packet_write(rt->stream, &spkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &spkt);
     ff_rtmp_packet_destroy(&spkt);
 
     return ret;
@@ -1998,8 +2054,7 @@ static int send_invoke_response(URLContext *s, RTMPPacket *pkt)
         }
     }
     spkt.size = pp - spkt.data;
-    ret = ff_rtmp_packet_write(rt->stream, &spkt, rt->out_chunk_size,
-                               &rt->prev_pkt[1], &rt->nb_prev_pkt[1]);
+    ret = rtmp_write_packet(rt, &spkt);
     ff_rtmp_packet_destroy(&spkt);
     return ret;
 }
@@ -2202,6 +2257,21 @@ static int update_offset(RTMPContext *rt, int size)
     return old_flv_size;
 }
 
+/**
+ * Make flv_data large enough for flv_size bytes. The buffer only grows, so
+ * once it fits the largest tag no more reallocations are needed.
+ */
+static int alloc_flv_data(RTMPContext *rt)
+{
+    uint8_t *ptr = av_fast_realloc(rt->flv_data, &rt->flv_alloc, rt->flv_size);
+    if (!ptr) {
+        rt->flv_size = rt->flv_off = 0;
+        return AVERROR(ENOMEM);
+    }
+    rt->flv_data = ptr;
+    return 0;
+}
+
 static int append_flv_data(RTMPContext *rt, RTMPPacket *pkt, int skip)
 {
     int old_flv_size, ret;
@@ -2218,10 +2288,8 @@ static int append_flv_data(RTMPContext *rt, RTMPPacket *pkt, int skip)
 
     old_flv_size = update_offset(rt, size + 15);
 
-    if ((ret = av_reallocp(&rt->flv_data, rt->flv_size)) < 0) {
-        rt->flv_size = rt->flv_off = 0;
+    if ((ret = alloc_flv_data(rt)) < 0)
         return ret;
-    }
     bytestream2_init_writer(&pbc, rt->flv_data, rt->flv_size);
     bytestream2_skip_p(&pbc, old_flv_size);
     bytestream2_put_byte(&pbc, pkt->type);
@@ -2235,6 +2303,86 @@ static int append_flv_data(RTMPContext *rt, RTMPPacket *pkt, int skip)
     return 0;
 }
 
+/**
+ * Free a received packet, keeping its payload buffer for the next packet
+ * read on the same channel.
+ */
+static void recycle_packet(RTMPContext *rt, RTMPPacket *pkt)
+{
+    ff_rtmp_packet_recycle(pkt, rt->prev_pkt[0], rt->nb_prev_pkt[0]);
+}
+
+/**
+ * Pass an audio/video packet to the demuxer without copying it. Only the
+ * FLV tag header and the trailing tag size are generated, rtmp_read()
+ * copies the payload straight from the packet into the caller's buffer.
+ * The payload buffer goes back to its channel once the tag has been read.
+ * Must only be called when flv_data has been read completely, otherwise the
+ * packet would be returned before the data in front of it.
+ *
+ * @param pkt packet to take ownership of
+ */
+static void set_flv_pkt(RTMPContext *rt, RTMPPacket *pkt)
+{
+    uint8_t *p = rt->flv_pkt_header;
+    uint32_t ts = pkt->timestamp;
+
+    if (pkt->type == RTMP_PT_AUDIO) {
+        rt->has_audio = 1;
+    } else if (pkt->type == RTMP_PT_VIDEO) {
+        rt->has_video = 1;
+    }
+
+    bytestream_put_byte(&p, pkt->type);
+    bytestream_put_be24(&p, pkt->size);
+    bytestream_put_be24(&p, ts);
+    bytestream_put_byte(&p, ts >> 24);
+    bytestream_put_be24(&p, 0);
+    AV_WB32(rt->flv_pkt_trailer, pkt->size + RTMP_HEADER);
+
+    ff_rtmp_packet_destroy(&rt->flv_pkt);
+    rt->flv_pkt     = *pkt;
+    rt->flv_pkt_off = 0;
+    pkt->data       = NULL;
+    pkt->size       = 0;
+}
+
+/**
+ * Read from the FLV tag built around flv_pkt.
+ *
+ * @return number of bytes copied into buf
+ */
+static int read_flv_pkt(RTMPContext *rt, uint8_t *buf, int size)
+{
+    int tag_size = RTMP_HEADER + rt->flv_pkt.size + 4;
+    int copied   = 0;
+
+    while (copied < size && rt->flv_pkt_off < tag_size) {
+        int off = rt->flv_pkt_off;
+        const uint8_t *src;
+        int len;
+
+        if (off < RTMP_HEADER) {
+            src = rt->flv_pkt_header + off;
+            len = RTMP_HEADER - off;
+        } else if (off < RTMP_HEADER + rt->flv_pkt.size) {
+            src = rt->flv_pkt.data + off - RTMP_HEADER;
+            len = RTMP_HEADER + rt->flv_pkt.size - off;
+        } else {
+            src = rt->flv_pkt_trailer + off - RTMP_HEADER - rt->flv_pkt.size;
+            len = tag_size - off;
+        }
+        len = FFMIN(len, size - copied);
+        memcpy(buf + copied, src, len);
+        copied          += len;
+        rt->flv_pkt_off += len;
+    }
+
+    if (rt->flv_pkt_off == tag_size)
+        recycle_packet(rt, &rt->flv_pkt);
+    return copied;
+}
+
 static int handle_notify(URLContext *s, RTMPPacket *pkt)
 {
     RTMPContext *rt  = s->priv_data;
@@ -2353,10 +2501,8 @@ static int handle_metadata(RTMPContext *rt, RTMPPacket *pkt)
 
     old_flv_size = update_offset(rt, pkt->size);
 
-    if ((ret = av_reallocp(&rt->flv_data, rt->flv_size)) < 0) {
-        rt->flv_size = rt->flv_off = 0;
+    if ((ret = alloc_flv_data(rt)) < 0)
         return ret;
-    }
 
     next = pkt->data;
     p    = rt->flv_data + old_flv_size;
@@ -2431,7 +2577,7 @@ static int get_packet(URLContext *s, int for_header)
         if (rt->bytes_read - rt->last_bytes_read > rt->receive_report_size) {
             av_log(s, AV_LOG_DEBUG, "Sending bytes read report\n");
             if ((ret = gen_bytes_read(s, rt, rpkt.timestamp + 1)) < 0) {
-                ff_rtmp_packet_destroy(&rpkt);
+                recycle_packet(rt, &rpkt);
                 return ret;
             }
             rt->last_bytes_read = rt->bytes_read;
@@ -2443,56 +2589,62 @@ static int get_packet(URLContext *s, int for_header)
         // with the next packet. handle_invoke will get us out of this state
         // when the right message is encountered
         if (rt->state == STATE_SEEKING) {
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             // We continue, let the natural flow of things happen:
             // AVERROR(EAGAIN) or handle_invoke gets us out of here
             continue;
         }
 
         if (ret < 0) {//serious error in current packet
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             return ret;
         }
         if (rt->do_reconnect && for_header) {
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             return 0;
         }
         if (rt->state == STATE_STOPPED) {
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             return AVERROR_EOF;
         }
         if (for_header && (rt->state == STATE_PLAYING    ||
                            rt->state == STATE_PUBLISHING ||
                            rt->state == STATE_SENDING    ||
                            rt->state == STATE_RECEIVING)) {
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             return 0;
         }
         if (!rpkt.size || !rt->is_input) {
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             continue;
         }
         if (rpkt.type == RTMP_PT_VIDEO || rpkt.type == RTMP_PT_AUDIO) {
-            ret = append_flv_data(rt, &rpkt, 0);
-            ff_rtmp_packet_destroy(&rpkt);
-            return ret;
+            // Hand the packet over as it is unless there is unread data
+            // (such as the FLV header while opening) that has to go first
+            if (rt->flv_off < rt->flv_size) {
+                ret = append_flv_data(rt, &rpkt, 0);
+                recycle_packet(rt, &rpkt);
+                return ret;
+            }
+            set_flv_pkt(rt, &rpkt);
+            return 0;
         } else if (rpkt.type == RTMP_PT_NOTIFY) {
             ret = handle_notify(s, &rpkt);
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             return ret;
         } else if (rpkt.type == RTMP_PT_METADATA) {
             ret = handle_metadata(rt, &rpkt);
-            ff_rtmp_packet_destroy(&rpkt);
+            recycle_packet(rt, &rpkt);
             return ret;
         }
-        ff_rtmp_packet_destroy(&rpkt);
+        recycle_packet(rt, &rpkt);
     }
 }
 
 static int rtmp_close(URLContext *h)
 {
     RTMPContext *rt = h->priv_data;
-    int ret = 0, i, j;
+    int ret = 0, i;
 
     if (!rt->is_input) {
         rt->flv_data = NULL;
@@ -2503,14 +2655,14 @@ static int rtmp_close(URLContext *h)
     }
     if (rt->state > STATE_HANDSHAKED)
         ret = gen_delete_stream(h, rt);
-    for (i = 0; i < 2; i++) {
-        for (j = 0; j < rt->nb_prev_pkt[i]; j++)
-            ff_rtmp_packet_destroy(&rt->prev_pkt[i][j]);
-        av_freep(&rt->prev_pkt[i]);
-    }
+    for (i = 0; i < 2; i++)
+        ff_rtmp_packet_history_free(&rt->prev_pkt[i], &rt->nb_prev_pkt[i]);
 
     free_tracked_methods(rt);
     av_freep(&rt->flv_data);
+    ff_rtmp_packet_destroy(&rt->flv_pkt);
+    av_freep(&rt->out_buf);
+    rt->out_buf_size = 0;
     ffurl_closep(&rt->stream);
     return ret;
 }
@@ -2546,6 +2698,7 @@ static int inject_fake_duration_metadata(RTMPContext *rt)
     memcpy(rt->flv_data + 13 + 55, old_flv_data + 13, rt->flv_size - 13);
     // Increase the size by the injected packet
     rt->flv_size += 55;
+    rt->flv_alloc = rt->flv_size;
     // Delete the old FLV data
     av_freep(&old_flv_data);
 
@@ -2809,6 +2962,12 @@ reconnect:
     av_log(s, AV_LOG_DEBUG, "Proto = %s, path = %s, app = %s, fname = %s\n",
            proto, path, rt->app, rt->playpath);
     if (!rt->listen) {
+        /* Announce a larger chunk size before the first message, so that
+         * the published audio/video packets are not split into many small
+         * chunks. */
+        if (!rt->is_input && rt->chunk_size &&
+            (ret = gen_chunk_size(s, rt)) < 0)
+            goto fail;
         if ((ret = gen_connect(s, rt)) < 0)
             goto fail;
     } else {
@@ -2828,8 +2987,7 @@ reconnect:
         rt->do_reconnect = 0;
         rt->nb_invokes   = 0;
         for (i = 0; i < 2; i++)
-            memset(rt->prev_pkt[i], 0,
-                   sizeof(**rt->prev_pkt) * rt->nb_prev_pkt[i]);
+            ff_rtmp_packet_history_free(&rt->prev_pkt[i], &rt->nb_prev_pkt[i]);
         free_tracked_methods(rt);
         goto reconnect;
     }
@@ -2837,7 +2995,7 @@ reconnect:
     if (rt->is_input) {
         // generate FLV header for demuxer
         rt->flv_size = 13;
-        if ((ret = av_reallocp(&rt->flv_data, rt->flv_size)) < 0)
+        if ((ret = alloc_flv_data(rt)) < 0)
             goto fail;
         rt->flv_off  = 0;
         memcpy(rt->flv_data, "FLV\1\0\0\0\0\011\0\0\0\0", rt->flv_size);
@@ -2910,6 +3068,8 @@ static int rtmp_read(URLContext *s, uint8_t *buf, int size)
             rt->flv_off = rt->flv_size;
             return data_left;
         }
+        if (rt->flv_pkt.size)
+            return read_flv_pkt(rt, buf, size);
         if ((ret = get_packet(s, 0)) < 0)
            return ret;
     }
@@ -2932,6 +3092,7 @@ static int64_t rtmp_seek(URLContext *s, int stream_index, int64_t timestamp,
         return ret;
     }
     rt->flv_off = rt->flv_size;
+    ff_rtmp_packet_destroy(&rt->flv_pkt);
     rt->state = STATE_SEEKING;
     return timestamp;
 }
@@ -3098,6 +3259,7 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
 static const AVOption rtmp_options[] = {
     {"rtmp_app", "Name of application to connect to on the RTMP server", OFFSET(app), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_buffer", "Set buffer time in milliseconds. The default is 3000.", OFFSET(client_buffer_time), AV_OPT_TYPE_INT, {.i64 = 3000}, 0, INT_MAX, DEC|ENC},
+    {"rtmp_chunk_size", "Outgoing chunk size announced to the peer after the handshake. 0 keeps the default of 128 bytes.", OFFSET(chunk_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 0xFFFFFF, DEC|ENC},
     {"rtmp_conn", "Append arbitrary AMF data to the Connect message", OFFSET(conn), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_flashver", "Version of the Flash plugin used to run the SWF player.", OFFSET(flashver), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_flush_interval", "Number of packets flushed in the same request (RTMPT only).", OFFSET(flush_interval), AV_OPT_TYPE_INT, {.i64 = 10}, 0, INT_MAX, ENC},
@@ -3113,6 +3275,7 @@ static const AVOption rtmp_options[] = {
     {"rtmp_swfurl", "URL of the SWF player. By default no value will be sent", OFFSET(swfurl), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_swfverify", "URL to player swf file, compute hash/size automatically.", OFFSET(swfverify), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC},
     {"rtmp_tcurl", "URL of the target stream. Defaults to proto://host[:port]/app.", OFFSET(tcurl), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
+    {"rtmp_write_calls", "Number of writes to the connection, including the handshake; each RTMP packet is written at once.", OFFSET(nb_writes), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, ENC|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY},
     {"rtmp_listen", "Listen for incoming rtmp connections", OFFSET(listen), AV_OPT_TYPE_INT, {.i64 = 0}, INT_MIN, INT_MAX, DEC, "rtmp_listen" },
     {"listen",      "Listen for incoming rtmp connections", OFFSET(listen), AV_OPT_TYPE_INT, {.i64 = 0}, INT_MIN, INT_MAX, DEC, "rtmp_listen" },
     {"timeout", "Maximum timeout (in seconds) to wait for incoming connections. -1 is infinite. Implies -rtmp_listen 1",  OFFSET(listen_timeout), AV_OPT_TYPE_INT, {.i64 = -1}, INT_MIN, INT_MAX, DEC, "rtmp_listen" },